@@ -19,6 +19,7 @@
 
 #include "cableinfowidget.h"
 #include "appcontext.h"
+#include "diagnosticsservice.h"
 #include <QApplication>
 #include <QDebug>
 #include <QGroupBox>
@@ -26,7 +27,7 @@
 #include <QTimer>
 
 CableInfoWidget::CableInfoWidget(iDescriptorDevice *device, QWidget *parent)
-    : QWidget(parent), m_device(device), m_response(nullptr)
+    : QWidget(parent), m_device(device)
 {
     setupUI();
     initCableInfo();
@@ -37,6 +38,16 @@ CableInfoWidget::CableInfoWidget(iDescriptorDevice *device, QWidget *parent)
                     this->deleteLater();
                 }
             });
+    connect(DiagnosticsService::sharedInstance(),
+            &DiagnosticsService::snapshotUpdated, this,
+            [this](const std::string &udid,
+                   const DiagnosticsSnapshot &snapshot) {
+                if (m_device->udid != udid || !snapshot.hasCableInfo) {
+                    return;
+                }
+                m_cableInfo = snapshot.cableInfo;
+                updateUI();
+            });
 }
 
 void CableInfoWidget::setupUI()
@@ -81,111 +92,16 @@ void CableInfoWidget::initCableInfo()
         return;
     }
 
-    m_statusLabel->setText("Analyzing cable...");
-    get_cable_info(m_device->device, m_response);
-
-    analyzeCableInfo();
-    updateUI();
-}
-
-// FIXME: genuine check is not perfect, still need more research
-void CableInfoWidget::analyzeCableInfo()
-{
-    qDebug() << "Analyzing cable info...";
-    m_cableInfo = CableInfo();
-
-    if (!m_response) {
-        return;
-    }
-
-    PlistNavigator nav(m_response);
-    PlistNavigator ioreg = nav["IORegistry"];
-
-    if (!ioreg.valid()) {
-        return;
-    }
-
-    m_cableInfo.isConnected = true;
-
-    // Check if genuine (Apple manufacturer and valid model info)
-    m_cableInfo.manufacturer = QString::fromStdString(
-        ioreg["IOAccessoryAccessoryManufacturer"].getString());
-    m_cableInfo.modelNumber = QString::fromStdString(
-        ioreg["IOAccessoryAccessoryModelNumber"].getString());
-    m_cableInfo.accessoryName =
-        QString::fromStdString(ioreg["IOAccessoryAccessoryName"].getString());
-    m_cableInfo.serialNumber = QString::fromStdString(
-        ioreg["IOAccessoryAccessorySerialNumber"].getString());
-    m_cableInfo.interfaceModuleSerial = QString::fromStdString(
-        ioreg["IOAccessoryInterfaceModuleSerialNumber"].getString());
-
-    // Check if Type-C (based on accessory name or TriStar class)
-    m_cableInfo.triStarClass =
-        QString::fromStdString(ioreg["TriStarICClass"].getString());
-    m_cableInfo.isTypeC =
-        (m_cableInfo.accessoryName.contains("USB-C", Qt::CaseInsensitive) ||
-         m_cableInfo.triStarClass.contains("1612")); // CBTL1612 is Type-C
-
-    // Determine if genuine based on manufacturer and presence of detailed info
-    bool preGenuineCheck =
-        (m_cableInfo.manufacturer.contains("Apple", Qt::CaseInsensitive) &&
-         !m_cableInfo.modelNumber.isEmpty() &&
-         !m_cableInfo.accessoryName.isEmpty());
-
-    // Further checks for Type-C cables
-    // if report says it's Type-C, it must match the actual connection type
-    if (m_cableInfo.isTypeC) {
-        bool actuallyTypeC =
-            m_device->deviceInfo.batteryInfo.usbConnectionType ==
-            BatteryInfo::ConnectionType::USB_TYPEC;
-        if (!actuallyTypeC) {
-            // most likely a fake cable with faked info
-            m_cableInfo.isFakeInfo = true;
-        }
-        m_cableInfo.isGenuine = actuallyTypeC && preGenuineCheck;
+    // show what we already know, a fresh snapshot follows asynchronously
+    DiagnosticsService *service = DiagnosticsService::sharedInstance();
+    if (service->hasSnapshot(m_device->udid) &&
+        service->lastSnapshot(m_device->udid).hasCableInfo) {
+        m_cableInfo = service->lastSnapshot(m_device->udid).cableInfo;
+        updateUI();
     } else {
-        m_cableInfo.isGenuine = preGenuineCheck;
-    }
-
-    // Power information
-    m_cableInfo.currentLimit = ioreg["IOAccessoryUSBCurrentLimit"].getUInt();
-    m_cableInfo.chargingVoltage =
-        ioreg["IOAccessoryUSBChargingVoltage"].getUInt();
-
-    // Connection type
-    QString connectString = QString::fromStdString(
-        ioreg["IOAccessoryUSBConnectString"].getString());
-    int connectType =
-        static_cast<int>(ioreg["IOAccessoryUSBConnectType"].getUInt());
-    m_cableInfo.connectionType =
-        QString("%1 (Type %2)").arg(connectString).arg(connectType);
-
-    // Supported and active transports
-    PlistNavigator supportedTransports = ioreg["TransportsSupported"];
-    if (supportedTransports.valid() &&
-        plist_get_node_type(supportedTransports) == PLIST_ARRAY) {
-        uint32_t count = plist_array_get_size(supportedTransports);
-        for (uint32_t i = 0; i < count; i++) {
-            PlistNavigator transport = supportedTransports[static_cast<int>(i)];
-            if (transport.valid()) {
-                m_cableInfo.supportedTransports.append(
-                    QString::fromStdString(transport.getString()));
-            }
-        }
-    }
-
-    PlistNavigator activeTransports = ioreg["TransportsActive"];
-    if (activeTransports.valid() &&
-        plist_get_node_type(activeTransports) == PLIST_ARRAY) {
-        uint32_t count = plist_array_get_size(activeTransports);
-        for (uint32_t i = 0; i < count; i++) {
-            PlistNavigator transport = activeTransports[static_cast<int>(i)];
-            if (transport.valid()) {
-                m_cableInfo.activeTransports.append(
-                    QString::fromStdString(transport.getString()));
-            }
-        }
+        m_statusLabel->setText("Analyzing cable...");
     }
+    service->requestRefresh(m_device);
 }
 
 void CableInfoWidget::updateUI()
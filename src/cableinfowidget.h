@@ -29,7 +29,6 @@
 #include <QPushButton>
 #include <QVBoxLayout>
 #include <QWidget>
-#include <plist/plist.h>
 
 class CableInfoWidget : public QWidget
 {
@@ -44,30 +43,10 @@ private slots:
 
 private:
     void setupUI();
-    void analyzeCableInfo();
     void updateUI();
     void createInfoRow(QGridLayout *layout, int row, const QString &label,
                        const QString &value);
 
-    // Cable information structure
-    struct CableInfo {
-        bool isConnected = false;
-        bool isGenuine = false;
-        bool isTypeC = false;
-        QString manufacturer;
-        QString modelNumber;
-        QString accessoryName;
-        QString serialNumber;
-        QString interfaceModuleSerial;
-        uint64_t currentLimit = 0;
-        uint64_t chargingVoltage = 0;
-        QString connectionType;
-        QString triStarClass;
-        QStringList supportedTransports;
-        QStringList activeTransports;
-        bool isFakeInfo = false;
-    };
-
     // UI components
     QVBoxLayout *m_mainLayout;
     QLabel *m_statusLabel;
@@ -78,7 +57,6 @@ private:
     // Data
     iDescriptorDevice *m_device;
     CableInfo m_cableInfo;
-    plist_t m_response;
 };
 
 #endif // CABLEINFOWIDGET_H
\ No newline at end of file
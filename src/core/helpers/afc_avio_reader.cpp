@@ -0,0 +1,117 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "afc_avio_reader.h"
+#include "afc_block_cache.h"
+#include <QDebug>
+#include <cstdio>
+extern "C" {
+#include <libavformat/avio.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+// 32KB buffer for streaming
+static constexpr int AVIO_BUFFER_SIZE = 32768;
+
+std::unique_ptr<AfcAvioReader>
+AfcAvioReader::open(iDescriptorDevice *device, const QString &path,
+                    std::optional<afc_client_t> altAfc)
+{
+    std::shared_ptr<AfcBlockCache> cache =
+        AfcBlockCache::open(device, path, altAfc);
+    if (!cache) {
+        qWarning() << "Failed to open video file:" << path;
+        return nullptr;
+    }
+
+    std::unique_ptr<AfcAvioReader> reader(new AfcAvioReader(std::move(cache)));
+    if (!reader->m_avioCtx)
+        return nullptr;
+    return reader;
+}
+
+AfcAvioReader::AfcAvioReader(std::shared_ptr<AfcBlockCache> cache)
+    : m_cache(std::move(cache))
+{
+    auto *buffer = static_cast<unsigned char *>(av_malloc(AVIO_BUFFER_SIZE));
+    if (!buffer)
+        return;
+
+    m_avioCtx = avio_alloc_context(buffer, AVIO_BUFFER_SIZE, 0, this,
+                                   readPacket, nullptr, seekPacket);
+    if (!m_avioCtx)
+        av_free(buffer);
+}
+
+AfcAvioReader::~AfcAvioReader()
+{
+    if (m_avioCtx) {
+        // The demuxer may have swapped the buffer, free whatever is current
+        av_free(m_avioCtx->buffer);
+        avio_context_free(&m_avioCtx);
+    }
+}
+
+uint64_t AfcAvioReader::size() const { return m_cache->size(); }
+
+int AfcAvioReader::readPacket(void *opaque, uint8_t *buf, int bufSize)
+{
+    auto *reader = static_cast<AfcAvioReader *>(opaque);
+
+    const qint64 bytesRead = reader->m_cache->read(
+        reader->m_position, reinterpret_cast<char *>(buf), bufSize);
+    if (bytesRead < 0) {
+        return AVERROR(EIO);
+    }
+    if (bytesRead == 0) {
+        return AVERROR_EOF;
+    }
+
+    reader->m_position += bytesRead;
+    return static_cast<int>(bytesRead);
+}
+
+int64_t AfcAvioReader::seekPacket(void *opaque, int64_t offset, int whence)
+{
+    auto *reader = static_cast<AfcAvioReader *>(opaque);
+    const int64_t fileSize = static_cast<int64_t>(reader->m_cache->size());
+
+    if (whence == AVSEEK_SIZE) {
+        return fileSize;
+    }
+
+    int64_t newPos = 0;
+    if (whence == SEEK_SET) {
+        newPos = offset;
+    } else if (whence == SEEK_CUR) {
+        newPos = static_cast<int64_t>(reader->m_position) + offset;
+    } else if (whence == SEEK_END) {
+        newPos = fileSize + offset;
+    } else {
+        return -1;
+    }
+
+    if (newPos < 0 || newPos > fileSize) {
+        return -1;
+    }
+
+    reader->m_position = static_cast<uint64_t>(newPos);
+    return newPos;
+}
@@ -0,0 +1,67 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef AFC_AVIO_READER_H
+#define AFC_AVIO_READER_H
+
+#include "../../iDescriptor.h"
+#include <QString>
+#include <memory>
+#include <optional>
+
+class AfcBlockCache;
+struct AVIOContext;
+
+/**
+ * @brief FFmpeg AVIOContext over a device file
+ *
+ * Lets libavformat demux a video straight from the device. Reads go through
+ * the file's shared AfcBlockCache, so the demuxer's small reads and its jumps
+ * to a trailing moov atom do not each hit the device. Set context() as the
+ * pb of an AVFormatContext with AVFMT_FLAG_CUSTOM_IO; the reader must outlive
+ * it.
+ */
+class AfcAvioReader
+{
+public:
+    static std::unique_ptr<AfcAvioReader>
+    open(iDescriptorDevice *device, const QString &path,
+         std::optional<afc_client_t> altAfc = std::nullopt);
+    ~AfcAvioReader();
+
+    AfcAvioReader(const AfcAvioReader &) = delete;
+    AfcAvioReader &operator=(const AfcAvioReader &) = delete;
+
+    AVIOContext *context() const { return m_avioCtx; }
+    uint64_t size() const;
+    // Offset of the next read, for progress reporting
+    uint64_t position() const { return m_position; }
+
+private:
+    explicit AfcAvioReader(std::shared_ptr<AfcBlockCache> cache);
+
+    static int readPacket(void *opaque, uint8_t *buf, int bufSize);
+    static int64_t seekPacket(void *opaque, int64_t offset, int whence);
+
+    std::shared_ptr<AfcBlockCache> m_cache;
+    uint64_t m_position = 0;
+    AVIOContext *m_avioCtx = nullptr;
+};
+
+#endif // AFC_AVIO_READER_H
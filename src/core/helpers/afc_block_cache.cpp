@@ -0,0 +1,319 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "afc_block_cache.h"
+#include "../../servicemanager.h"
+#include <QDebug>
+#include <QMutexLocker>
+#include <QtConcurrent/QtConcurrent>
+#include <limits>
+
+namespace
+{
+constexpr uint64_t BLOCK_SIZE = 256 * 1024;
+// 16 MB per open file
+constexpr int MAX_BLOCKS = 64;
+constexpr int READ_AHEAD_BLOCKS = 4;
+// A demand read, read-ahead and a second player connection
+constexpr int MAX_HANDLES = 3;
+// Position of a handle after a failed read
+constexpr uint64_t UNKNOWN_OFFSET = std::numeric_limits<uint64_t>::max();
+
+QMutex registryMutex;
+QHash<QString, std::weak_ptr<AfcBlockCache>> registry;
+} // namespace
+
+std::shared_ptr<AfcBlockCache>
+AfcBlockCache::open(iDescriptorDevice *device, const QString &path,
+                    std::optional<afc_client_t> altAfc)
+{
+    if (!device)
+        return nullptr;
+
+    const QString key =
+        QString("%1|%2|%3")
+            .arg(QString::fromStdString(device->udid))
+            .arg(reinterpret_cast<quintptr>(altAfc ? *altAfc : nullptr))
+            .arg(path);
+
+    {
+        QMutexLocker locker(&registryMutex);
+        if (std::shared_ptr<AfcBlockCache> existing =
+                registry.value(key).lock())
+            return existing;
+    }
+
+    // Stat and open go to the device, opens of other files must not queue
+    // behind them
+    const QByteArray pathBytes = path.toUtf8();
+    plist_t info = nullptr;
+    uint64_t fileSize = 0;
+    if (ServiceManager::safeAfcGetFileInfoPlist(device, pathBytes.constData(),
+                                                &info, altAfc) ==
+            AFC_E_SUCCESS &&
+        info) {
+        plist_t sizeNode = plist_dict_get_item(info, "st_size");
+        if (sizeNode && plist_get_node_type(sizeNode) == PLIST_UINT)
+            plist_get_uint_val(sizeNode, &fileSize);
+        plist_free(info);
+    }
+    if (fileSize == 0) {
+        qDebug() << "AfcBlockCache: cannot stat" << path;
+        return nullptr;
+    }
+
+    uint64_t handle = 0;
+    if (ServiceManager::safeAfcFileOpen(device, pathBytes.constData(),
+                                        AFC_FOPEN_RDONLY, &handle,
+                                        altAfc) != AFC_E_SUCCESS ||
+        handle == 0) {
+        qDebug() << "AfcBlockCache: cannot open" << path;
+        return nullptr;
+    }
+
+    // Declared before the lock, so a cache that lost the race below closes
+    // its handle after the unlock
+    std::shared_ptr<AfcBlockCache> cache(
+        new AfcBlockCache(device, altAfc, pathBytes, handle, fileSize));
+    QMutexLocker locker(&registryMutex);
+    // Another thread may have opened the same file meanwhile
+    if (std::shared_ptr<AfcBlockCache> existing = registry.value(key).lock())
+        return existing;
+
+    for (auto it = registry.begin(); it != registry.end();) {
+        if (it->expired())
+            it = registry.erase(it);
+        else
+            ++it;
+    }
+    registry.insert(key, cache);
+    return cache;
+}
+
+AfcBlockCache::AfcBlockCache(iDescriptorDevice *device,
+                             std::optional<afc_client_t> altAfc,
+                             const QByteArray &path, uint64_t handle,
+                             uint64_t fileSize)
+    : m_device(device), m_altAfc(altAfc), m_path(path), m_fileSize(fileSize)
+{
+    m_idleHandles.append(handle);
+    m_handleOffsets.insert(handle, 0);
+    m_handleCount = 1;
+}
+
+// Read-ahead tasks hold a reference, so every handle is idle by now
+AfcBlockCache::~AfcBlockCache()
+{
+    for (uint64_t handle : m_idleHandles)
+        ServiceManager::safeAfcFileClose(m_device, handle, m_altAfc);
+}
+
+qint64 AfcBlockCache::read(uint64_t offset, char *data, uint64_t length)
+{
+    if (offset >= m_fileSize)
+        return 0;
+    length = std::min(length, m_fileSize - offset);
+
+    qint64 copied = 0;
+    while (length > 0) {
+        const uint64_t index = offset / BLOCK_SIZE;
+        const QByteArray blockData = block(index);
+        if (blockData.isEmpty())
+            return copied > 0 ? copied : -1;
+
+        const uint64_t inBlock = offset % BLOCK_SIZE;
+        const uint64_t n =
+            std::min<uint64_t>(length, blockData.size() - inBlock);
+        memcpy(data, blockData.constData() + inBlock, n);
+        data += n;
+        offset += n;
+        length -= n;
+        copied += n;
+    }
+    return copied;
+}
+
+QByteArray AfcBlockCache::block(uint64_t index)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Reading on from the previous block means playback or a linear scan,
+    // fetch what comes next while the caller consumes this one
+    const bool sequential = m_lastBlock >= 0 &&
+                            (index == static_cast<uint64_t>(m_lastBlock) ||
+                             index == static_cast<uint64_t>(m_lastBlock) + 1);
+    m_lastBlock = static_cast<int64_t>(index);
+
+    while (true) {
+        auto it = m_blocks.constFind(index);
+        if (it != m_blocks.constEnd()) {
+            m_lru.removeOne(index);
+            m_lru.append(index);
+            QByteArray data = *it;
+            if (sequential)
+                scheduleReadAhead(index + 1);
+            return data;
+        }
+        if (!m_inFlight.contains(index))
+            break;
+        m_blockReady.wait(&m_mutex);
+    }
+
+    m_inFlight.insert(index);
+    locker.unlock();
+    QByteArray data = fetchBlock(index);
+    locker.relock();
+
+    m_inFlight.remove(index);
+    if (!data.isEmpty())
+        insertBlock(index, data);
+    m_blockReady.wakeAll();
+    if (sequential)
+        scheduleReadAhead(index + 1);
+    return data;
+}
+
+QByteArray AfcBlockCache::fetchBlock(uint64_t index)
+{
+    const uint64_t offset = index * BLOCK_SIZE;
+    if (offset >= m_fileSize)
+        return {};
+    const uint32_t length =
+        static_cast<uint32_t>(std::min(BLOCK_SIZE, m_fileSize - offset));
+
+    bool atOffset = false;
+    const uint64_t handle = acquireHandle(offset, atOffset);
+    if (!atOffset &&
+        ServiceManager::safeAfcFileSeek(m_device, handle, offset, SEEK_SET,
+                                        m_altAfc) != AFC_E_SUCCESS) {
+        releaseHandle(handle, UNKNOWN_OFFSET);
+        return {};
+    }
+
+    QByteArray data(length, Qt::Uninitialized);
+    uint32_t total = 0;
+    while (total < length) {
+        uint32_t bytesRead = 0;
+        if (ServiceManager::safeAfcFileRead(m_device, handle,
+                                            data.data() + total,
+                                            length - total, &bytesRead,
+                                            m_altAfc) != AFC_E_SUCCESS ||
+            bytesRead == 0) {
+            qDebug() << "AfcBlockCache: read failed at" << offset + total;
+            releaseHandle(handle, UNKNOWN_OFFSET);
+            return {};
+        }
+        total += bytesRead;
+    }
+    releaseHandle(handle, offset + length);
+    return data;
+}
+
+// Prefers an idle handle that is already at offset (a sequential reader
+// needs no seek), then any idle one, and opens another while all are busy
+uint64_t AfcBlockCache::acquireHandle(uint64_t offset, bool &atOffset)
+{
+    QMutexLocker locker(&m_ioMutex);
+    while (true) {
+        for (qsizetype i = 0; i < m_idleHandles.size(); ++i) {
+            if (m_handleOffsets.value(m_idleHandles.at(i)) == offset) {
+                atOffset = true;
+                return m_idleHandles.takeAt(i);
+            }
+        }
+        atOffset = false;
+        if (!m_idleHandles.isEmpty())
+            return m_idleHandles.takeFirst();
+
+        if (m_handleCount < MAX_HANDLES) {
+            m_handleCount++;
+            locker.unlock();
+            uint64_t handle = 0;
+            const bool opened =
+                ServiceManager::safeAfcFileOpen(
+                    m_device, m_path.constData(), AFC_FOPEN_RDONLY, &handle,
+                    m_altAfc) == AFC_E_SUCCESS &&
+                handle != 0;
+            locker.relock();
+            if (opened) {
+                m_handleOffsets.insert(handle, 0);
+                atOffset = offset == 0;
+                return handle;
+            }
+            // Make do with the handles we have
+            m_handleCount--;
+        }
+        m_handleReleased.wait(&m_ioMutex);
+    }
+}
+
+void AfcBlockCache::releaseHandle(uint64_t handle, uint64_t offset)
+{
+    QMutexLocker locker(&m_ioMutex);
+    m_handleOffsets.insert(handle, offset);
+    m_idleHandles.append(handle);
+    m_handleReleased.wakeOne();
+}
+
+// Called with m_mutex held
+void AfcBlockCache::insertBlock(uint64_t index, const QByteArray &data)
+{
+    if (!m_blocks.contains(index)) {
+        while (m_lru.size() >= MAX_BLOCKS)
+            m_blocks.remove(m_lru.takeFirst());
+        m_lru.append(index);
+    }
+    m_blocks.insert(index, data);
+}
+
+// Called with m_mutex held
+void AfcBlockCache::scheduleReadAhead(uint64_t fromIndex)
+{
+    if (m_readAheadRunning)
+        return;
+
+    QList<uint64_t> wanted;
+    for (uint64_t index = fromIndex; index < fromIndex + READ_AHEAD_BLOCKS;
+         ++index) {
+        if (index * BLOCK_SIZE >= m_fileSize)
+            break;
+        if (!m_blocks.contains(index) && !m_inFlight.contains(index))
+            wanted.append(index);
+    }
+    if (wanted.isEmpty())
+        return;
+
+    for (uint64_t index : wanted)
+        m_inFlight.insert(index);
+    m_readAheadRunning = true;
+
+    QtConcurrent::run([self = shared_from_this(), wanted]() {
+        for (uint64_t index : wanted) {
+            QByteArray data = self->fetchBlock(index);
+
+            QMutexLocker locker(&self->m_mutex);
+            self->m_inFlight.remove(index);
+            if (!data.isEmpty())
+                self->insertBlock(index, data);
+            self->m_blockReady.wakeAll();
+        }
+        QMutexLocker locker(&self->m_mutex);
+        self->m_readAheadRunning = false;
+    });
+}
@@ -0,0 +1,94 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef AFC_BLOCK_CACHE_H
+#define AFC_BLOCK_CACHE_H
+
+#include "../../iDescriptor.h"
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QWaitCondition>
+#include <memory>
+#include <optional>
+
+/**
+ * @brief Block cache over one open AFC file
+ *
+ * Reads are served from fixed-size blocks kept in an LRU. Sequential access
+ * triggers asynchronous read-ahead of the following blocks, random access
+ * (e.g. a MOV header at the end of the file) just keeps its blocks around so
+ * seeking back and forth does not go to the device again. Caches are shared
+ * per device file while anyone holds one, so video thumbnailing and playback
+ * of the same file reuse each other's blocks. Up to a few AFC handles are
+ * kept open on the file, so reads for different ranges and read-ahead do not
+ * queue behind each other or seek one handle back and forth. Thread safe.
+ */
+class AfcBlockCache : public std::enable_shared_from_this<AfcBlockCache>
+{
+public:
+    static std::shared_ptr<AfcBlockCache>
+    open(iDescriptorDevice *device, const QString &path,
+         std::optional<afc_client_t> altAfc = std::nullopt);
+    ~AfcBlockCache();
+
+    uint64_t size() const { return m_fileSize; }
+
+    // Copies up to length bytes at offset into data, returns the number of
+    // bytes copied (0 at end of file) or -1 on a device error
+    qint64 read(uint64_t offset, char *data, uint64_t length);
+
+private:
+    AfcBlockCache(iDescriptorDevice *device, std::optional<afc_client_t> altAfc,
+                  const QByteArray &path, uint64_t handle, uint64_t fileSize);
+
+    QByteArray block(uint64_t index);
+    QByteArray fetchBlock(uint64_t index);
+    void insertBlock(uint64_t index, const QByteArray &data);
+    void scheduleReadAhead(uint64_t fromIndex);
+    uint64_t acquireHandle(uint64_t offset, bool &atOffset);
+    void releaseHandle(uint64_t handle, uint64_t offset);
+
+    iDescriptorDevice *m_device;
+    std::optional<afc_client_t> m_altAfc;
+    QByteArray m_path;
+    uint64_t m_fileSize;
+
+    // Seek + read on a handle must not interleave, so each fetch takes a
+    // handle out of the pool for its duration
+    QMutex m_ioMutex;
+    QWaitCondition m_handleReleased;
+    QList<uint64_t> m_idleHandles;
+    // Where the next read on each handle continues
+    QHash<uint64_t, uint64_t> m_handleOffsets;
+    int m_handleCount = 0;
+
+    QMutex m_mutex;
+    QWaitCondition m_blockReady;
+    QHash<uint64_t, QByteArray> m_blocks;
+    QList<uint64_t> m_lru;
+    QSet<uint64_t> m_inFlight;
+    int64_t m_lastBlock = -1;
+    bool m_readAheadRunning = false;
+};
+
+#endif // AFC_BLOCK_CACHE_H
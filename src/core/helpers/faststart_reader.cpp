@@ -0,0 +1,349 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "faststart_reader.h"
+#include "afc_block_cache.h"
+#include <QDebug>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtEndian>
+#include <cstring>
+#include <functional>
+#include <limits>
+
+// Rewritten header goes in front of the first mdat atom, the original moov
+// atom is left out
+struct FaststartLayout {
+    QByteArray header;
+    uint64_t insertAt;
+    uint64_t moovStart;
+    uint64_t moovEnd;
+    uint64_t fileSize;
+};
+
+namespace
+{
+// Larger headers are not worth holding in memory, such files play as is
+constexpr uint64_t MAX_HEADER_SIZE = 64 * 1024 * 1024;
+constexpr int MAX_CACHED_LAYOUTS = 16;
+
+// Atoms on the way from moov to the chunk offset tables
+const QList<QByteArray> CONTAINER_ATOMS = {"moov", "trak", "mdia", "minf",
+                                           "stbl"};
+
+struct CachedLayout {
+    uint64_t fileSize;
+    // nullptr when the file needs no rewriting
+    std::shared_ptr<const FaststartLayout> layout;
+};
+
+QMutex layoutCacheMutex;
+QHash<QString, CachedLayout> layoutCache;
+QList<QString> layoutLru;
+
+bool readFully(AfcBlockCache &cache, uint64_t offset, char *data,
+               uint64_t length)
+{
+    while (length > 0) {
+        const qint64 bytesRead = cache.read(offset, data, length);
+        if (bytesRead <= 0)
+            return false;
+        offset += bytesRead;
+        data += bytesRead;
+        length -= bytesRead;
+    }
+    return true;
+}
+
+void appendBe32(QByteArray &out, quint32 value)
+{
+    const quint32 be = qToBigEndian(value);
+    out.append(reinterpret_cast<const char *>(&be), sizeof(be));
+}
+
+void appendBe64(QByteArray &out, quint64 value)
+{
+    const quint64 be = qToBigEndian(value);
+    out.append(reinterpret_cast<const char *>(&be), sizeof(be));
+}
+
+void appendAtom(QByteArray &out, const QByteArray &type,
+                const QByteArray &body)
+{
+    appendBe32(out, static_cast<quint32>(8 + body.size()));
+    out.append(type);
+    out.append(body);
+}
+
+/*
+ * Copies the atoms in data to out, with every stco/co64 entry passed through
+ * mapOffset. With wide set, stco tables become co64 so offsets past 4 GB
+ * fit. Atoms outside the path to the tables are copied byte for byte.
+ */
+bool rewriteAtoms(const char *data, uint64_t length,
+                  const std::function<uint64_t(uint64_t)> &mapOffset,
+                  bool wide, QByteArray &out)
+{
+    uint64_t pos = 0;
+    while (pos + 8 <= length) {
+        const char *atom = data + pos;
+        uint64_t size = qFromBigEndian<quint32>(atom);
+        uint64_t headerSize = 8;
+        if (size == 1) {
+            if (pos + 16 > length)
+                return false;
+            size = qFromBigEndian<quint64>(atom + 8);
+            headerSize = 16;
+        } else if (size == 0) {
+            size = length - pos;
+        }
+        if (size < headerSize || size > length - pos)
+            return false;
+
+        const QByteArray type(atom + 4, 4);
+        const char *body = atom + headerSize;
+        const uint64_t bodySize = size - headerSize;
+
+        if (CONTAINER_ATOMS.contains(type)) {
+            QByteArray children;
+            if (!rewriteAtoms(body, bodySize, mapOffset, wide, children))
+                return false;
+            appendAtom(out, type, children);
+        } else if (type == "stco" || type == "co64") {
+            const bool is64 = type == "co64";
+            const uint64_t entrySize = is64 ? 8 : 4;
+            if (bodySize < 8)
+                return false;
+            const uint64_t count = qFromBigEndian<quint32>(body + 4);
+            if (count > (bodySize - 8) / entrySize)
+                return false;
+
+            const bool out64 = is64 || wide;
+            QByteArray table;
+            table.reserve(8 + count * (out64 ? 8 : 4));
+            // Version and flags
+            table.append(body, 4);
+            appendBe32(table, static_cast<quint32>(count));
+            for (uint64_t i = 0; i < count; ++i) {
+                const char *entry = body + 8 + i * entrySize;
+                const uint64_t offset = mapOffset(
+                    is64 ? qFromBigEndian<quint64>(entry)
+                         : qFromBigEndian<quint32>(entry));
+                if (out64)
+                    appendBe64(table, offset);
+                else
+                    appendBe32(table, static_cast<quint32>(offset));
+            }
+            appendAtom(out, out64 ? "co64" : "stco", table);
+        } else if (type == "cmov") {
+            // Compressed header, its offsets cannot be rewritten
+            return false;
+        } else {
+            out.append(atom, size);
+        }
+        pos += size;
+    }
+    // Some writers pad containers with a few zero bytes
+    out.append(data + pos, length - pos);
+    return true;
+}
+
+std::shared_ptr<const FaststartLayout> buildLayout(AfcBlockCache &cache)
+{
+    const uint64_t fileSize = cache.size();
+
+    // Top level atoms, one small read each
+    uint64_t firstMdat = 0;
+    bool hasMdat = false;
+    uint64_t moovStart = 0;
+    uint64_t moovEnd = 0;
+    uint64_t offset = 0;
+    while (offset + 8 <= fileSize) {
+        char header[16];
+        const uint64_t headerRead = qMin<uint64_t>(16, fileSize - offset);
+        if (!readFully(cache, offset, header, headerRead))
+            return nullptr;
+
+        uint64_t size = qFromBigEndian<quint32>(header);
+        if (size == 1) {
+            if (headerRead < 16)
+                return nullptr;
+            size = qFromBigEndian<quint64>(header + 8);
+        } else if (size == 0) {
+            size = fileSize - offset;
+        }
+        if (size < 8 || size > fileSize - offset)
+            return nullptr;
+
+        const QByteArray type(header + 4, 4);
+        if (type == "moof") {
+            // Fragmented, there is no single index to move
+            return nullptr;
+        }
+        if (type == "mdat" && !hasMdat) {
+            hasMdat = true;
+            firstMdat = offset;
+        } else if (type == "moov") {
+            moovStart = offset;
+            moovEnd = offset + size;
+        }
+        offset += size;
+    }
+
+    // Not a movie, or one a player can already start on
+    if (!hasMdat || moovEnd == 0 || moovStart < firstMdat)
+        return nullptr;
+
+    const uint64_t moovSize = moovEnd - moovStart;
+    if (moovSize > MAX_HEADER_SIZE)
+        return nullptr;
+
+    QByteArray moov(static_cast<qsizetype>(moovSize), Qt::Uninitialized);
+    if (!readFully(cache, moovStart, moov.data(), moovSize))
+        return nullptr;
+
+    // Atom sizes do not depend on the offsets, so a first pass gives the
+    // size of the new header and with it the new offsets
+    const auto identity = [](uint64_t value) { return value; };
+    QByteArray header;
+    if (!rewriteAtoms(moov.constData(), moovSize, identity, false, header))
+        return nullptr;
+    const bool wide = fileSize - moovSize + header.size() >
+                      std::numeric_limits<quint32>::max();
+    if (wide) {
+        header.clear();
+        rewriteAtoms(moov.constData(), moovSize, identity, true, header);
+    }
+
+    const uint64_t shift = header.size();
+    const auto mapOffset = [=](uint64_t value) {
+        if (value < firstMdat)
+            return value;
+        if (value < moovStart)
+            return value + shift;
+        if (value >= moovEnd)
+            return value - moovSize + shift;
+        return value;
+    };
+    header.clear();
+    rewriteAtoms(moov.constData(), moovSize, mapOffset, wide, header);
+
+    qDebug() << "FaststartReader: moved" << moovSize << "byte header to"
+             << firstMdat;
+    return std::make_shared<const FaststartLayout>(
+        FaststartLayout{header, firstMdat, moovStart, moovEnd, fileSize});
+}
+} // namespace
+
+FaststartReader::FaststartReader(
+    std::shared_ptr<AfcBlockCache> cache,
+    std::shared_ptr<const FaststartLayout> layout)
+    : m_cache(std::move(cache)), m_layout(std::move(layout))
+{
+}
+
+std::shared_ptr<FaststartReader>
+FaststartReader::open(std::shared_ptr<AfcBlockCache> cache,
+                      const QString &key)
+{
+    if (!cache)
+        return nullptr;
+
+    std::shared_ptr<const FaststartLayout> layout;
+    {
+        QMutexLocker locker(&layoutCacheMutex);
+        auto it = layoutCache.constFind(key);
+        if (it != layoutCache.constEnd() && it->fileSize == cache->size()) {
+            layoutLru.removeOne(key);
+            layoutLru.append(key);
+            if (!it->layout)
+                return nullptr;
+            return std::shared_ptr<FaststartReader>(
+                new FaststartReader(std::move(cache), it->layout));
+        }
+    }
+
+    // Without the lock, this reads from the device
+    layout = buildLayout(*cache);
+
+    {
+        QMutexLocker locker(&layoutCacheMutex);
+        layoutLru.removeOne(key);
+        layoutLru.append(key);
+        layoutCache.insert(key, CachedLayout{cache->size(), layout});
+        while (layoutLru.size() > MAX_CACHED_LAYOUTS)
+            layoutCache.remove(layoutLru.takeFirst());
+    }
+
+    if (!layout)
+        return nullptr;
+    return std::shared_ptr<FaststartReader>(
+        new FaststartReader(std::move(cache), std::move(layout)));
+}
+
+uint64_t FaststartReader::size() const
+{
+    return m_layout->fileSize - (m_layout->moovEnd - m_layout->moovStart) +
+           m_layout->header.size();
+}
+
+qint64 FaststartReader::read(uint64_t offset, char *data, uint64_t length)
+{
+    const FaststartLayout &layout = *m_layout;
+    const uint64_t headerEnd = layout.insertAt + layout.header.size();
+    const uint64_t total = size();
+    if (offset >= total)
+        return 0;
+    length = qMin(length, total - offset);
+
+    uint64_t done = 0;
+    while (done < length) {
+        const uint64_t pos = offset + done;
+        uint64_t count = length - done;
+        qint64 bytesRead;
+
+        if (pos < layout.insertAt) {
+            count = qMin(count, layout.insertAt - pos);
+            bytesRead = m_cache->read(pos, data + done, count);
+        } else if (pos < headerEnd) {
+            count = qMin(count, headerEnd - pos);
+            memcpy(data + done,
+                   layout.header.constData() + (pos - layout.insertAt),
+                   count);
+            bytesRead = static_cast<qint64>(count);
+        } else {
+            // Media data up to the old header, then whatever followed it
+            uint64_t source = pos - headerEnd + layout.insertAt;
+            if (source < layout.moovStart)
+                count = qMin(count, layout.moovStart - source);
+            else
+                source += layout.moovEnd - layout.moovStart;
+            bytesRead = m_cache->read(source, data + done, count);
+        }
+
+        if (bytesRead < 0)
+            return done > 0 ? static_cast<qint64>(done) : -1;
+        if (bytesRead == 0)
+            break;
+        done += bytesRead;
+    }
+    return static_cast<qint64>(done);
+}
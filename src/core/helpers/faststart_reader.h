@@ -0,0 +1,65 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FASTSTART_READER_H
+#define FASTSTART_READER_H
+
+#include <QString>
+#include <memory>
+
+class AfcBlockCache;
+struct FaststartLayout;
+
+/**
+ * @brief Faststart view of a device MOV/MP4 whose movie header (moov) comes
+ * after the media data
+ *
+ * The header is read once, its chunk offset tables are rewritten for the
+ * new layout and it is served from memory ahead of the media data, which is
+ * read through the file's AfcBlockCache. A player can then start from the
+ * first bytes without first fetching the end of the file. Rewritten headers
+ * are kept for later opens of the same file. Thread safe.
+ */
+class FaststartReader
+{
+public:
+    /**
+     * @brief Open the faststart view of a file
+     * @param key Identifies the file across opens, e.g. udid and path
+     * @return nullptr if the file is not a movie or already starts with its
+     * header, in which case it can be served as is
+     */
+    static std::shared_ptr<FaststartReader>
+    open(std::shared_ptr<AfcBlockCache> cache, const QString &key);
+
+    // Size of the rewritten file
+    uint64_t size() const;
+
+    // Same contract as AfcBlockCache::read(), in rewritten file offsets
+    qint64 read(uint64_t offset, char *data, uint64_t length);
+
+private:
+    FaststartReader(std::shared_ptr<AfcBlockCache> cache,
+                    std::shared_ptr<const FaststartLayout> layout);
+
+    std::shared_ptr<AfcBlockCache> m_cache;
+    std::shared_ptr<const FaststartLayout> m_layout;
+};
+
+#endif // FASTSTART_READER_H
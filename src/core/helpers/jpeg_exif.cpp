@@ -0,0 +1,127 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "../../iDescriptor.h"
+#include <QBuffer>
+#include <QByteArray>
+#include <QImage>
+#include <QtEndian>
+#include <cstring>
+
+QByteArray load_jpeg_exif(const QByteArray &data)
+{
+    const uchar *d = reinterpret_cast<const uchar *>(data.constData());
+    const qsizetype n = data.size();
+    if (n < 4 || d[0] != 0xFF || d[1] != 0xD8)
+        return QByteArray();
+
+    // Segments up to the image data, EXIF is an APP1 starting "Exif\0\0"
+    qsizetype pos = 2;
+    while (pos + 4 <= n) {
+        if (d[pos] != 0xFF)
+            return QByteArray();
+        const uchar marker = d[pos + 1];
+        if (marker == 0xFF) {
+            pos += 1; // fill byte
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+            pos += 2; // standalone markers
+            continue;
+        }
+        if (marker == 0xDA || marker == 0xD9)
+            return QByteArray();
+
+        const quint16 segmentLength = qFromBigEndian<quint16>(d + pos + 2);
+        const qsizetype segmentStart = pos + 4;
+        const qsizetype segmentEnd = pos + 2 + segmentLength;
+        if (segmentEnd > n)
+            return QByteArray();
+        if (marker == 0xE1 && segmentLength >= 8 &&
+            memcmp(d + segmentStart, "Exif\0\0", 6) == 0) {
+            return data.mid(segmentStart + 6, segmentEnd - segmentStart - 6);
+        }
+        pos = segmentEnd;
+    }
+    return QByteArray();
+}
+
+void reset_exif_orientation(QByteArray &tiff)
+{
+    if (tiff.size() < 8)
+        return;
+
+    const bool littleEndian = tiff.startsWith("II");
+    if (!littleEndian && !tiff.startsWith("MM"))
+        return;
+
+    uchar *data = reinterpret_cast<uchar *>(tiff.data());
+    auto read16 = [&](qsizetype offset) {
+        return littleEndian ? qFromLittleEndian<quint16>(data + offset)
+                            : qFromBigEndian<quint16>(data + offset);
+    };
+    const quint32 ifd = littleEndian ? qFromLittleEndian<quint32>(data + 4)
+                                     : qFromBigEndian<quint32>(data + 4);
+    // In qsizetype, an offset near 4 GB must not wrap past the check
+    if (qsizetype(ifd) + 2 > tiff.size())
+        return;
+
+    const quint16 count = read16(ifd);
+    for (quint16 i = 0; i < count; ++i) {
+        const qsizetype entry = qsizetype(ifd) + 2 + qsizetype(i) * 12;
+        if (entry + 12 > tiff.size())
+            return;
+        if (read16(entry) == 0x0112) {
+            if (littleEndian)
+                qToLittleEndian<quint16>(1, data + entry + 8);
+            else
+                qToBigEndian<quint16>(1, data + entry + 8);
+            return;
+        }
+    }
+}
+
+QByteArray encode_jpeg(const QImage &image, const QByteArray &exif,
+                       int quality)
+{
+    QByteArray jpeg;
+    QBuffer buffer(&jpeg);
+    buffer.open(QIODevice::WriteOnly);
+    if (!image.save(&buffer, "JPG", quality))
+        return QByteArray();
+
+    // The segment length is 16 bits and counts itself and "Exif\0\0"
+    if (exif.isEmpty() || exif.size() + 8 > 0xFFFF ||
+        !jpeg.startsWith("\xFF\xD8"))
+        return jpeg;
+
+    QByteArray app1("\xFF\xE1", 2);
+    const quint16 length = exif.size() + 8;
+    app1.append(char(length >> 8));
+    app1.append(char(length & 0xFF));
+    app1.append("Exif\0\0", 6);
+    app1.append(exif);
+
+    // Keep the JFIF header Qt writes first, APP1 follows it
+    qsizetype insertAt = 2;
+    if (jpeg.size() > 6 && uchar(jpeg[2]) == 0xFF && uchar(jpeg[3]) == 0xE0)
+        insertAt = 4 + qFromBigEndian<quint16>(jpeg.constData() + 4);
+    jpeg.insert(insertAt, app1);
+    return jpeg;
+}
@@ -0,0 +1,397 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "../../iDescriptor.h"
+#include "../../servicemanager.h"
+#include <QByteArray>
+#include <QDebug>
+#include <QHash>
+#include <QImage>
+#include <QTransform>
+#include <QtEndian>
+#include <libheif/heif.h>
+
+/*
+ * Thumbnails embedded in camera files live near the start of the file (EXIF
+ * APP1 segment for JPEG, a thumbnail item referenced from the meta box for
+ * HEIF), so we only read small ranges over AFC instead of the whole file.
+ */
+
+namespace
+{
+constexpr uint32_t RANGE_BLOCK_SIZE = 64 * 1024;
+constexpr int RANGE_MAX_BLOCKS = 32;
+// APP0/APP1 are bounded by the 16-bit segment length
+constexpr uint32_t JPEG_HEAD_SIZE = 128 * 1024;
+
+// Random access reader over an open AFC handle, reads whole blocks and keeps
+// the most recent ones so tiny box/segment header reads don't each become a
+// USB round trip.
+struct AfcRangeReader {
+    iDescriptorDevice *device;
+    uint64_t handle = 0;
+    uint64_t fileSize = 0;
+    int64_t position = 0;
+    QHash<uint64_t, QByteArray> blocks;
+    QList<uint64_t> lru;
+
+    const QByteArray *block(uint64_t index)
+    {
+        auto it = blocks.find(index);
+        if (it != blocks.end()) {
+            lru.removeOne(index);
+            lru.append(index);
+            return &*it;
+        }
+
+        const uint64_t offset = index * RANGE_BLOCK_SIZE;
+        if (offset >= fileSize)
+            return nullptr;
+        const uint32_t length = static_cast<uint32_t>(
+            std::min<uint64_t>(RANGE_BLOCK_SIZE, fileSize - offset));
+
+        if (ServiceManager::safeAfcFileSeek(device, handle, offset,
+                                            SEEK_SET) != AFC_E_SUCCESS)
+            return nullptr;
+
+        QByteArray data(length, Qt::Uninitialized);
+        uint32_t total = 0;
+        while (total < length) {
+            uint32_t bytesRead = 0;
+            if (ServiceManager::safeAfcFileRead(device, handle,
+                                                data.data() + total,
+                                                length - total, &bytesRead) !=
+                    AFC_E_SUCCESS ||
+                bytesRead == 0)
+                return nullptr;
+            total += bytesRead;
+        }
+
+        if (lru.size() >= RANGE_MAX_BLOCKS)
+            blocks.remove(lru.takeFirst());
+        lru.append(index);
+        return &*blocks.insert(index, data);
+    }
+
+    bool read(uint64_t offset, char *dest, uint64_t length)
+    {
+        if (offset + length > fileSize)
+            return false;
+        while (length > 0) {
+            const QByteArray *b = block(offset / RANGE_BLOCK_SIZE);
+            if (!b)
+                return false;
+            const uint64_t inBlock = offset % RANGE_BLOCK_SIZE;
+            const uint64_t n =
+                std::min<uint64_t>(length, b->size() - inBlock);
+            memcpy(dest, b->constData() + inBlock, n);
+            dest += n;
+            offset += n;
+            length -= n;
+        }
+        return true;
+    }
+};
+
+QImage applyExifOrientation(const QImage &image, int orientation)
+{
+    switch (orientation) {
+    case 2:
+        return image.mirrored(true, false);
+    case 3:
+        return image.transformed(QTransform().rotate(180));
+    case 4:
+        return image.mirrored(false, true);
+    case 5:
+        return image.transformed(QTransform().rotate(90)).mirrored(true,
+                                                                   false);
+    case 6:
+        return image.transformed(QTransform().rotate(90));
+    case 7:
+        return image.transformed(QTransform().rotate(270)).mirrored(true,
+                                                                    false);
+    case 8:
+        return image.transformed(QTransform().rotate(270));
+    default:
+        return image;
+    }
+}
+
+/*
+ * Walks the JPEG markers up to the EXIF APP1 segment and returns the absolute
+ * file range of the IFD1 thumbnail (JPEGInterchangeFormat/-Length).
+ */
+bool findExifThumbnail(const QByteArray &head, uint64_t &thumbOffset,
+                       uint32_t &thumbLength, int &orientation)
+{
+    const uchar *d = reinterpret_cast<const uchar *>(head.constData());
+    const qsizetype n = head.size();
+    if (n < 4 || d[0] != 0xFF || d[1] != 0xD8)
+        return false;
+
+    qsizetype pos = 2;
+    while (pos + 4 <= n) {
+        if (d[pos] != 0xFF)
+            return false;
+        const uchar marker = d[pos + 1];
+        if (marker == 0xFF) {
+            pos += 1; // fill byte
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+            pos += 2; // standalone markers
+            continue;
+        }
+        if (marker == 0xDA || marker == 0xD9)
+            return false; // image data starts, no EXIF before it
+
+        const quint16 segmentLength = qFromBigEndian<quint16>(d + pos + 2);
+        const qsizetype segmentStart = pos + 4;
+        const qsizetype segmentEnd = pos + 2 + segmentLength;
+
+        if (marker != 0xE1 || segmentLength < 8 || segmentStart + 6 > n ||
+            memcmp(d + segmentStart, "Exif\0\0", 6) != 0) {
+            pos = segmentEnd;
+            continue;
+        }
+
+        const qsizetype tiffStart = segmentStart + 6;
+        const uchar *t = d + tiffStart;
+        const qsizetype tiffLength = std::min(segmentEnd, n) - tiffStart;
+        if (tiffLength < 8)
+            return false;
+        const bool le = t[0] == 'I';
+
+        auto u16 = [&](qsizetype o) -> int {
+            if (o < 0 || o + 2 > tiffLength)
+                return -1;
+            return le ? qFromLittleEndian<quint16>(t + o)
+                      : qFromBigEndian<quint16>(t + o);
+        };
+        auto u32 = [&](qsizetype o) -> qint64 {
+            if (o < 0 || o + 4 > tiffLength)
+                return -1;
+            return le ? qFromLittleEndian<quint32>(t + o)
+                      : qFromBigEndian<quint32>(t + o);
+        };
+
+        const qint64 ifd0 = u32(4);
+        const int count0 = u16(ifd0);
+        if (count0 < 0)
+            return false;
+        for (int i = 0; i < count0; ++i) {
+            const qsizetype entry = ifd0 + 2 + i * 12;
+            if (u16(entry) == 0x0112) // Orientation
+                orientation = u16(entry + 8);
+        }
+
+        const qint64 ifd1 = u32(ifd0 + 2 + count0 * 12);
+        const int count1 = u16(ifd1);
+        if (ifd1 <= 0 || count1 < 0)
+            return false;
+
+        qint64 offset = -1;
+        qint64 length = -1;
+        for (int i = 0; i < count1; ++i) {
+            const qsizetype entry = ifd1 + 2 + i * 12;
+            const int tag = u16(entry);
+            if (tag == 0x0201)
+                offset = u32(entry + 8);
+            else if (tag == 0x0202)
+                length = u32(entry + 8);
+        }
+        if (offset <= 0 || length <= 0)
+            return false;
+
+        thumbOffset = static_cast<uint64_t>(tiffStart + offset);
+        thumbLength = static_cast<uint32_t>(length);
+        return true;
+    }
+    return false;
+}
+
+QImage loadJpegThumbnail(AfcRangeReader &reader)
+{
+    const uint64_t headSize =
+        std::min<uint64_t>(JPEG_HEAD_SIZE, reader.fileSize);
+    QByteArray head(headSize, Qt::Uninitialized);
+    if (!reader.read(0, head.data(), headSize))
+        return {};
+
+    uint64_t offset = 0;
+    uint32_t length = 0;
+    int orientation = 1;
+    if (!findExifThumbnail(head, offset, length, orientation))
+        return {};
+
+    QByteArray jpeg(length, Qt::Uninitialized);
+    if (!reader.read(offset, jpeg.data(), length))
+        return {};
+
+    QImage image;
+    if (!image.loadFromData(jpeg, "JPG"))
+        return {};
+    return applyExifOrientation(image, orientation);
+}
+
+int64_t heifGetPosition(void *userdata)
+{
+    return static_cast<AfcRangeReader *>(userdata)->position;
+}
+
+int heifRead(void *data, size_t size, void *userdata)
+{
+    auto *reader = static_cast<AfcRangeReader *>(userdata);
+    if (!reader->read(reader->position, static_cast<char *>(data), size))
+        return 1;
+    reader->position += size;
+    return 0;
+}
+
+int heifSeek(int64_t position, void *userdata)
+{
+    auto *reader = static_cast<AfcRangeReader *>(userdata);
+    if (position < 0 || static_cast<uint64_t>(position) > reader->fileSize)
+        return 1;
+    reader->position = position;
+    return 0;
+}
+
+heif_reader_grow_status heifWaitForFileSize(int64_t target, void *userdata)
+{
+    auto *reader = static_cast<AfcRangeReader *>(userdata);
+    return static_cast<uint64_t>(target) <= reader->fileSize
+               ? heif_reader_grow_status_size_reached
+               : heif_reader_grow_status_size_beyond_eof;
+}
+
+QImage loadHeifThumbnail(AfcRangeReader &reader)
+{
+    heif_reader api = {};
+    api.reader_api_version = 1;
+    api.get_position = heifGetPosition;
+    api.read = heifRead;
+    api.seek = heifSeek;
+    api.wait_for_file_size = heifWaitForFileSize;
+
+    heif_context *ctx = heif_context_alloc();
+    if (!ctx)
+        return {};
+
+    // item data is fetched through the reader, so only the meta box and the
+    // thumbnail's own range are actually read from the device
+    heif_error err = heif_context_read_from_reader(ctx, &api, &reader, nullptr);
+    if (err.code != heif_error_Ok) {
+        qDebug() << "Failed to read HEIF container:" << err.message;
+        heif_context_free(ctx);
+        return {};
+    }
+
+    heif_image_handle *primary = nullptr;
+    err = heif_context_get_primary_image_handle(ctx, &primary);
+    if (err.code != heif_error_Ok) {
+        heif_context_free(ctx);
+        return {};
+    }
+
+    heif_item_id thumbId = 0;
+    if (heif_image_handle_get_list_of_thumbnail_IDs(primary, &thumbId, 1) < 1) {
+        heif_image_handle_release(primary);
+        heif_context_free(ctx);
+        return {};
+    }
+
+    heif_image_handle *thumbHandle = nullptr;
+    err = heif_image_handle_get_thumbnail(primary, thumbId, &thumbHandle);
+    heif_image_handle_release(primary);
+    if (err.code != heif_error_Ok) {
+        heif_context_free(ctx);
+        return {};
+    }
+
+    heif_image *img = nullptr;
+    err = heif_decode_image(thumbHandle, &img, heif_colorspace_RGB,
+                            heif_chroma_interleaved_RGB, nullptr);
+    heif_image_handle_release(thumbHandle);
+    if (err.code != heif_error_Ok) {
+        qDebug() << "Failed to decode HEIF thumbnail:" << err.message;
+        heif_context_free(ctx);
+        return {};
+    }
+
+    QImage result;
+    int stride = 0;
+    const uint8_t *data =
+        heif_image_get_plane_readonly(img, heif_channel_interleaved, &stride);
+    if (data) {
+        const int width = heif_image_get_width(img, heif_channel_interleaved);
+        const int height = heif_image_get_height(img, heif_channel_interleaved);
+        // deep copy, the heif image is released below
+        result =
+            QImage(data, width, height, stride, QImage::Format_RGB888).copy();
+    }
+
+    heif_image_release(img);
+    heif_context_free(ctx);
+    return result;
+}
+} // namespace
+
+QImage load_embedded_thumbnail(iDescriptorDevice *device, const char *path,
+                               uint64_t fileSize, const QSize &minSize)
+{
+    const QByteArray lowerPath = QByteArray(path).toLower();
+    const bool isJpeg =
+        lowerPath.endsWith(".jpg") || lowerPath.endsWith(".jpeg");
+    const bool isHeif =
+        lowerPath.endsWith(".heic") || lowerPath.endsWith(".heif");
+    if (!isJpeg && !isHeif)
+        return {};
+
+    if (fileSize == 0) {
+        plist_t info = nullptr;
+        if (ServiceManager::safeAfcGetFileInfoPlist(device, path, &info) ==
+                AFC_E_SUCCESS &&
+            info) {
+            fileSize = PlistNavigator(info)["st_size"].getUInt();
+            plist_free(info);
+        }
+        if (fileSize == 0)
+            return {};
+    }
+
+    AfcRangeReader reader{device};
+    reader.fileSize = fileSize;
+    if (ServiceManager::safeAfcFileOpen(device, path, AFC_FOPEN_RDONLY,
+                                        &reader.handle) != AFC_E_SUCCESS ||
+        reader.handle == 0) {
+        return {};
+    }
+
+    QImage thumbnail =
+        isJpeg ? loadJpegThumbnail(reader) : loadHeifThumbnail(reader);
+    ServiceManager::safeAfcFileClose(device, reader.handle);
+
+    // too small to look good at the requested size, let the caller decode
+    // the full image instead
+    if (!thumbnail.isNull() && thumbnail.width() < minSize.width() &&
+        thumbnail.height() < minSize.height())
+        return {};
+    return thumbnail;
+}
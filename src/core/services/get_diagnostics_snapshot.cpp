@@ -0,0 +1,137 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "../../iDescriptor.h"
+#include <QDebug>
+#include <libimobiledevice/diagnostics_relay.h>
+#include <plist/plist.h>
+
+/*
+ * Queries every IORegistry entry the UI needs (battery + cable) over a single
+ * diagnostics relay session instead of starting one session per entry.
+ */
+bool get_diagnostics_snapshot(idevice_t device, plist_t &power,
+                              plist_t &accessory)
+{
+    power = nullptr;
+    accessory = nullptr;
+
+    diagnostics_relay_client_t diagnostics_client = nullptr;
+    if (diagnostics_relay_client_start_service(device, &diagnostics_client,
+                                               TOOL_NAME) !=
+        DIAGNOSTICS_RELAY_E_SUCCESS) {
+        qDebug() << "Failed to start diagnostics relay service.";
+        return false;
+    }
+
+    if (diagnostics_relay_query_ioregistry_entry(
+            diagnostics_client, nullptr, "IOPMPowerSource", &power) !=
+        DIAGNOSTICS_RELAY_E_SUCCESS) {
+        qDebug() << "Failed to query diagnostics relay for IOPMPowerSource.";
+    }
+
+    if (diagnostics_relay_query_ioregistry_entry(
+            diagnostics_client, nullptr, "AppleTriStarBuiltIn", &accessory) !=
+        DIAGNOSTICS_RELAY_E_SUCCESS) {
+        qDebug()
+            << "Failed to query diagnostics relay for AppleTriStarBuiltIn.";
+    }
+
+    diagnostics_relay_client_free(diagnostics_client);
+    return power || accessory;
+}
+
+// FIXME: genuine check is not perfect, still need more research
+void parseCableInfo(PlistNavigator &ioreg, const BatteryInfo &battery,
+                    CableInfo &c)
+{
+    c = CableInfo();
+
+    if (!ioreg.valid()) {
+        return;
+    }
+
+    c.isConnected = true;
+
+    // Check if genuine (Apple manufacturer and valid model info)
+    c.manufacturer = QString::fromStdString(
+        ioreg["IOAccessoryAccessoryManufacturer"].getString());
+    c.modelNumber = QString::fromStdString(
+        ioreg["IOAccessoryAccessoryModelNumber"].getString());
+    c.accessoryName =
+        QString::fromStdString(ioreg["IOAccessoryAccessoryName"].getString());
+    c.serialNumber = QString::fromStdString(
+        ioreg["IOAccessoryAccessorySerialNumber"].getString());
+    c.interfaceModuleSerial = QString::fromStdString(
+        ioreg["IOAccessoryInterfaceModuleSerialNumber"].getString());
+
+    // Check if Type-C (based on accessory name or TriStar class)
+    c.triStarClass =
+        QString::fromStdString(ioreg["TriStarICClass"].getString());
+    c.isTypeC = (c.accessoryName.contains("USB-C", Qt::CaseInsensitive) ||
+                 c.triStarClass.contains("1612")); // CBTL1612 is Type-C
+
+    // Determine if genuine based on manufacturer and presence of detailed info
+    bool preGenuineCheck =
+        (c.manufacturer.contains("Apple", Qt::CaseInsensitive) &&
+         !c.modelNumber.isEmpty() && !c.accessoryName.isEmpty());
+
+    // Further checks for Type-C cables
+    // if report says it's Type-C, it must match the actual connection type
+    if (c.isTypeC) {
+        bool actuallyTypeC = battery.usbConnectionType ==
+                             BatteryInfo::ConnectionType::USB_TYPEC;
+        if (!actuallyTypeC) {
+            // most likely a fake cable with faked info
+            c.isFakeInfo = true;
+        }
+        c.isGenuine = actuallyTypeC && preGenuineCheck;
+    } else {
+        c.isGenuine = preGenuineCheck;
+    }
+
+    // Power information
+    c.currentLimit = ioreg["IOAccessoryUSBCurrentLimit"].getUInt();
+    c.chargingVoltage = ioreg["IOAccessoryUSBChargingVoltage"].getUInt();
+
+    // Connection type
+    QString connectString = QString::fromStdString(
+        ioreg["IOAccessoryUSBConnectString"].getString());
+    int connectType =
+        static_cast<int>(ioreg["IOAccessoryUSBConnectType"].getUInt());
+    c.connectionType =
+        QString("%1 (Type %2)").arg(connectString).arg(connectType);
+
+    auto readStringArray = [](PlistNavigator array, QStringList &out) {
+        if (!array.valid() || plist_get_node_type(array) != PLIST_ARRAY) {
+            return;
+        }
+        uint32_t count = plist_array_get_size(array);
+        for (uint32_t i = 0; i < count; i++) {
+            PlistNavigator item = array[static_cast<int>(i)];
+            if (item.valid()) {
+                out.append(QString::fromStdString(item.getString()));
+            }
+        }
+    };
+
+    // Supported and active transports
+    readStringArray(ioreg["TransportsSupported"], c.supportedTransports);
+    readStringArray(ioreg["TransportsActive"], c.activeTransports);
+}
@@ -21,41 +21,96 @@
 #include <QByteArray>
 #include <QDebug>
 #include <QImage>
-#include <QPixmap>
+#include <QtEndian>
 #include <libheif/heif.h>
 
-QPixmap load_heic(const QByteArray &imageData)
+// Picks the smallest thumbnail item that still covers targetSize, so a grid
+// thumbnail decodes a ~320px preview instead of a 12 MP primary image
+static heif_image_handle *pick_thumbnail(heif_image_handle *primary,
+                                         const QSize &targetSize)
+{
+    const int count = heif_image_handle_get_number_of_thumbnails(primary);
+    if (count <= 0)
+        return nullptr;
+
+    std::vector<heif_item_id> ids(count);
+    heif_image_handle_get_list_of_thumbnail_IDs(primary, ids.data(), count);
+
+    heif_image_handle *best = nullptr;
+    int bestArea = 0;
+    for (heif_item_id id : ids) {
+        heif_image_handle *thumb = nullptr;
+        if (heif_image_handle_get_thumbnail(primary, id, &thumb).code !=
+            heif_error_Ok) {
+            continue;
+        }
+
+        const QSize size(heif_image_handle_get_width(thumb),
+                         heif_image_handle_get_height(thumb));
+        // Orientation is applied on decode, so compare either way round
+        const bool covers =
+            (size.width() >= targetSize.width() &&
+             size.height() >= targetSize.height()) ||
+            (size.height() >= targetSize.width() &&
+             size.width() >= targetSize.height());
+        const int area = size.width() * size.height();
+        if (covers && (!best || area < bestArea)) {
+            if (best)
+                heif_image_handle_release(best);
+            best = thumb;
+            bestArea = area;
+        } else {
+            heif_image_handle_release(thumb);
+        }
+    }
+    return best;
+}
+
+QImage load_heic(const QByteArray &imageData, const QSize &targetSize,
+                 QSize *fullSize)
 {
     heif_context *ctx = heif_context_alloc();
     if (!ctx) {
         qWarning() << "Failed to allocate heif_context";
-        return QPixmap();
+        return QImage();
     }
 
-    heif_error err = heif_context_read_from_memory(ctx, imageData.constData(),
-                                                   imageData.size(), nullptr);
+    heif_error err = heif_context_read_from_memory_without_copy(
+        ctx, imageData.constData(), imageData.size(), nullptr);
     if (err.code != heif_error_Ok) {
         qWarning() << "Failed to read HEIC from memory:" << err.message;
         heif_context_free(ctx);
-        return QPixmap();
+        return QImage();
     }
 
-    heif_image_handle *handle;
-    err = heif_context_get_primary_image_handle(ctx, &handle);
+    heif_image_handle *primary;
+    err = heif_context_get_primary_image_handle(ctx, &primary);
     if (err.code != heif_error_Ok) {
         qWarning() << "Failed to get primary image handle:" << err.message;
         heif_context_free(ctx);
-        return QPixmap();
+        return QImage();
+    }
+
+    if (fullSize)
+        *fullSize = QSize(heif_image_handle_get_width(primary),
+                          heif_image_handle_get_height(primary));
+
+    heif_image_handle *handle = primary;
+    if (targetSize.isValid()) {
+        if (heif_image_handle *thumb = pick_thumbnail(primary, targetSize))
+            handle = thumb;
     }
 
     heif_image *img;
     err = heif_decode_image(handle, &img, heif_colorspace_RGB,
                             heif_chroma_interleaved_RGB, nullptr);
+    if (handle != primary)
+        heif_image_handle_release(handle);
+    heif_image_handle_release(primary);
     if (err.code != heif_error_Ok) {
         qWarning() << "Failed to decode HEIC image:" << err.message;
-        heif_image_handle_release(handle);
         heif_context_free(ctx);
-        return QPixmap();
+        return QImage();
     }
 
     int width = heif_image_get_width(img, heif_channel_interleaved);
@@ -71,17 +126,60 @@ QPixmap load_heic(const QByteArray &imageData)
     if (!data) {
         qWarning() << "Failed to get image plane data";
         heif_image_release(img);
-        heif_image_handle_release(handle);
         heif_context_free(ctx);
-        return QPixmap();
+        return QImage();
     }
 
-    QImage qimg(data, width, height, stride, QImage::Format_RGB888);
-    QPixmap result = QPixmap::fromImage(qimg);
+    // Wrap the decoded plane without copying; the scale (or the one deep
+    // copy for full size) produces the image we hand back
+    QImage plane(data, width, height, stride, QImage::Format_RGB888);
+    QImage result;
+    if (targetSize.isValid() && (width > targetSize.width() ||
+                                 height > targetSize.height())) {
+        result = plane.scaled(targetSize, Qt::KeepAspectRatio,
+                              Qt::SmoothTransformation);
+    } else {
+        result = plane.copy();
+    }
 
     heif_image_release(img);
-    heif_image_handle_release(handle);
     heif_context_free(ctx);
 
     return result;
 }
+
+QByteArray load_heic_exif(const QByteArray &imageData)
+{
+    heif_context *ctx = heif_context_alloc();
+    if (!ctx)
+        return QByteArray();
+
+    QByteArray tiff;
+    heif_image_handle *primary = nullptr;
+    if (heif_context_read_from_memory_without_copy(ctx, imageData.constData(),
+                                                   imageData.size(), nullptr)
+                .code == heif_error_Ok &&
+        heif_context_get_primary_image_handle(ctx, &primary).code ==
+            heif_error_Ok) {
+        heif_item_id id;
+        if (heif_image_handle_get_list_of_metadata_block_IDs(primary, "Exif",
+                                                             &id, 1) > 0) {
+            QByteArray block(heif_image_handle_get_metadata_size(primary, id),
+                             Qt::Uninitialized);
+            if (block.size() > 4 &&
+                heif_image_handle_get_metadata(primary, id, block.data())
+                        .code == heif_error_Ok) {
+                // The block starts with a big endian offset to the TIFF
+                // header, which is what JPEG's APP1 segment carries
+                const quint32 offset =
+                    qFromBigEndian<quint32>(block.constData());
+                if (offset < quint32(block.size() - 4))
+                    tiff = block.mid(4 + offset);
+            }
+        }
+        heif_image_handle_release(primary);
+    }
+
+    heif_context_free(ctx);
+    return tiff;
+}
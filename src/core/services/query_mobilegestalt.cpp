@@ -22,9 +22,19 @@
 #include <QDebug>
 #include <plist/plist.h>
 
+/*
+ * Queries all keys over a single diagnostics relay session, splitting them into
+ * requests of at most chunkSize keys. values receives one flat dict with every
+ * key the device answered (caller frees). Keys of chunks whose request failed
+ * are appended to failedKeys, if given.
+ */
 bool query_mobile_gestalt(iDescriptorDevice *id_device, const QStringList &keys,
-                          uint32_t &xml_size, char *&xml_data)
+                          plist_t &values, QStringList *failedKeys,
+                          int chunkSize)
 {
+    values = nullptr;
+    if (failedKeys)
+        failedKeys->clear();
     if (!id_device) {
         qDebug() << "Invalid device";
         return false;
@@ -38,33 +48,56 @@ bool query_mobile_gestalt(iDescriptorDevice *id_device, const QStringList &keys,
         return false;
     }
 
-    plist_t result = nullptr;
-    plist_t keys_array = plist_new_array();
-    for (const QString &key : keys) {
-        plist_t key_node = plist_new_string(key.toStdString().c_str());
-        plist_array_append_item(keys_array, key_node);
+    if (chunkSize <= 0) {
+        chunkSize = keys.size();
     }
 
-    diagnostics_relay_error_t err = diagnostics_relay_query_mobilegestalt(
-        diagnostics_client, keys_array, &result);
+    values = plist_new_dict();
+    bool anySucceeded = false;
+    for (qsizetype offset = 0; offset < keys.size(); offset += chunkSize) {
+        const QStringList chunk = keys.mid(offset, chunkSize);
+        plist_t keys_array = plist_new_array();
+        for (const QString &key : chunk) {
+            plist_array_append_item(keys_array,
+                                    plist_new_string(key.toUtf8().constData()));
+        }
 
-    plist_free(keys_array); // Free the keys array
+        plist_t result = nullptr;
+        diagnostics_relay_error_t err = diagnostics_relay_query_mobilegestalt(
+            diagnostics_client, keys_array, &result);
+        plist_free(keys_array);
 
-    if (err != DIAGNOSTICS_RELAY_E_SUCCESS) {
-        qDebug() << "Failed to query mobile gestalt";
-        diagnostics_relay_client_free(diagnostics_client);
-        return false;
-    }
+        if (err != DIAGNOSTICS_RELAY_E_SUCCESS || !result) {
+            qDebug() << "Failed to query mobile gestalt chunk at" << offset;
+            if (result)
+                plist_free(result);
+            if (failedKeys)
+                failedKeys->append(chunk);
+            continue;
+        }
 
-    if (!result) {
-        qDebug() << "No result from mobile gestalt query";
-        diagnostics_relay_client_free(diagnostics_client);
-        return false;
+        plist_t gestalt = plist_dict_get_item(result, "MobileGestalt");
+        if (gestalt && plist_get_node_type(gestalt) == PLIST_DICT) {
+            plist_dict_merge(&values, gestalt);
+            anySucceeded = true;
+        } else if (failedKeys) {
+            failedKeys->append(chunk);
+        }
+        plist_free(result);
     }
 
-    plist_to_xml(result, &xml_data, &xml_size);
-    plist_free(result); // Free the result plist
     diagnostics_relay_client_free(diagnostics_client);
 
+    // "Status" is part of the response envelope, not a gestalt value
+    if (!keys.contains("Status")) {
+        plist_dict_remove_item(values, "Status");
+    }
+
+    if (!anySucceeded) {
+        qDebug() << "No result from mobile gestalt query";
+        plist_free(values);
+        values = nullptr;
+        return false;
+    }
     return true;
 }
@@ -19,6 +19,7 @@
 
 #include "deviceinfowidget.h"
 #include "batterywidget.h"
+#include "diagnosticsservice.h"
 #include "diskusagewidget.h"
 #include "fileexplorerwidget.h"
 #include "iDescriptor-ui.h"
@@ -347,9 +348,18 @@ DeviceInfoWidget::DeviceInfoWidget(iDescriptorDevice *device, QWidget *parent)
     mainLayout->addLayout(rightSideLayout);
     mainLayout->addStretch();
 
+    connect(DiagnosticsService::sharedInstance(),
+            &DiagnosticsService::snapshotUpdated, this,
+            [this](const std::string &udid, const DiagnosticsSnapshot &) {
+                if (m_device->udid == udid) {
+                    updateBatteryInfo();
+                }
+            });
+
     m_updateTimer = new QTimer(this);
-    connect(m_updateTimer, &QTimer::timeout, this,
-            &DeviceInfoWidget::updateBatteryInfo);
+    connect(m_updateTimer, &QTimer::timeout, this, [this]() {
+        DiagnosticsService::sharedInstance()->requestRefresh(m_device);
+    });
     m_updateTimer->start(30000); // Update every 30 seconds
 }
 
@@ -370,23 +380,8 @@ void DeviceInfoWidget::onBatteryMoreClicked()
 
 void DeviceInfoWidget::updateBatteryInfo()
 {
-    qDebug() << "Updating battery info...";
-    plist_t diagnostics = nullptr;
-    get_battery_info(m_device->deviceInfo.rawProductType, m_device->device,
-                     m_device->deviceInfo.is_iPhone, diagnostics);
-
-    if (!diagnostics) {
-        qDebug() << "Failed to get diagnostics plist.";
-        return;
-    }
-    /*DATA*/
-    DeviceInfo &d = m_device->deviceInfo;
-    qDebug() << "old device" << d.oldDevice;
-    PlistNavigator ioreg = PlistNavigator(diagnostics)["IORegistry"];
-    if (d.oldDevice)
-        parseOldDeviceBattery(ioreg, d);
-    else
-        parseDeviceBattery(ioreg, d);
+    // battery info is refreshed by DiagnosticsService before we get here
+    const DeviceInfo &d = m_device->deviceInfo;
     /*UI*/
     updateChargingStatusIcon();
     m_chargingWattsWithCableTypeLabel->setText(
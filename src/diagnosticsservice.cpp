@@ -0,0 +1,127 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "diagnosticsservice.h"
+#include "appcontext.h"
+#include "servicemanager.h"
+#include <QDebug>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrent>
+
+DiagnosticsService *DiagnosticsService::sharedInstance()
+{
+    static DiagnosticsService instance;
+    return &instance;
+}
+
+DiagnosticsService::DiagnosticsService(QObject *parent) : QObject(parent)
+{
+    connect(AppContext::sharedInstance(), &AppContext::deviceRemoved, this,
+            [this](const std::string &udid) { m_snapshots.remove(udid); });
+}
+
+bool DiagnosticsService::hasSnapshot(const std::string &udid) const
+{
+    return m_snapshots.contains(udid);
+}
+
+DiagnosticsSnapshot
+DiagnosticsService::lastSnapshot(const std::string &udid) const
+{
+    return m_snapshots.value(udid);
+}
+
+void DiagnosticsService::requestRefresh(iDescriptorDevice *device)
+{
+    if (!device || !device->device) {
+        return;
+    }
+
+    const std::string udid = device->udid;
+    // a query for this device is already running, its result is shared
+    if (m_inFlight.count(udid)) {
+        return;
+    }
+    m_inFlight.insert(udid);
+
+    const BatteryInfo currentBattery = device->deviceInfo.batteryInfo;
+    const bool oldDevice = device->deviceInfo.oldDevice;
+
+    auto *watcher = new QFutureWatcher<DiagnosticsSnapshot>(this);
+    connect(watcher, &QFutureWatcher<DiagnosticsSnapshot>::finished, this,
+            [this, watcher, udid]() {
+                DiagnosticsSnapshot snapshot = watcher->result();
+                watcher->deleteLater();
+                m_inFlight.erase(udid);
+
+                // device may have been unplugged while we were querying
+                iDescriptorDevice *device =
+                    AppContext::sharedInstance()->getDevice(udid);
+                if (!device) {
+                    return;
+                }
+                if (!snapshot.hasBatteryInfo && !snapshot.hasCableInfo) {
+                    qDebug() << "Failed to get diagnostics snapshot.";
+                    return;
+                }
+
+                if (snapshot.hasBatteryInfo) {
+                    device->deviceInfo.batteryInfo = snapshot.batteryInfo;
+                }
+                m_snapshots.insert(udid, snapshot);
+                emit snapshotUpdated(udid, snapshot);
+            });
+
+    watcher->setFuture(QtConcurrent::run([device, currentBattery,
+                                          oldDevice]() {
+        DiagnosticsSnapshot snapshot;
+        snapshot.batteryInfo = currentBattery;
+
+        plist_t power = nullptr;
+        plist_t accessory = nullptr;
+        ServiceManager::executeOperation(device, [&]() {
+            get_diagnostics_snapshot(device->device, power, accessory);
+        });
+
+        if (power) {
+            PlistNavigator ioreg = PlistNavigator(power)["IORegistry"];
+            if (ioreg.valid()) {
+                DeviceInfo d;
+                d.batteryInfo = currentBattery;
+                if (oldDevice)
+                    parseOldDeviceBattery(ioreg, d);
+                else
+                    parseDeviceBattery(ioreg, d);
+                snapshot.batteryInfo = d.batteryInfo;
+                snapshot.hasBatteryInfo = true;
+            }
+            plist_free(power);
+        }
+
+        if (accessory) {
+            PlistNavigator ioreg = PlistNavigator(accessory)["IORegistry"];
+            // cable checks rely on the connection type of the same snapshot
+            parseCableInfo(ioreg, snapshot.batteryInfo, snapshot.cableInfo);
+            snapshot.hasCableInfo = true;
+            plist_free(accessory);
+        }
+
+        return snapshot;
+    }));
+}
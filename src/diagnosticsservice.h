@@ -0,0 +1,69 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DIAGNOSTICSSERVICE_H
+#define DIAGNOSTICSSERVICE_H
+
+#include "iDescriptor.h"
+#include <QMap>
+#include <QObject>
+#include <unordered_set>
+
+/*
+ * Parsed result of one diagnostics relay round trip. batteryInfo starts as a
+ * copy of the device's current BatteryInfo so fields that are only known at
+ * init time (health, cycle count, serial) are preserved.
+ */
+struct DiagnosticsSnapshot {
+    bool hasBatteryInfo = false;
+    BatteryInfo batteryInfo;
+    bool hasCableInfo = false;
+    CableInfo cableInfo;
+};
+
+/**
+ * @brief Shared source of battery and cable diagnostics
+ *
+ * Battery and cable info both come from IORegistry over the diagnostics
+ * relay. Instead of every widget starting its own relay session, widgets ask
+ * this service for a refresh and listen to snapshotUpdated. Concurrent
+ * requests for the same device are coalesced into a single query.
+ */
+class DiagnosticsService : public QObject
+{
+    Q_OBJECT
+public:
+    static DiagnosticsService *sharedInstance();
+
+    void requestRefresh(iDescriptorDevice *device);
+    bool hasSnapshot(const std::string &udid) const;
+    DiagnosticsSnapshot lastSnapshot(const std::string &udid) const;
+
+signals:
+    void snapshotUpdated(const std::string &udid,
+                         const DiagnosticsSnapshot &snapshot);
+
+private:
+    explicit DiagnosticsService(QObject *parent = nullptr);
+
+    QMap<std::string, DiagnosticsSnapshot> m_snapshots;
+    std::unordered_set<std::string> m_inFlight;
+};
+
+#endif // DIAGNOSTICSSERVICE_H
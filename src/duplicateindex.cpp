@@ -0,0 +1,213 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "duplicateindex.h"
+#include <QMutexLocker>
+#include <QtAlgorithms>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DHASH_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define DHASH_NEON
+#endif
+
+/*
+  dHash: bit (y * 8 + x) is set when pixel x of row y is brighter than its
+  right neighbour in a 9x8 grayscale reduction. pixels holds the 8 rows of 9
+  bytes back to back.
+*/
+static quint64 differenceBits(const uchar *pixels)
+{
+    quint64 bits = 0;
+#if defined(DHASH_SSE2)
+    // Two rows per compare, SSE2 only has a signed byte compare so both
+    // sides are biased into signed range first
+    const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+    for (int y = 0; y < 8; y += 2) {
+        const uchar *row = pixels + y * 9;
+        const __m128i left = _mm_unpacklo_epi64(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i *>(row)),
+            _mm_loadl_epi64(reinterpret_cast<const __m128i *>(row + 9)));
+        const __m128i right = _mm_unpacklo_epi64(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i *>(row + 1)),
+            _mm_loadl_epi64(reinterpret_cast<const __m128i *>(row + 10)));
+        const __m128i greater = _mm_cmpgt_epi8(_mm_xor_si128(left, bias),
+                                               _mm_xor_si128(right, bias));
+        bits |= static_cast<quint64>(
+                    static_cast<quint32>(_mm_movemask_epi8(greater)))
+                << (y * 8);
+    }
+#elif defined(DHASH_NEON)
+    // No movemask on NEON, weight each lane by its bit and add across
+    static const uint8_t laneBits[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x8_t weights = vld1_u8(laneBits);
+    for (int y = 0; y < 8; ++y) {
+        const uchar *row = pixels + y * 9;
+        const uint8x8_t greater = vcgt_u8(vld1_u8(row), vld1_u8(row + 1));
+        bits |= static_cast<quint64>(vaddv_u8(vand_u8(greater, weights)))
+                << (y * 8);
+    }
+#else
+    for (int y = 0; y < 8; ++y) {
+        const uchar *row = pixels + y * 9;
+        for (int x = 0; x < 8; ++x) {
+            if (row[x] > row[x + 1])
+                bits |= quint64(1) << (y * 8 + x);
+        }
+    }
+#endif
+    return bits;
+}
+
+template <typename Visitor>
+void HammingTree::visit(quint64 hash, int maxDistance,
+                        Visitor &&visitor) const
+{
+    if (m_nodes.isEmpty())
+        return;
+
+    QVarLengthArray<int, 64> stack;
+    stack.append(0);
+    while (!stack.isEmpty()) {
+        const Node &node = m_nodes.at(stack.last());
+        stack.removeLast();
+
+        const int d = DuplicateIndex::distance(hash, node.hash);
+        if (d <= maxDistance && !visitor(node))
+            return;
+        // Triangle inequality: only subtrees at |child - d| <= maxDistance
+        // can hold a match
+        for (const auto &child : node.children) {
+            if (qAbs(child.first - d) <= maxDistance)
+                stack.append(child.second);
+        }
+    }
+}
+
+void HammingTree::insert(quint64 hash, int value)
+{
+    if (m_nodes.isEmpty()) {
+        m_nodes.append(Node{hash, {value}, {}});
+        return;
+    }
+
+    int index = 0;
+    for (;;) {
+        Node &node = m_nodes[index];
+        const int d = DuplicateIndex::distance(hash, node.hash);
+        if (d == 0) {
+            node.values.append(value);
+            return;
+        }
+
+        int next = -1;
+        for (const auto &child : node.children) {
+            if (child.first == d) {
+                next = child.second;
+                break;
+            }
+        }
+        if (next < 0) {
+            node.children.append({d, static_cast<int>(m_nodes.size())});
+            m_nodes.append(Node{hash, {value}, {}});
+            return;
+        }
+        index = next;
+    }
+}
+
+QList<int> HammingTree::find(quint64 hash, int maxDistance) const
+{
+    QList<int> values;
+    visit(hash, maxDistance, [&values](const Node &node) {
+        values.append(node.values);
+        return true;
+    });
+    return values;
+}
+
+bool HammingTree::contains(quint64 hash, int maxDistance) const
+{
+    bool found = false;
+    visit(hash, maxDistance, [&found](const Node &) {
+        found = true;
+        return false;
+    });
+    return found;
+}
+
+DuplicateIndex *DuplicateIndex::sharedInstance()
+{
+    static DuplicateIndex instance;
+    return &instance;
+}
+
+quint64 DuplicateIndex::perceptualHash(const QImage &image)
+{
+    if (image.isNull())
+        return 0;
+
+    // Area averaged reduction, the hash only looks at coarse structure
+    const QImage small =
+        image.scaled(9, 8, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+            .convertToFormat(QImage::Format_Grayscale8);
+
+    uchar pixels[8 * 9];
+    for (int y = 0; y < 8; ++y)
+        memcpy(pixels + y * 9, small.constScanLine(y), 9);
+    return differenceBits(pixels);
+}
+
+int DuplicateIndex::distance(quint64 a, quint64 b)
+{
+    return qPopulationCount(a ^ b);
+}
+
+void DuplicateIndex::insert(const QString &udid, const QString &filePath,
+                            quint64 hash)
+{
+    QMutexLocker locker(&m_mutex);
+    const QString key = udid + "|" + filePath;
+    auto it = m_entryByKey.constFind(key);
+    if (it != m_entryByKey.constEnd() && m_entries.at(*it).hash == hash)
+        return;
+
+    // A changed file gets a new entry, the old one is skipped as stale
+    const int index = m_entries.size();
+    m_entries.append(Entry{PhotoRef{udid, filePath}, hash});
+    m_entryByKey.insert(key, index);
+    m_tree.insert(hash, index);
+}
+
+QList<DuplicateIndex::PhotoRef>
+DuplicateIndex::findSimilar(quint64 hash, int maxDistance) const
+{
+    QMutexLocker locker(&m_mutex);
+    QList<PhotoRef> refs;
+    for (int index : m_tree.find(hash, maxDistance)) {
+        const Entry &entry = m_entries.at(index);
+        const QString key = entry.ref.udid + "|" + entry.ref.filePath;
+        if (m_entryByKey.value(key, -1) == index)
+            refs.append(entry.ref);
+    }
+    return refs;
+}
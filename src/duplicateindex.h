@@ -0,0 +1,104 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DUPLICATEINDEX_H
+#define DUPLICATEINDEX_H
+
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QVarLengthArray>
+
+/**
+ * @brief BK-tree over 64-bit hashes with Hamming distance as the metric
+ *
+ * Values are opaque ints owned by the caller. Identical hashes share a node.
+ */
+class HammingTree
+{
+public:
+    void insert(quint64 hash, int value);
+    // Values whose hash is within maxDistance bits of hash
+    QList<int> find(quint64 hash, int maxDistance) const;
+    bool contains(quint64 hash, int maxDistance) const;
+    bool isEmpty() const { return m_nodes.isEmpty(); }
+    void clear() { m_nodes.clear(); }
+
+private:
+    struct Node {
+        quint64 hash;
+        QList<int> values;
+        // (distance to this node, child node index)
+        QVarLengthArray<QPair<int, int>, 4> children;
+    };
+
+    template <typename Visitor>
+    void visit(quint64 hash, int maxDistance, Visitor &&visitor) const;
+
+    QList<Node> m_nodes;
+};
+
+/**
+ * @brief Session wide index of photo perceptual hashes
+ *
+ * Every thumbnail PhotoModel loads feeds its dHash in here, so a photo can
+ * be matched against everything seen so far on any album or device.
+ * Thread safe.
+ */
+class DuplicateIndex
+{
+public:
+    // Hamming distance up to which two dHashes count as the same picture
+    static constexpr int MAX_DISTANCE = 10;
+
+    struct PhotoRef {
+        QString udid;
+        QString filePath;
+    };
+
+    static DuplicateIndex *sharedInstance();
+
+    // 64-bit difference hash of an image, computed from a 9x8 grayscale
+    // reduction so it is the same for any thumbnail size
+    static quint64 perceptualHash(const QImage &image);
+    static int distance(quint64 a, quint64 b);
+
+    void insert(const QString &udid, const QString &filePath, quint64 hash);
+    // Every indexed photo within maxDistance of hash, including the photo
+    // the hash came from
+    QList<PhotoRef> findSimilar(quint64 hash,
+                                int maxDistance = MAX_DISTANCE) const;
+
+private:
+    DuplicateIndex() = default;
+
+    struct Entry {
+        PhotoRef ref;
+        quint64 hash;
+    };
+
+    QList<Entry> m_entries;
+    QHash<QString, int> m_entryByKey; // udid|path -> latest entry
+    HammingTree m_tree;
+    mutable QMutex m_mutex;
+};
+
+#endif // DUPLICATEINDEX_H
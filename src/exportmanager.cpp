@@ -20,13 +20,43 @@
 #include "exportmanager.h"
 #include "exportprogressdialog.h"
 #include "servicemanager.h"
+#include "settingsmanager.h"
+#include "videotranscoder.h"
+#include <QBuffer>
 #include <QDebug>
 #include <QDir>
 #include <QFileInfo>
 #include <QMutexLocker>
 #include <QStandardPaths>
+#include <QThread>
 #include <QtConcurrent/QtConcurrent>
 
+ExportOptions ExportOptions::fromSettings()
+{
+    SettingsManager *sm = SettingsManager::sharedInstance();
+    ExportOptions options;
+    options.convertHeicToJpeg = sm->convertHeicOnExport();
+    options.jpegQuality = sm->exportJpegQuality();
+    options.transcodeVideoToH264 = sm->transcodeVideoOnExport();
+    return options;
+}
+
+static bool isHeicFile(const QString &path)
+{
+    return path.endsWith(".HEIC", Qt::CaseInsensitive) ||
+           path.endsWith(".HEIF", Qt::CaseInsensitive);
+}
+
+static bool isVideoFile(const QString &path)
+{
+    return path.endsWith(".MOV", Qt::CaseInsensitive) ||
+           path.endsWith(".MP4", Qt::CaseInsensitive) ||
+           path.endsWith(".M4V", Qt::CaseInsensitive);
+}
+
+// Videos converted at once
+static constexpr int VIDEO_TRANSCODE_JOBS = 2;
+
 ExportManager *ExportManager::sharedInstance()
 {
     static ExportManager self;
@@ -38,6 +68,8 @@ ExportManager::ExportManager(QObject *parent) : QObject(parent)
     // The singleton now creates and owns the dialog.
     // No parent is passed, so it's a top-level window.
     m_exportProgressDialog = new ExportProgressDialog(this, nullptr);
+
+    m_videoTranscodePool.setMaxThreadCount(VIDEO_TRANSCODE_JOBS);
 }
 
 ExportManager::~ExportManager()
@@ -60,7 +92,8 @@ ExportManager::~ExportManager()
 QUuid ExportManager::startExport(iDescriptorDevice *device,
                                  const QList<ExportItem> &items,
                                  const QString &destinationPath,
-                                 std::optional<afc_client_t> altAfc)
+                                 std::optional<afc_client_t> altAfc,
+                                 const ExportOptions &options)
 {
     if (!device || !device->mutex) {
         qWarning() << "Invalid device provided to ExportManager";
@@ -89,6 +122,7 @@ QUuid ExportManager::startExport(iDescriptorDevice *device,
     job->items = items;
     job->destinationPath = destinationPath;
     job->altAfc = altAfc;
+    job->options = options;
     job->watcher = new QFutureWatcher<void>(this);
 
     const QUuid jobId = job->jobId;
@@ -149,9 +183,34 @@ void ExportManager::executeExportJob(ExportJob *job)
     qDebug() << "Executing export job" << job->jobId << "with"
              << job->items.size() << "items";
 
+    auto finishItem = [&](const ExportResult &result) {
+        if (result.success) {
+            summary.successfulItems++;
+            summary.totalBytesTransferred += result.bytesTransferred;
+        } else {
+            summary.failedItems++;
+        }
+
+        emit itemExported(job->jobId, result);
+    };
+
+    // Conversions in flight per pool, finished in the order they were queued
+    QList<QFuture<ExportResult>> imageTranscodes;
+    QList<QFuture<ExportResult>> videoTranscodes;
+    auto finishTranscodes = [&](bool wait) {
+        for (QList<QFuture<ExportResult>> *transcodes :
+             {&imageTranscodes, &videoTranscodes}) {
+            while (!transcodes->isEmpty() &&
+                   (wait || transcodes->first().isFinished())) {
+                finishItem(transcodes->takeFirst().result());
+            }
+        }
+    };
+
     for (int i = 0; i < job->items.size(); ++i) {
         // Check for cancellation
         if (job->cancelRequested.load()) {
+            finishTranscodes(true);
             summary.wasCancelled = true;
             qDebug() << "Export job" << job->jobId << "was cancelled";
             emit exportCancelled(job->jobId);
@@ -163,21 +222,42 @@ void ExportManager::executeExportJob(ExportJob *job)
         emit exportProgress(job->jobId, i + 1, job->items.size(),
                             item.suggestedFileName);
 
-        ExportResult result =
-            exportSingleItem(job->device, item, job->destinationPath,
-                             job->altAfc, job->cancelRequested, job->jobId);
-
-        if (result.success) {
-            summary.successfulItems++;
-            summary.totalBytesTransferred += result.bytesTransferred;
+        if (job->options.convertHeicToJpeg &&
+            isHeicFile(item.sourcePathOnDevice)) {
+            // Every queued conversion holds a whole file, so don't read
+            // further ahead than the pool can work on
+            while (imageTranscodes.size() >= m_transcodePool.maxThreadCount())
+                finishItem(imageTranscodes.takeFirst().result());
+
+            QFuture<ExportResult> future;
+            ExportResult result;
+            if (startHeicTranscode(job, item, future, result))
+                imageTranscodes.append(future);
+            else
+                finishItem(result);
+        } else if (job->options.transcodeVideoToH264 &&
+                   isVideoFile(item.sourcePathOnDevice)) {
+            // Photos keep copying while the videos convert
+            while (videoTranscodes.size() >=
+                   m_videoTranscodePool.maxThreadCount())
+                finishItem(videoTranscodes.takeFirst().result());
+
+            QFuture<ExportResult> future;
+            ExportResult result;
+            if (startVideoTranscode(job, item, future, result))
+                videoTranscodes.append(future);
+            else
+                finishItem(result);
         } else {
-            summary.failedItems++;
+            finishItem(exportSingleItem(job->device, item,
+                                        job->destinationPath, job->altAfc,
+                                        job->cancelRequested, job->jobId));
         }
-
-        emit itemExported(job->jobId, result);
+        finishTranscodes(false);
 
         // Check for cancellation again after potentially long file operation
         if (job->cancelRequested.load()) {
+            finishTranscodes(true);
             summary.wasCancelled = true;
             qDebug() << "Export job" << job->jobId
                      << "was cancelled during execution";
@@ -186,6 +266,8 @@ void ExportManager::executeExportJob(ExportJob *job)
         }
     }
 
+    finishTranscodes(true);
+
     qDebug() << "Export job" << job->jobId
              << "completed - Success:" << summary.successfulItems
              << "Failed:" << summary.failedItems
@@ -210,21 +292,198 @@ ExportResult ExportManager::exportSingleItem(iDescriptorDevice *device,
     result.outputFilePath = outputPath;
 
     // Get file size first
-    char **info = nullptr;
-    afc_error_t infoResult = ServiceManager::safeAfcGetFileInfo(
-        device, item.sourcePathOnDevice.toUtf8().constData(), &info, altAfc);
+    qint64 totalFileSize = 0;
+    QDateTime modified;
+    getDeviceFileInfo(device, item.sourcePathOnDevice, altAfc, totalFileSize,
+                      modified);
+
+    // Open local output file
+    QFile outputFile(outputPath);
+    if (!outputFile.open(QIODevice::WriteOnly)) {
+        result.errorMessage = QString("Failed to create local file: %1 (%2)")
+                                  .arg(outputPath)
+                                  .arg(outputFile.errorString());
+        return result;
+    }
+
+    if (!transferFile(device, item, totalFileSize, outputFile, altAfc,
+                      cancelRequested, jobId, result)) {
+        outputFile.close();
+        outputFile.remove(); // Clean up partial file
+        return result;
+    }
+
+    // Keep the date the photo was taken rather than the export date
+    if (modified.isValid())
+        outputFile.setFileTime(modified, QFileDevice::FileModificationTime);
+    outputFile.close();
+
+    result.success = true;
+    return result;
+}
+
+bool ExportManager::startHeicTranscode(ExportJob *job, const ExportItem &item,
+                                       QFuture<ExportResult> &future,
+                                       ExportResult &result)
+{
+    result.sourceFilePath = item.sourcePathOnDevice;
 
     qint64 totalFileSize = 0;
-    if (infoResult == AFC_E_SUCCESS && info) {
-        for (int i = 0; info[i]; i += 2) {
-            if (strcmp(info[i], "st_size") == 0) {
-                totalFileSize = QString::fromUtf8(info[i + 1]).toLongLong();
-                break;
-            }
+    QDateTime modified;
+    getDeviceFileInfo(job->device, item.sourcePathOnDevice, job->altAfc,
+                      totalFileSize, modified);
+
+    QByteArray data;
+    data.reserve(totalFileSize);
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    if (!transferFile(job->device, item, totalFileSize, buffer, job->altAfc,
+                      job->cancelRequested, job->jobId, result))
+        return false;
+    buffer.close();
+
+    // Claim the output name now, later items must not pick the same one
+    // before the conversion writes it
+    const QString jpegName =
+        QFileInfo(item.suggestedFileName).completeBaseName() + ".jpg";
+    result.outputFilePath = generateUniqueOutputPath(
+        QDir(job->destinationPath).filePath(jpegName));
+    QFile reserved(result.outputFilePath);
+    if (!reserved.open(QIODevice::WriteOnly)) {
+        result.errorMessage = QString("Failed to create local file: %1 (%2)")
+                                  .arg(result.outputFilePath)
+                                  .arg(reserved.errorString());
+        return false;
+    }
+    reserved.close();
+
+    const int quality = job->options.jpegQuality;
+    const std::atomic<bool> *cancelRequested = &job->cancelRequested;
+    future = QtConcurrent::run(
+        &m_transcodePool, [data, result, quality, modified, cancelRequested]() {
+            return transcodeHeic(data, result, quality, modified,
+                                 cancelRequested);
+        });
+    return true;
+}
+
+bool ExportManager::startVideoTranscode(ExportJob *job, const ExportItem &item,
+                                        QFuture<ExportResult> &future,
+                                        ExportResult &result)
+{
+    result.sourceFilePath = item.sourcePathOnDevice;
+
+    qint64 totalFileSize = 0;
+    QDateTime modified;
+    getDeviceFileInfo(job->device, item.sourcePathOnDevice, job->altAfc,
+                      totalFileSize, modified);
+
+    // Claim the output name now, as for HEIC conversions
+    result.outputFilePath = generateUniqueOutputPath(
+        QDir(job->destinationPath).filePath(item.suggestedFileName));
+    QFile reserved(result.outputFilePath);
+    if (!reserved.open(QIODevice::WriteOnly)) {
+        result.errorMessage = QString("Failed to create local file: %1 (%2)")
+                                  .arg(result.outputFilePath)
+                                  .arg(reserved.errorString());
+        return false;
+    }
+    reserved.close();
+
+    // Split the cores between the conversions that can run at once
+    const int threads = qMax(1, QThread::idealThreadCount() /
+                                    m_videoTranscodePool.maxThreadCount());
+    const QUuid jobId = job->jobId;
+    const std::atomic<bool> *cancelRequested = &job->cancelRequested;
+    iDescriptorDevice *device = job->device;
+    const std::optional<afc_client_t> altAfc = job->altAfc;
+    auto transcode = [this, result, device, item, threads, altAfc, jobId,
+                      cancelRequested, modified, totalFileSize]() {
+        ExportResult transcoded = result;
+        const QString error = VideoTranscoder::transcodeToH264(
+            device, item.sourcePathOnDevice, transcoded.outputFilePath,
+            threads, *cancelRequested, altAfc,
+            [this, jobId, item](qint64 done, qint64 total) {
+                emit fileTransferProgress(jobId, item.suggestedFileName, done,
+                                          total);
+            });
+
+        if (!error.isEmpty()) {
+            transcoded.errorMessage = cancelRequested->load()
+                                          ? "Export cancelled by user"
+                                          : error;
+            return transcoded;
         }
-        afc_dictionary_free(info);
+
+        if (modified.isValid()) {
+            QFile outputFile(transcoded.outputFilePath);
+            if (outputFile.open(QIODevice::ReadWrite))
+                outputFile.setFileTime(modified,
+                                       QFileDevice::FileModificationTime);
+        }
+        transcoded.success = true;
+        transcoded.bytesTransferred = totalFileSize;
+        return transcoded;
+    };
+    future = QtConcurrent::run(&m_videoTranscodePool, transcode);
+    return true;
+}
+
+ExportResult ExportManager::transcodeHeic(
+    const QByteArray &data, ExportResult result, int quality,
+    const QDateTime &modified, const std::atomic<bool> *cancelRequested)
+{
+    QFile outputFile(result.outputFilePath);
+
+    QImage image;
+    if (!cancelRequested->load())
+        image = load_heic(data);
+
+    if (cancelRequested->load()) {
+        outputFile.remove();
+        result.errorMessage = "Export cancelled by user";
+        return result;
+    }
+
+    if (image.isNull()) {
+        outputFile.remove();
+        result.errorMessage = QString("Failed to decode HEIC image: %1")
+                                  .arg(result.sourceFilePath);
+        return result;
     }
 
+    // The decoded HEIC is already upright, so a copied orientation tag would
+    // rotate it a second time
+    QByteArray exif = load_heic_exif(data);
+    reset_exif_orientation(exif);
+    const QByteArray jpeg = encode_jpeg(image, exif, quality);
+
+    if (jpeg.isEmpty() || !outputFile.open(QIODevice::WriteOnly) ||
+        outputFile.write(jpeg) != jpeg.size()) {
+        result.errorMessage = QString("Failed to write JPEG: %1 (%2)")
+                                  .arg(result.outputFilePath)
+                                  .arg(outputFile.errorString());
+        outputFile.close();
+        outputFile.remove();
+        return result;
+    }
+
+    if (modified.isValid())
+        outputFile.setFileTime(modified, QFileDevice::FileModificationTime);
+    outputFile.close();
+
+    result.success = true;
+    result.bytesTransferred = data.size();
+    return result;
+}
+
+bool ExportManager::transferFile(iDescriptorDevice *device,
+                                 const ExportItem &item, qint64 totalFileSize,
+                                 QIODevice &output,
+                                 std::optional<afc_client_t> altAfc,
+                                 std::atomic<bool> &cancelRequested,
+                                 const QUuid &jobId, ExportResult &result)
+{
     // Open file on device
     uint64_t handle = 0;
     afc_error_t openResult = ServiceManager::safeAfcFileOpen(
@@ -236,17 +495,7 @@ ExportResult ExportManager::exportSingleItem(iDescriptorDevice *device,
             QString("Failed to open file on device: %1 (AFC error: %2)")
                 .arg(item.sourcePathOnDevice)
                 .arg(static_cast<int>(openResult));
-        return result;
-    }
-
-    // Open local output file
-    QFile outputFile(outputPath);
-    if (!outputFile.open(QIODevice::WriteOnly)) {
-        result.errorMessage = QString("Failed to create local file: %1 (%2)")
-                                  .arg(outputPath)
-                                  .arg(outputFile.errorString());
-        ServiceManager::safeAfcFileClose(device, handle, altAfc);
-        return result;
+        return false;
     }
 
     char buffer[8192];
@@ -256,11 +505,9 @@ ExportResult ExportManager::exportSingleItem(iDescriptorDevice *device,
     while (true) {
         // Check for cancellation during file copy
         if (cancelRequested.load()) {
-            outputFile.close();
-            outputFile.remove(); // Clean up partial file
             ServiceManager::safeAfcFileClose(device, handle, altAfc);
             result.errorMessage = "Export cancelled by user";
-            return result;
+            return false;
         }
 
         afc_error_t readResult = ServiceManager::safeAfcFileRead(
@@ -270,16 +517,14 @@ ExportResult ExportManager::exportSingleItem(iDescriptorDevice *device,
             break; // End of file or error
         }
 
-        qint64 bytesWritten = outputFile.write(buffer, bytesRead);
+        qint64 bytesWritten = output.write(buffer, bytesRead);
         if (bytesWritten != bytesRead) {
             result.errorMessage =
                 QString("Write error: only wrote %1 of %2 bytes")
                     .arg(bytesWritten)
                     .arg(bytesRead);
-            outputFile.close();
-            outputFile.remove(); // Clean up partial file
             ServiceManager::safeAfcFileClose(device, handle, altAfc);
-            return result;
+            return false;
         }
 
         totalBytes += bytesRead;
@@ -291,19 +536,38 @@ ExportResult ExportManager::exportSingleItem(iDescriptorDevice *device,
         }
     }
 
-    // Clean up
-    outputFile.close();
     ServiceManager::safeAfcFileClose(device, handle, altAfc);
 
     if (totalBytes == 0) {
         result.errorMessage = "No data read from device file";
-        outputFile.remove(); // Clean up empty file
-        return result;
+        return false;
     }
 
-    result.success = true;
     result.bytesTransferred = totalBytes;
-    return result;
+    return true;
+}
+
+void ExportManager::getDeviceFileInfo(iDescriptorDevice *device,
+                                      const QString &path,
+                                      std::optional<afc_client_t> altAfc,
+                                      qint64 &size, QDateTime &modified) const
+{
+    char **info = nullptr;
+    afc_error_t infoResult = ServiceManager::safeAfcGetFileInfo(
+        device, path.toUtf8().constData(), &info, altAfc);
+    if (infoResult != AFC_E_SUCCESS || !info)
+        return;
+
+    for (int i = 0; info[i]; i += 2) {
+        if (strcmp(info[i], "st_size") == 0) {
+            size = QString::fromUtf8(info[i + 1]).toLongLong();
+        } else if (strcmp(info[i], "st_mtime") == 0) {
+            // AFC reports nanoseconds since the epoch
+            modified = QDateTime::fromMSecsSinceEpoch(
+                QString::fromUtf8(info[i + 1]).toLongLong() / 1000000);
+        }
+    }
+    afc_dictionary_free(info);
 }
 
 QString ExportManager::generateUniqueOutputPath(const QString &basePath) const
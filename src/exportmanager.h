@@ -21,12 +21,15 @@
 #define EXPORTMANAGER_H
 
 #include "iDescriptor.h"
+#include <QDateTime>
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QIODevice>
 #include <QMap>
 #include <QMutex>
 #include <QObject>
 #include <QString>
+#include <QThreadPool>
 #include <QUuid>
 #include <atomic>
 #include <memory>
@@ -54,6 +57,17 @@ struct ExportResult {
     qint64 bytesTransferred = 0;
 };
 
+struct ExportOptions {
+    // Write HEIC images as JPEG, keeping their EXIF data and file dates
+    bool convertHeicToJpeg = false;
+    int jpegQuality = 90;
+    // Re-encode videos to H.264 straight from the device
+    bool transcodeVideoToH264 = false;
+
+    // Options the user picked in the settings
+    static ExportOptions fromSettings();
+};
+
 struct ExportJobSummary {
     QUuid jobId;
     int totalItems = 0;
@@ -78,7 +92,8 @@ public:
 
     QUuid startExport(iDescriptorDevice *device, const QList<ExportItem> &items,
                       const QString &destinationPath,
-                      std::optional<afc_client_t> altAfc = std::nullopt);
+                      std::optional<afc_client_t> altAfc = std::nullopt,
+                      const ExportOptions &options = ExportOptions());
 
     void cancelExport(const QUuid &jobId);
 
@@ -114,6 +129,7 @@ private:
         QList<ExportItem> items;
         QString destinationPath;
         std::optional<afc_client_t> altAfc;
+        ExportOptions options;
         std::atomic<bool> cancelRequested{false};
         QFuture<void> future;
         QFutureWatcher<void> *watcher = nullptr;
@@ -128,6 +144,37 @@ private:
                                   std::atomic<bool> &cancelRequested,
                                   const QUuid &jobId);
 
+    // Reads a HEIC file into memory and queues its conversion on
+    // m_transcodePool, so the next file transfers while it is encoded.
+    // Returns false with result filled in if the file could not be read.
+    bool startHeicTranscode(ExportJob *job, const ExportItem &item,
+                            QFuture<ExportResult> &future,
+                            ExportResult &result);
+
+    // Queues a video on m_videoTranscodePool, which reads it from the device
+    // itself. Returns false with result filled in if that is not possible.
+    bool startVideoTranscode(ExportJob *job, const ExportItem &item,
+                             QFuture<ExportResult> &future,
+                             ExportResult &result);
+
+    static ExportResult transcodeHeic(const QByteArray &data,
+                                      ExportResult result, int quality,
+                                      const QDateTime &modified,
+                                      const std::atomic<bool> *cancelRequested);
+
+    // Copies a device file into output. Returns false with
+    // result.errorMessage set if the copy failed or was cancelled.
+    bool transferFile(iDescriptorDevice *device, const ExportItem &item,
+                      qint64 totalFileSize, QIODevice &output,
+                      std::optional<afc_client_t> altAfc,
+                      std::atomic<bool> &cancelRequested, const QUuid &jobId,
+                      ExportResult &result);
+
+    // st_size and st_mtime of a file on the device
+    void getDeviceFileInfo(iDescriptorDevice *device, const QString &path,
+                           std::optional<afc_client_t> altAfc, qint64 &size,
+                           QDateTime &modified) const;
+
     QString generateUniqueOutputPath(const QString &basePath) const;
 
     QString extractFileName(const QString &devicePath) const;
@@ -138,6 +185,13 @@ private:
     mutable QMutex m_jobsMutex;
     QMap<QUuid, ExportJob *> m_activeJobs;
 
+    // Decodes and encodes converted images while the job thread keeps
+    // reading from the device
+    QThreadPool m_transcodePool;
+    // Each video conversion already runs a multi-threaded encoder, so only
+    // a few run at once, independent of the image conversions
+    QThreadPool m_videoTranscodePool;
+
     // Manager owns the dialog
     ExportProgressDialog *m_exportProgressDialog;
 };
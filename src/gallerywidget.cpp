@@ -23,6 +23,8 @@
 #include "mediapreviewdialog.h"
 #include "photomodel.h"
 #include "servicemanager.h"
+#include "thumbnailcache.h"
+#include <QCheckBox>
 #include <QComboBox>
 #include <QDebug>
 #include <QFileDialog>
@@ -33,11 +35,14 @@
 #include <QListView>
 #include <QMenu>
 #include <QMessageBox>
+#include <QPointer>
 #include <QPushButton>
 #include <QRegularExpression>
+#include <QScrollBar>
 #include <QStackedWidget>
 #include <QStandardItemModel>
 #include <QStandardPaths>
+#include <QTimer>
 #include <QVBoxLayout>
 #include <QtConcurrent/QtConcurrent>
 
@@ -91,6 +96,10 @@ void GalleryWidget::setupUI()
     m_stackedWidget->setCurrentWidget(m_albumSelectionWidget);
     setControlsEnabled(false); // Disable controls until album is selected
     loadAlbumList();
+
+    // Open straight into the whole camera roll, albums stay one click away
+    if (!m_albumPaths.isEmpty())
+        onAlbumSelected(QString());
 }
 
 void GalleryWidget::setupControlsLayout()
@@ -120,6 +129,8 @@ void GalleryWidget::setupControlsLayout()
                               static_cast<int>(PhotoModel::ImagesOnly));
     m_filterComboBox->addItem("Videos Only",
                               static_cast<int>(PhotoModel::VideosOnly));
+    m_filterComboBox->addItem("Duplicates",
+                              static_cast<int>(PhotoModel::DuplicatesOnly));
     m_filterComboBox->setCurrentIndex(0);   // Default to All
     m_filterComboBox->setMinimumWidth(100); // Ensure text fits
     m_filterComboBox->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
@@ -130,6 +141,9 @@ void GalleryWidget::setupControlsLayout()
     m_exportSelectedButton->setSizePolicy(QSizePolicy::Preferred,
                                           QSizePolicy::Fixed);
     m_exportAllButton = new QPushButton("Export All");
+    m_skipDuplicatesCheckBox = new QCheckBox("Skip Duplicates");
+    m_skipDuplicatesCheckBox->setToolTip(
+        "Export only the first of photos that look the same");
 
     // Back button
     m_backButton = new QPushButton("← Back to Albums");
@@ -145,6 +159,12 @@ void GalleryWidget::setupControlsLayout()
             &GalleryWidget::onExportSelected);
     connect(m_exportAllButton, &QPushButton::clicked, this,
             &GalleryWidget::onExportAll);
+    // Start hashing the album right away so the export does not wait on it
+    connect(m_skipDuplicatesCheckBox, &QCheckBox::toggled, this,
+            [this](bool checked) {
+                if (m_model)
+                    m_model->setDuplicateScanEnabled(checked);
+            });
     connect(m_backButton, &QPushButton::clicked, this,
             &GalleryWidget::onBackToAlbums);
 
@@ -155,6 +175,7 @@ void GalleryWidget::setupControlsLayout()
     m_controlsLayout->addWidget(filterLabel);
     m_controlsLayout->addWidget(m_filterComboBox);
     m_controlsLayout->addStretch(); // Push export buttons to the right
+    m_controlsLayout->addWidget(m_skipDuplicatesCheckBox);
     m_controlsLayout->addWidget(m_exportSelectedButton);
     m_controlsLayout->addWidget(m_exportAllButton);
 
@@ -224,6 +245,9 @@ void GalleryWidget::onExportSelected()
         return;
     }
 
+    if (!removeDuplicatesForExport(filePaths))
+        return;
+
     QString exportDir = selectExportDirectory();
     if (exportDir.isEmpty()) {
         return;
@@ -239,8 +263,9 @@ void GalleryWidget::onExportSelected()
     qDebug() << "Starting export of selected files:" << exportItems.size()
              << "items to" << exportDir;
 
-    ExportManager::sharedInstance()->startExport(m_device, exportItems,
-                                                 exportDir);
+    ExportManager::sharedInstance()->startExport(
+        m_device, exportItems, exportDir, std::nullopt,
+        ExportOptions::fromSettings());
 }
 
 void GalleryWidget::onExportAll()
@@ -271,6 +296,9 @@ void GalleryWidget::onExportAll()
         return;
     }
 
+    if (!removeDuplicatesForExport(filePaths))
+        return;
+
     QString exportDir = selectExportDirectory();
     if (exportDir.isEmpty()) {
         return;
@@ -287,8 +315,35 @@ void GalleryWidget::onExportAll()
              << "items to" << exportDir;
 
     // Start export and the manager will show its own dialog
-    ExportManager::sharedInstance()->startExport(m_device, exportItems,
-                                                 exportDir);
+    ExportManager::sharedInstance()->startExport(
+        m_device, exportItems, exportDir, std::nullopt,
+        ExportOptions::fromSettings());
+}
+
+// Returns false if the user cancelled the export
+bool GalleryWidget::removeDuplicatesForExport(QStringList &filePaths)
+{
+    if (!m_skipDuplicatesCheckBox->isChecked())
+        return true;
+
+    if (!m_model->isDuplicateScanComplete()) {
+        const QString message =
+            QString("Still looking for duplicates (%1 of %2 items checked). "
+                    "Items not checked yet will be exported.\n\n"
+                    "Export anyway?")
+                .arg(m_model->hashedCount())
+                .arg(m_model->photoCount());
+        if (QMessageBox::question(this, "Skip Duplicates", message,
+                                  QMessageBox::Yes | QMessageBox::No,
+                                  QMessageBox::No) != QMessageBox::Yes)
+            return false;
+    }
+
+    const int total = filePaths.size();
+    filePaths = m_model->withoutDuplicates(filePaths);
+    qDebug() << "Skipping" << total - filePaths.size()
+             << "duplicates in export";
+    return true;
 }
 
 QString GalleryWidget::selectExportDirectory()
@@ -383,24 +438,52 @@ void GalleryWidget::setupPhotoGalleryView()
 
     // Connect double-click to open preview dialog
     connect(m_listView, &QListView::doubleClicked, this,
-            [this](const QModelIndex &index) {
-                if (!index.isValid())
-                    return;
-
-                QString filePath =
-                    m_model->data(index, Qt::UserRole).toString();
-                if (filePath.isEmpty())
-                    return;
-
-                qDebug() << "Opening preview for" << filePath;
-                auto *previewDialog = new MediaPreviewDialog(
-                    m_device, m_device->afcClient, filePath, this);
-                previewDialog->setAttribute(Qt::WA_DeleteOnClose);
-                previewDialog->show();
-            });
+            &GalleryWidget::openPreview);
 
     connect(m_listView, &QListView::customContextMenuRequested, this,
             &GalleryWidget::onPhotoContextMenu);
+
+    // Tell the model what is on screen so thumbnails load there first,
+    // coalesced since scrolling and row inserts fire in bursts
+    m_visibleRangeTimer = new QTimer(this);
+    m_visibleRangeTimer->setSingleShot(true);
+    m_visibleRangeTimer->setInterval(30);
+    connect(m_visibleRangeTimer, &QTimer::timeout, this,
+            &GalleryWidget::updateVisibleRange);
+    connect(m_listView->verticalScrollBar(), &QScrollBar::valueChanged,
+            m_visibleRangeTimer, qOverload<>(&QTimer::start));
+    connect(m_listView->verticalScrollBar(), &QScrollBar::rangeChanged,
+            m_visibleRangeTimer, qOverload<>(&QTimer::start));
+}
+
+void GalleryWidget::updateVisibleRange()
+{
+    if (!m_model)
+        return;
+
+    const int rows = m_model->rowCount();
+    if (rows == 0) {
+        m_model->setVisibleRange(-1, -1);
+        return;
+    }
+
+    // Items have uniform sizes, so the grid follows from the first one
+    const QRect firstRect = m_listView->visualRect(m_model->index(0, 0));
+    const int cellWidth = firstRect.width() + m_listView->spacing();
+    const int cellHeight = firstRect.height() + m_listView->spacing();
+    if (firstRect.isEmpty() || cellWidth <= 0 || cellHeight <= 0)
+        return;
+
+    const QRect viewport = m_listView->viewport()->rect();
+    const int perRow =
+        qMax(1, (viewport.width() - firstRect.left()) / cellWidth);
+    const int hiddenRows = qMax(0, (viewport.top() - firstRect.top()) /
+                                       cellHeight);
+    const int shownRows = viewport.height() / cellHeight + 2;
+
+    const int first = qMin(rows - 1, hiddenRows * perRow);
+    const int last = qMin(rows - 1, first + shownRows * perRow - 1);
+    m_model->setVisibleRange(first, last);
 }
 
 void GalleryWidget::loadAlbumList()
@@ -418,6 +501,13 @@ void GalleryWidget::loadAlbumList()
              << dcimTree.entries.size() << "entries";
 
     auto *albumModel = new QStandardItemModel(this);
+    m_albumPaths.clear();
+
+    // Timeline over all albums, an empty path selects it
+    auto *allItem = new QStandardItem("All Photos");
+    allItem->setData(QString(), Qt::UserRole);
+    allItem->setIcon(QIcon::fromTheme("folder-pictures"));
+    albumModel->appendRow(allItem);
 
     for (const MediaEntry &entry : dcimTree.entries) {
         QString albumName = QString::fromStdString(entry.name);
@@ -437,12 +527,12 @@ void GalleryWidget::loadAlbumList()
 
             item->setIcon(QIcon::fromTheme("folder"));
             albumModel->appendRow(item);
-
-            loadAlbumThumbnailAsync(fullPath, item);
+            m_albumPaths.append(fullPath);
         }
     }
 
     m_albumListView->setModel(albumModel);
+    loadAlbumCovers(albumModel);
 }
 
 void GalleryWidget::onAlbumSelected(const QString &albumPath)
@@ -452,6 +542,8 @@ void GalleryWidget::onAlbumSelected(const QString &albumPath)
     // Create model if not exists
     if (!m_model) {
         m_model = new PhotoModel(m_device, getCurrentFilterType(), this);
+        m_model->setDuplicateScanEnabled(
+            m_skipDuplicatesCheckBox->isChecked());
         m_listView->setModel(m_model);
 
         // Update export button states based on selection
@@ -461,10 +553,21 @@ void GalleryWidget::onAlbumSelected(const QString &albumPath)
                         m_listView->selectionModel()->hasSelection();
                     m_exportSelectedButton->setEnabled(hasSelection);
                 });
+
+        connect(m_model, &QAbstractItemModel::rowsInserted,
+                m_visibleRangeTimer, qOverload<>(&QTimer::start));
+        connect(m_model, &QAbstractItemModel::modelReset, m_visibleRangeTimer,
+                qOverload<>(&QTimer::start));
+        connect(m_model, &QAbstractItemModel::layoutChanged,
+                m_visibleRangeTimer, qOverload<>(&QTimer::start));
     }
 
-    // Set album path and load photos
-    m_model->setAlbumPath(albumPath);
+    // Set album path and load photos, the timeline keeps its rows when
+    // coming back to it
+    if (albumPath.isEmpty())
+        m_model->setAlbumPaths(m_albumPaths);
+    else
+        m_model->setAlbumPath(albumPath);
 
     // Switch to photo gallery view
     m_stackedWidget->setCurrentWidget(m_photoGalleryWidget);
@@ -494,23 +597,44 @@ void GalleryWidget::setControlsEnabled(bool enabled)
     m_exportSelectedButton->setEnabled(
         enabled && m_listView && m_listView->selectionModel()->hasSelection());
     m_exportAllButton->setEnabled(enabled);
+    m_skipDuplicatesCheckBox->setEnabled(enabled);
 }
 
 /*
-    FIXME: this needs to be refactored once we
-    figure out how to query Photos.sqlite
-    Check out:
-    https://github.com/ScottKjr3347/iOS_Local_PL_Photos.sqlite_Queries
+  Covers live in the album's thumbnail pack under a pseudo file keyed by the
+  album directory's st_size and st_mtime. Both change when files are added
+  or removed, so an unchanged album costs a single stat.
 */
-QIcon GalleryWidget::loadAlbumThumbnail(const QString &albumPath)
+QImage GalleryWidget::loadAlbumCover(iDescriptorDevice *device,
+                                     const QString &albumPath)
 {
-    // Get album directory contents
-    AFCFileTree albumTree =
-        ServiceManager::safeGetFileTree(m_device, albumPath.toStdString());
+    quint64 dirSize = 0;
+    uint64_t dirMtime = 0;
+    plist_t info = nullptr;
+    if (ServiceManager::safeAfcGetFileInfoPlist(
+            device, albumPath.toUtf8().constData(), &info) == AFC_E_SUCCESS &&
+        info) {
+        dirSize = PlistNavigator(info)["st_size"].getUInt();
+        dirMtime = PlistNavigator(info)["st_mtime"].getUInt();
+        plist_free(info);
+    }
+
+    const QString udid = QString::fromStdString(device->udid);
+    const ThumbnailKey key{albumPath + "/.cover", dirSize,
+                           static_cast<qint64>(dirMtime), QSize(120, 120)};
+    const bool cacheable = dirMtime != 0;
+    if (cacheable) {
+        QImage cached =
+            ThumbnailCache::sharedInstance()->lookup(udid, albumPath, key);
+        if (!cached.isNull())
+            return cached;
+    }
 
+    AFCFileTree albumTree =
+        ServiceManager::safeGetFileTree(device, albumPath.toStdString());
     if (!albumTree.success) {
         qDebug() << "Failed to read album directory:" << albumPath;
-        return QIcon();
+        return {};
     }
 
     // Find the first image file
@@ -528,62 +652,70 @@ QIcon GalleryWidget::loadAlbumThumbnail(const QString &albumPath)
 
     if (firstImagePath.isEmpty()) {
         qDebug() << "No images found in album:" << albumPath;
-        return QIcon();
-    }
-
-    // Load the thumbnail using ServiceManager
-    QByteArray imageData = ServiceManager::safeReadAfcFileToByteArray(
-        m_device, firstImagePath.toUtf8().constData());
-
-    if (imageData.isEmpty()) {
-        qDebug() << "Could not read image data for thumbnail:"
-                 << firstImagePath;
-        return QIcon();
-    }
-
-    QPixmap thumbnail;
-
-    if (firstImagePath.endsWith(".HEIC", Qt::CaseInsensitive)) {
-        qDebug() << "Loading HEIC thumbnail from:" << firstImagePath;
-        thumbnail = load_heic(imageData);
-    } else {
-        // Load regular image formats
-        if (!thumbnail.loadFromData(imageData)) {
-            qDebug() << "Could not decode image data for thumbnail:"
-                     << firstImagePath;
-            return QIcon();
-        }
+        return {};
     }
 
-    if (thumbnail.isNull()) {
+    // Same path as the grid thumbnails, the embedded preview is usually
+    // enough and saves downloading the whole image
+    QImage cover = PhotoModel::loadThumbnailFromDevice(device, firstImagePath,
+                                                       key.size)
+                       .toImage();
+    if (cover.isNull()) {
         qDebug() << "Failed to load thumbnail from:" << firstImagePath;
-        return QIcon();
+        return {};
     }
 
-    return QIcon(thumbnail);
+    if (cacheable)
+        ThumbnailCache::sharedInstance()->store(udid, albumPath, key, cover);
+    return cover;
 }
 
-void GalleryWidget::loadAlbumThumbnailAsync(const QString &albumPath,
-                                            QStandardItem *item)
+// One background task walks all albums in turn instead of a task per album,
+// covers are applied as they come in
+void GalleryWidget::loadAlbumCovers(QStandardItemModel *albumModel)
 {
-    // Create a future watcher to handle the async result
-    auto *watcher = new QFutureWatcher<QIcon>(this);
-
-    // Connect the finished signal to update the item icon
-    connect(watcher, &QFutureWatcher<QIcon>::finished, this, [watcher, item]() {
-        QIcon result = watcher->result();
-        if (!result.isNull()) {
-            item->setIcon(result);
-        }
-        // The item keeps the folder icon if thumbnail loading fails
-        watcher->deleteLater();
-    });
+    if (m_albumCoverWatcher) {
+        m_albumCoverWatcher->cancel();
+        m_albumCoverWatcher->deleteLater();
+    }
 
-    // Start the async operation
-    QFuture<QIcon> future = QtConcurrent::run(
-        [this, albumPath]() { return loadAlbumThumbnail(albumPath); });
+    auto *watcher = new QFutureWatcher<AlbumCover>(this);
+    m_albumCoverWatcher = watcher;
+
+    // The album list may be rebuilt with a new model while covers load
+    const QPointer<QStandardItemModel> model(albumModel);
+    connect(watcher, &QFutureWatcher<AlbumCover>::resultReadyAt, this,
+            [watcher, model](int index) {
+                if (!model)
+                    return;
+                const AlbumCover cover = watcher->resultAt(index);
+                for (int row = 0; row < model->rowCount(); ++row) {
+                    QStandardItem *item = model->item(row);
+                    if (item->data(Qt::UserRole).toString() == cover.first) {
+                        item->setIcon(QIcon(QPixmap::fromImage(cover.second)));
+                        break;
+                    }
+                }
+            });
+    connect(watcher, &QFutureWatcher<AlbumCover>::finished, this,
+            [this, watcher]() {
+                if (m_albumCoverWatcher == watcher)
+                    m_albumCoverWatcher = nullptr;
+                watcher->deleteLater();
+            });
 
-    watcher->setFuture(future);
+    iDescriptorDevice *device = m_device;
+    const QStringList albumPaths = m_albumPaths;
+    watcher->setFuture(QtConcurrent::run(
+        [device, albumPaths](QPromise<AlbumCover> &promise) {
+            for (const QString &albumPath : albumPaths) {
+                if (promise.isCanceled())
+                    return;
+                QImage cover = loadAlbumCover(device, albumPath);
+                if (!cover.isNull())
+                    promise.addResult(AlbumCover{albumPath, cover});
+            }
+        }));
 }
 
 void GalleryWidget::onPhotoContextMenu(const QPoint &pos)
@@ -606,21 +738,8 @@ void GalleryWidget::onPhotoContextMenu(const QPoint &pos)
 
     exportAction->setEnabled(m_listView->selectionModel()->hasSelection());
 
-    connect(previewAction, &QAction::triggered, this, [this, index]() {
-        // Re-use the double-click logic
-        if (!index.isValid())
-            return;
-
-        QString filePath = m_model->data(index, Qt::UserRole).toString();
-        if (filePath.isEmpty())
-            return;
-
-        qDebug() << "Opening preview for" << filePath;
-        auto *previewDialog = new MediaPreviewDialog(
-            m_device, m_device->afcClient, filePath, this);
-        previewDialog->setAttribute(Qt::WA_DeleteOnClose);
-        previewDialog->show();
-    });
+    connect(previewAction, &QAction::triggered, this,
+            [this, index]() { openPreview(index); });
 
     connect(exportAction, &QAction::triggered, this,
             &GalleryWidget::onExportSelected);
@@ -628,7 +747,32 @@ void GalleryWidget::onPhotoContextMenu(const QPoint &pos)
     contextMenu.exec(m_listView->viewport()->mapToGlobal(pos));
 }
 
+void GalleryWidget::openPreview(const QModelIndex &index)
+{
+    if (!index.isValid())
+        return;
+
+    QString filePath = m_model->data(index, Qt::UserRole).toString();
+    if (filePath.isEmpty())
+        return;
+
+    // Rows map 1:1 to the filtered paths, which the dialog steps through
+    qDebug() << "Opening preview for" << filePath;
+    const QPointer<PhotoModel> model(m_model);
+    auto *previewDialog = new MediaPreviewDialog(
+        m_device, m_device->afcClient, m_model->getFilteredFilePaths(),
+        index.row(),
+        [model](const QString &path) {
+            return model ? model->cachedThumbnail(path) : QImage();
+        },
+        this);
+    previewDialog->setAttribute(Qt::WA_DeleteOnClose);
+    previewDialog->show();
+}
+
 GalleryWidget::~GalleryWidget()
 {
+    if (m_albumCoverWatcher)
+        m_albumCoverWatcher->cancel();
     qDebug() << "GalleryWidget destructor called";
 }
\ No newline at end of file
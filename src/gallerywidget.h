@@ -27,12 +27,15 @@
 QT_BEGIN_NAMESPACE
 class QListView;
 class QComboBox;
+class QCheckBox;
 class QPushButton;
 class QHBoxLayout;
 class QVBoxLayout;
 class QStackedWidget;
 class QLabel;
 class QStandardItem;
+class QStandardItemModel;
+class QTimer;
 QT_END_NAMESPACE
 
 class ExportManager;
@@ -64,14 +67,19 @@ private:
     void loadAlbumList();
     void setControlsEnabled(bool enabled);
     QString selectExportDirectory();
-    QIcon loadAlbumThumbnail(const QString &albumPath);
-    void loadAlbumThumbnailAsync(const QString &albumPath, QStandardItem *item);
+    bool removeDuplicatesForExport(QStringList &filePaths);
+    static QImage loadAlbumCover(iDescriptorDevice *device,
+                                 const QString &albumPath);
+    void loadAlbumCovers(QStandardItemModel *albumModel);
     void onPhotoContextMenu(const QPoint &pos);
+    void updateVisibleRange();
+    void openPreview(const QModelIndex &index);
     PhotoModel::FilterType getCurrentFilterType() const;
 
     iDescriptorDevice *m_device;
     bool m_loaded = false;
-    QString m_currentAlbumPath;
+    QString m_currentAlbumPath; // empty while showing the timeline
+    QStringList m_albumPaths;   // every DCIM album, merged by the timeline
 
     // UI components
     QVBoxLayout *m_mainLayout;
@@ -81,17 +89,22 @@ private:
     // Album selection view
     QWidget *m_albumSelectionWidget;
     QListView *m_albumListView;
+    // (album path, cover) as the background batch produces them
+    using AlbumCover = QPair<QString, QImage>;
+    QFutureWatcher<AlbumCover> *m_albumCoverWatcher = nullptr;
 
     // Photo gallery view
     QWidget *m_photoGalleryWidget;
     QListView *m_listView;
     PhotoModel *m_model;
+    QTimer *m_visibleRangeTimer = nullptr;
 
     // Control widgets
     QComboBox *m_sortComboBox;
     QComboBox *m_filterComboBox;
     QPushButton *m_exportSelectedButton;
     QPushButton *m_exportAllButton;
+    QCheckBox *m_skipDuplicatesCheckBox;
     QPushButton *m_backButton;
 
     // Export manager
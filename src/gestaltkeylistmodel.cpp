@@ -0,0 +1,119 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "gestaltkeylistmodel.h"
+#include <algorithm>
+
+GestaltKeyListModel::GestaltKeyListModel(const QStringList &keys,
+                                         QObject *parent)
+    : QAbstractListModel(parent), m_keys(keys)
+{
+}
+
+int GestaltKeyListModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_keys.size();
+}
+
+bool GestaltKeyListModel::isChecked(int row) const
+{
+    return m_defaultChecked != m_toggled.contains(row);
+}
+
+QVariant GestaltKeyListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_keys.size())
+        return QVariant();
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::ToolTipRole:
+        return m_keys.at(index.row());
+    case Qt::CheckStateRole:
+        return isChecked(index.row()) ? Qt::Checked : Qt::Unchecked;
+    default:
+        return QVariant();
+    }
+}
+
+bool GestaltKeyListModel::setData(const QModelIndex &index,
+                                  const QVariant &value, int role)
+{
+    if (!index.isValid() || role != Qt::CheckStateRole)
+        return false;
+
+    const int row = index.row();
+    const bool checked = value.toInt() == Qt::Checked;
+    if (checked == isChecked(row))
+        return true;
+
+    if (checked == m_defaultChecked)
+        m_toggled.remove(row);
+    else
+        m_toggled.insert(row);
+
+    emit dataChanged(index, index, {Qt::CheckStateRole});
+    emit checkedCountChanged(checkedCount());
+    return true;
+}
+
+Qt::ItemFlags GestaltKeyListModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return Qt::NoItemFlags;
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsUserCheckable;
+}
+
+void GestaltKeyListModel::setAllChecked(bool checked)
+{
+    m_defaultChecked = checked;
+    m_toggled.clear();
+    if (!m_keys.isEmpty()) {
+        // the view only repaints the rows it is showing
+        emit dataChanged(index(0), index(m_keys.size() - 1),
+                         {Qt::CheckStateRole});
+    }
+    emit checkedCountChanged(checkedCount());
+}
+
+QStringList GestaltKeyListModel::checkedKeys() const
+{
+    QStringList keys;
+    if (!m_defaultChecked) {
+        // keep the original key order
+        QList<int> rows(m_toggled.cbegin(), m_toggled.cend());
+        std::sort(rows.begin(), rows.end());
+        for (int row : rows)
+            keys.append(m_keys.at(row));
+        return keys;
+    }
+    for (int row = 0; row < m_keys.size(); ++row) {
+        if (!m_toggled.contains(row))
+            keys.append(m_keys.at(row));
+    }
+    return keys;
+}
+
+int GestaltKeyListModel::checkedCount() const
+{
+    return m_defaultChecked ? m_keys.size() - m_toggled.size()
+                            : m_toggled.size();
+}
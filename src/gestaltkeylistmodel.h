@@ -0,0 +1,64 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GESTALTKEYLISTMODEL_H
+#define GESTALTKEYLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QSet>
+#include <QStringList>
+
+/**
+ * @brief Checkable list of MobileGestalt keys
+ *
+ * Check state is stored as a default plus the set of rows that differ from
+ * it, so select all / clear all only reset that set instead of touching
+ * every row.
+ */
+class GestaltKeyListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit GestaltKeyListModel(const QStringList &keys,
+                                 QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index,
+                  int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex &index, const QVariant &value,
+                 int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+    void setAllChecked(bool checked);
+    QStringList checkedKeys() const;
+    int checkedCount() const;
+
+signals:
+    void checkedCountChanged(int count);
+
+private:
+    bool isChecked(int row) const;
+
+    QStringList m_keys;
+    bool m_defaultChecked = false;
+    QSet<int> m_toggled;
+};
+
+#endif // GESTALTKEYLISTMODEL_H
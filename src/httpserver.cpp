@@ -20,7 +20,7 @@
 #include "httpserver.h"
 #include "iDescriptor.h"
 #include <QDateTime>
-#include <QFile>
+#include <QDebug>
 #include <QFileInfo>
 #include <QJsonArray>
 #include <QJsonDocument>
@@ -28,201 +28,568 @@
 #include <QMimeDatabase>
 #include <QNetworkInterface>
 #include <QRandomGenerator>
+#include <QSet>
 #include <QUrl>
+#include <functional>
+#include <utility>
+
+static constexpr qint64 CHUNK_SIZE = 256 * 1024;
+// More of the file is written once the socket has less than this to send
+static constexpr qint64 SOCKET_BUFFER_LOW = 1024 * 1024;
+// Progress is reported every this many bytes
+static constexpr qint64 PROGRESS_STEP = 1024 * 1024;
+// Requests with a larger header are refused
+static constexpr int MAX_HEADER_SIZE = 16 * 1024;
+// GET and HEAD carry no body, anything bigger is not a request for us
+static constexpr qint64 MAX_BODY_SIZE = 64 * 1024;
+// Idle keep-alive connections are closed after this long
+static constexpr int KEEP_ALIVE_TIMEOUT_MS = 30000;
+static constexpr int WORKER_THREADS = 4;
+
+namespace
+{
+// Hands accepted sockets to a callback instead of queueing QTcpSockets, so
+// they can be created on a worker thread
+class HttpListener : public QTcpServer
+{
+public:
+    using QTcpServer::QTcpServer;
+    std::function<void(qintptr)> onConnection;
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override
+    {
+        onConnection(socketDescriptor);
+    }
+};
 
-HttpServer::HttpServer(QObject *parent)
-    : QObject(parent), server(new QTcpServer(this)), port(8080)
+QString statusText(int statusCode)
 {
-    connect(server, &QTcpServer::newConnection, this,
-            &HttpServer::onNewConnection);
+    switch (statusCode) {
+    case 200:
+        return "OK";
+    case 206:
+        return "Partial Content";
+    case 400:
+        return "Bad Request";
+    case 404:
+        return "Not Found";
+    case 405:
+        return "Method Not Allowed";
+    case 416:
+        return "Range Not Satisfiable";
+    case 431:
+        return "Request Header Fields Too Large";
+    case 500:
+        return "Internal Server Error";
+    default:
+        return "Unknown";
+    }
 }
+} // namespace
 
-HttpServer::~HttpServer() { stop(); }
+HttpWorker::HttpWorker(std::shared_ptr<const HttpFileIndex> index)
+    : m_index(std::move(index))
+{
+}
 
-void HttpServer::start(const QStringList &files)
+HttpWorker::~HttpWorker()
 {
-    fileList = files;
+    const QList<Connection *> connections = m_connections.values();
+    for (Connection *connection : connections)
+        closeConnection(connection);
+}
 
-    // Generate unique JSON filename
-    QString timestamp =
-        QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss");
-    jsonFileName = QString("%1-idescriptor-import.json").arg(timestamp);
+void HttpWorker::handleConnection(qintptr socketDescriptor)
+{
+    auto *socket = new QTcpSocket(this);
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        qWarning() << "HttpServer: Failed to set socket descriptor";
+        socket->deleteLater();
+        return;
+    }
 
-    // Try to bind to port 8080, if fails try other ports
-    for (int tryPort = 8080; tryPort <= 8090; ++tryPort) {
-        if (server->listen(QHostAddress::Any, tryPort)) {
-            port = tryPort;
-            emit serverStarted();
-            return;
+    auto *connection = new Connection();
+    connection->socket = socket;
+    connection->idleTimer = new QTimer(socket);
+    connection->idleTimer->setSingleShot(true);
+    connection->idleTimer->setInterval(KEEP_ALIVE_TIMEOUT_MS);
+    m_connections.insert(socket, connection);
+
+    // Lives as long as the socket, so handlers running when the connection
+    // is closed can still look at it
+    connect(socket, &QObject::destroyed, [connection]() { delete connection; });
+
+    connect(socket, &QTcpSocket::readyRead, this, [this, connection]() {
+        connection->pending += connection->socket->readAll();
+        processRequests(connection);
+    });
+    connect(socket, &QTcpSocket::bytesWritten, this, [this, connection]() {
+        if (connection->sending &&
+            connection->socket->bytesToWrite() < SOCKET_BUFFER_LOW) {
+            writeNextChunk(connection);
         }
-    }
+    });
+    connect(socket, &QTcpSocket::disconnected, this,
+            [this, connection]() { closeConnection(connection); });
+    connect(connection->idleTimer, &QTimer::timeout, this,
+            [this, connection]() { closeConnection(connection); });
 
-    emit serverError("Could not bind to any port between 8080-8090");
+    connection->idleTimer->start();
 }
 
-void HttpServer::stop()
+void HttpWorker::closeConnection(Connection *connection)
 {
-    if (server->isListening()) {
-        server->close();
-    }
-}
+    if (connection->closed)
+        return;
+    connection->closed = true;
+    endTransfer(connection);
+    m_connections.remove(connection->socket);
 
-int HttpServer::getPort() const { return port; }
+    disconnect(connection->socket, nullptr, this, nullptr);
+    disconnect(connection->idleTimer, nullptr, this, nullptr);
+    connection->idleTimer->stop();
 
-void HttpServer::onNewConnection()
-{
-    QTcpSocket *socket = server->nextPendingConnection();
-    connect(socket, &QTcpSocket::readyRead, this, &HttpServer::onReadyRead);
-    connect(socket, &QTcpSocket::disconnected, this,
-            &HttpServer::onDisconnected);
+    // Sends what is still buffered first
+    connection->socket->disconnectFromHost();
+    connection->socket->deleteLater();
 }
 
-void HttpServer::onReadyRead()
+// Answers complete requests in the buffer, one at a time
+void HttpWorker::processRequests(Connection *connection)
 {
-    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
-    if (!socket)
-        return;
+    while (!connection->closed && !connection->sending) {
+        connection->headOnly = false;
+        const qsizetype headerEnd = connection->pending.indexOf("\r\n\r\n");
+        if (headerEnd < 0) {
+            if (connection->pending.size() > MAX_HEADER_SIZE) {
+                connection->keepAlive = false;
+                sendResponse(connection, 431, "text/plain",
+                             statusText(431).toUtf8());
+            }
+            return;
+        }
 
-    QByteArray data = socket->readAll();
-    QString request = QString::fromUtf8(data);
+        HttpRequest request;
+        const bool valid =
+            parseHttpRequest(connection->pending.left(headerEnd), request);
+        bool lengthOk = true;
+        const qint64 bodyLength =
+            request.headers.value("content-length", "0").toLongLong(&lengthOk);
+        if (!valid || !lengthOk || bodyLength < 0 ||
+            bodyLength > MAX_BODY_SIZE) {
+            connection->keepAlive = false;
+            sendResponse(connection, 400, "text/plain",
+                         statusText(400).toUtf8());
+            return;
+        }
 
-    // Parse HTTP request
-    QStringList lines = request.split("\r\n");
-    if (lines.isEmpty())
-        return;
+        // Wait for the body, then drop it along with the request
+        const qsizetype requestSize = headerEnd + 4 + bodyLength;
+        if (connection->pending.size() < requestSize)
+            return;
+        connection->pending.remove(0, requestSize);
 
-    QString requestLine = lines.first();
-    QStringList parts = requestLine.split(" ");
-    if (parts.size() < 2)
-        return;
+        connection->idleTimer->stop();
+        connection->keepAlive = request.keepAlive;
+        connection->headOnly = request.method == "HEAD";
+        handleRequest(connection, request);
+    }
+}
 
-    QString method = parts[0];
-    QString path = parts[1];
+bool HttpWorker::parseHttpRequest(const QByteArray &header,
+                                  HttpRequest &request)
+{
+    const QStringList lines = QString::fromUtf8(header).split("\r\n");
 
-    if (method == "GET") {
-        handleRequest(socket, path);
-    } else {
-        sendResponse(socket, 405, "text/plain", "Method Not Allowed");
+    // Request line: "GET /path HTTP/1.1"
+    const QStringList requestLine = lines[0].split(" ");
+    if (requestLine.size() != 3 || !requestLine[2].startsWith("HTTP/1.")) {
+        return false;
+    }
+    request.method = requestLine[0];
+    request.path = requestLine[1];
+    request.httpVersion = requestLine[2];
+
+    for (int i = 1; i < lines.size(); ++i) {
+        const int colonPos = lines[i].indexOf(':');
+        if (colonPos > 0) {
+            request.headers[lines[i].left(colonPos).trimmed().toLower()] =
+                lines[i].mid(colonPos + 1).trimmed();
+        }
     }
+
+    // HTTP/1.1 keeps the connection unless told otherwise, 1.0 the reverse
+    const QString connectionHeader =
+        request.headers.value("connection").toLower();
+    request.keepAlive = request.httpVersion == "HTTP/1.1"
+                            ? !connectionHeader.contains("close")
+                            : connectionHeader.contains("keep-alive");
+
+    // A single byte range; anything else is ignored and the whole file sent
+    const QString range = request.headers.value("range");
+    if (range.startsWith("bytes=") && !range.contains(',')) {
+        const QStringList parts = range.mid(6).split('-');
+        bool startOk = true;
+        bool endOk = true;
+        if (parts.size() == 2) {
+            request.rangeStart =
+                parts[0].isEmpty() ? -1 : parts[0].toLongLong(&startOk);
+            request.rangeEnd =
+                parts[1].isEmpty() ? -1 : parts[1].toLongLong(&endOk);
+            request.hasRange = startOk && endOk && request.rangeStart >= -1 &&
+                               !(parts[0].isEmpty() && parts[1].isEmpty());
+        }
+    }
+
+    return true;
 }
 
-void HttpServer::onDisconnected()
+QByteArray HttpWorker::connectionHeaders(const Connection *connection) const
 {
-    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
-    if (socket) {
-        socket->deleteLater();
-    }
+    if (!connection->keepAlive)
+        return "Connection: close\r\n";
+    return QString("Connection: keep-alive\r\n"
+                   "Keep-Alive: timeout=%1\r\n")
+        .arg(KEEP_ALIVE_TIMEOUT_MS / 1000)
+        .toUtf8();
 }
 
-void HttpServer::handleRequest(QTcpSocket *socket, const QString &path)
+void HttpWorker::handleRequest(Connection *connection,
+                               const HttpRequest &request)
 {
+    if (request.method != "GET" && request.method != "HEAD") {
+        sendResponse(connection, 405, "text/plain", "Method Not Allowed");
+        return;
+    }
+
+    const QString path = request.path.section('?', 0, 0);
+
     // Serve JSON manifest
-    if (path == QString("/%1").arg(jsonFileName)) {
-        sendJsonManifest(socket);
+    if (path == m_index->manifestPath) {
+        sendResponse(connection, 200, "application/json", m_index->manifest);
         return;
     }
 
     // Serve files from /serve/ directory
     if (path.startsWith("/serve/")) {
-        QString encodedFileName = path.mid(7); // Remove "/serve/"
-        QString fileName = QUrl::fromPercentEncoding(encodedFileName.toUtf8());
-
-        // Find the file in our list
-        QString targetFile;
-        for (const QString &file : fileList) {
-            QFileInfo info(file);
-            if (info.fileName() == fileName) {
-                targetFile = file;
-                break;
-            }
-        }
-
-        if (!targetFile.isEmpty()) {
-            sendFile(socket, targetFile);
+        const QString fileName =
+            QUrl::fromPercentEncoding(path.mid(7).toUtf8());
+        auto it = m_index->files.constFind(fileName);
+        if (it != m_index->files.constEnd()) {
+            sendFile(connection, *it, fileName, request);
             return;
         }
     }
 
-    sendResponse(socket, 404, "text/html",
+    sendResponse(connection, 404, "text/html",
                  "<html><body><h1>404 Not Found</h1><p>The requested file was "
                  "not found.</p></body></html>");
 }
 
-void HttpServer::sendResponse(QTcpSocket *socket, int statusCode,
+void HttpWorker::sendResponse(Connection *connection, int statusCode,
                               const QString &contentType,
-                              const QByteArray &data)
+                              const QByteArray &data,
+                              const QByteArray &extraHeaders)
 {
-    QString statusText;
-    switch (statusCode) {
-    case 200:
-        statusText = "OK";
-        break;
-    case 404:
-        statusText = "Not Found";
-        break;
-    case 405:
-        statusText = "Method Not Allowed";
-        break;
-    case 500:
-        statusText = "Internal Server Error";
-        break;
-    default:
-        statusText = "Unknown";
-        break;
-    }
-
-    QString response =
-        QString("HTTP/1.1 %1 %2\r\n").arg(statusCode).arg(statusText);
+    QString response = QString("HTTP/1.1 %1 %2\r\n")
+                           .arg(statusCode)
+                           .arg(statusText(statusCode));
     response += QString("Content-Type: %1\r\n").arg(contentType);
     response += QString("Content-Length: %1\r\n").arg(data.size());
     response += "Access-Control-Allow-Origin: *\r\n";
-    response += "Connection: close\r\n";
-    response += "\r\n";
 
-    socket->write(response.toUtf8());
-    socket->write(data);
-    socket->disconnectFromHost();
+    connection->socket->write(response.toUtf8() + extraHeaders +
+                              connectionHeaders(connection) + "\r\n");
+    if (!connection->headOnly)
+        connection->socket->write(data);
+    finishResponse(connection);
+}
+
+void HttpWorker::sendFile(Connection *connection,
+                          const HttpFileIndex::Entry &entry,
+                          const QString &fileName, const HttpRequest &request)
+{
+    auto *file = new QFile(entry.path, connection->socket);
+    if (!file->open(QIODevice::ReadOnly)) {
+        delete file;
+        sendResponse(connection, 404, "text/plain", "File not found");
+        return;
+    }
+    const qint64 fileSize = file->size();
+
+    qint64 rangeStart = 0;
+    qint64 rangeEnd = fileSize - 1;
+    if (request.hasRange) {
+        if (request.rangeStart < 0) {
+            // Suffix range, the last rangeEnd bytes
+            rangeStart = request.rangeEnd > 0
+                             ? qMax<qint64>(0, fileSize - request.rangeEnd)
+                             : fileSize;
+        } else {
+            rangeStart = request.rangeStart;
+            if (request.rangeEnd >= 0 && request.rangeEnd < fileSize)
+                rangeEnd = request.rangeEnd;
+        }
+
+        if (rangeStart >= fileSize || rangeStart > rangeEnd) {
+            delete file;
+            sendResponse(connection, 416, "text/plain", QByteArray(),
+                         QString("Content-Range: bytes */%1\r\n")
+                             .arg(fileSize)
+                             .toUtf8());
+            return;
+        }
+    }
+    const qint64 contentLength = rangeEnd - rangeStart + 1;
+
+    QString header;
+    if (request.hasRange) {
+        header = "HTTP/1.1 206 Partial Content\r\n";
+        header += QString("Content-Range: bytes %1-%2/%3\r\n")
+                      .arg(rangeStart)
+                      .arg(rangeEnd)
+                      .arg(fileSize);
+    } else {
+        header = "HTTP/1.1 200 OK\r\n";
+    }
+    header += "Accept-Ranges: bytes\r\n";
+    header += QString("Content-Type: %1\r\n").arg(entry.mimeType);
+    header += QString("Content-Length: %1\r\n").arg(contentLength);
+    header += "Access-Control-Allow-Origin: *\r\n";
+    connection->socket->write(header.toUtf8() + connectionHeaders(connection) +
+                              "\r\n");
+
+    if (connection->headOnly || contentLength == 0) {
+        delete file;
+        finishResponse(connection);
+        return;
+    }
+
+    // Mapped pages go to the socket buffer without a read buffer in between
+    connection->mapped = file->map(0, fileSize);
+    if (!connection->mapped)
+        file->seek(rangeStart);
+
+    connection->sending = true;
+    connection->file = file;
+    connection->fileName = fileName;
+    connection->fileSize = fileSize;
+    connection->position = rangeStart;
+    connection->bytesRemaining = contentLength;
+    connection->reported = rangeStart;
+    emit downloadProgress(fileName, rangeStart, fileSize);
+    writeNextChunk(connection);
+}
+
+// Keeps up to SOCKET_BUFFER_LOW of the file queued on the socket,
+// bytesWritten brings us back for the rest
+void HttpWorker::writeNextChunk(Connection *connection)
+{
+    if (connection->closed || !connection->sending)
+        return;
+    QTcpSocket *socket = connection->socket;
+
+    while (connection->bytesRemaining > 0 &&
+           socket->bytesToWrite() < SOCKET_BUFFER_LOW) {
+        const qint64 length = qMin(CHUNK_SIZE, connection->bytesRemaining);
+        qint64 written = -1;
+        if (connection->mapped) {
+            written = socket->write(
+                reinterpret_cast<const char *>(connection->mapped) +
+                    connection->position,
+                length);
+        } else {
+            const QByteArray chunk = connection->file->read(length);
+            if (!chunk.isEmpty())
+                written = socket->write(chunk);
+        }
+
+        // The response promised more bytes, the connection cannot be reused
+        if (written <= 0) {
+            qWarning() << "HttpServer: Failed to send" << connection->fileName;
+            closeConnection(connection);
+            return;
+        }
+        connection->position += written;
+        connection->bytesRemaining -= written;
+    }
+
+    if (connection->bytesRemaining > 0) {
+        // What the socket has passed on to the system so far
+        const qint64 delivered = connection->position - socket->bytesToWrite();
+        if (delivered - connection->reported >= PROGRESS_STEP) {
+            connection->reported = delivered;
+            emit downloadProgress(connection->fileName, delivered,
+                                  connection->fileSize);
+        }
+        return;
+    }
+
+    emit downloadProgress(connection->fileName, connection->position,
+                          connection->fileSize);
+    finishResponse(connection);
+    // Requests pipelined behind this one, from the event loop so a run of
+    // small ranges does not recurse
+    QTimer::singleShot(0, socket,
+                       [this, connection]() { processRequests(connection); });
+}
+
+void HttpWorker::endTransfer(Connection *connection)
+{
+    connection->sending = false;
+    connection->mapped = nullptr;
+    if (connection->file) {
+        // Closing the file also unmaps it
+        connection->file->close();
+        connection->file->deleteLater();
+        connection->file = nullptr;
+    }
+}
+
+// Ends the response in progress; the connection either waits for the next
+// request or is closed
+void HttpWorker::finishResponse(Connection *connection)
+{
+    endTransfer(connection);
+    if (!connection->keepAlive) {
+        closeConnection(connection);
+        return;
+    }
+    connection->idleTimer->start();
+}
+
+HttpServer::HttpServer(QObject *parent)
+    : QObject(parent), server(new HttpListener(this)), port(8080)
+{
+    static_cast<HttpListener *>(server)->onConnection =
+        [this](qintptr socketDescriptor) {
+            onNewConnection(socketDescriptor);
+        };
 }
 
-void HttpServer::sendFile(QTcpSocket *socket, const QString &filePath)
+HttpServer::~HttpServer() { stop(); }
+
+void HttpServer::start(const QStringList &files)
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        sendResponse(socket, 404, "text/plain", "File not found");
+    fileList = files;
+
+    // Generate unique JSON filename
+    QString timestamp =
+        QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss");
+    jsonFileName = QString("%1-idescriptor-import.json").arg(timestamp);
+
+    // Try to bind to port 8080, if fails try other ports
+    bool listening = false;
+    for (int tryPort = 8080; tryPort <= 8090 && !listening; ++tryPort) {
+        if (server->listen(QHostAddress::Any, tryPort)) {
+            port = tryPort;
+            listening = true;
+        }
+    }
+    if (!listening) {
+        emit serverError("Could not bind to any port between 8080-8090");
         return;
     }
 
-    QByteArray data = file.readAll();
-    QString mimeType = getMimeType(filePath);
+    // Connections are only accepted once we are back in the event loop
+    const std::shared_ptr<const HttpFileIndex> index = buildIndex();
+    for (int i = 0; i < WORKER_THREADS; ++i) {
+        auto *thread = new QThread(this);
+        thread->setObjectName(QString("HttpWorker %1").arg(i));
+        auto *worker = new HttpWorker(index);
+        worker->moveToThread(thread);
+        connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+        connect(worker, &HttpWorker::downloadProgress, this,
+                &HttpServer::downloadProgress);
+        thread->start();
+        workerThreads.append(thread);
+        workers.append(worker);
+    }
 
-    // Emit progress signal
-    QFileInfo info(filePath);
-    emit downloadProgress(info.fileName(), data.size(), data.size());
+    emit serverStarted();
+}
 
-    sendResponse(socket, 200, mimeType, data);
+void HttpServer::stop()
+{
+    if (server->isListening()) {
+        server->close();
+    }
+
+    // Workers close their connections as they are deleted
+    for (QThread *thread : std::as_const(workerThreads)) {
+        thread->quit();
+        thread->wait();
+        delete thread;
+    }
+    workerThreads.clear();
+    workers.clear();
 }
 
-void HttpServer::sendJsonManifest(QTcpSocket *socket)
+int HttpServer::getPort() const { return port; }
+
+void HttpServer::onNewConnection(qintptr socketDescriptor)
 {
-    QString jsonContent = generateJsonManifest();
-    sendResponse(socket, 200, "application/json", jsonContent.toUtf8());
+    if (workers.isEmpty())
+        return;
+    HttpWorker *worker = workers[nextWorker];
+    nextWorker = (nextWorker + 1) % workers.size();
+    QMetaObject::invokeMethod(
+        worker,
+        [worker, socketDescriptor]() {
+            worker->handleConnection(socketDescriptor);
+        },
+        Qt::QueuedConnection);
 }
 
-QString HttpServer::generateJsonManifest() const
+std::shared_ptr<const HttpFileIndex> HttpServer::buildIndex() const
+{
+    auto index = std::make_shared<HttpFileIndex>();
+    const QStringList names = servedNames();
+    for (int i = 0; i < fileList.size(); ++i) {
+        const QString &file = fileList[i];
+        index->files.insert(names[i], {file, getMimeType(file)});
+    }
+    index->manifestPath = QString("/%1").arg(jsonFileName);
+    index->manifest = generateJsonManifest(names).toUtf8();
+    return index;
+}
+
+// The name each file is served under, in fileList order. Files from
+// different folders may share a name, repeats get a counter so every one
+// stays reachable, e.g. IMG_0001.JPG and IMG_0001-2.JPG.
+QStringList HttpServer::servedNames() const
+{
+    QStringList names;
+    QSet<QString> taken;
+    for (const QString &file : fileList) {
+        const QFileInfo info(file);
+        QString name = info.fileName();
+        for (int n = 2; taken.contains(name); ++n) {
+            name = QString("%1-%2").arg(info.completeBaseName()).arg(n);
+            if (!info.suffix().isEmpty())
+                name += "." + info.suffix();
+        }
+        taken.insert(name);
+        names.append(name);
+    }
+    return names;
+}
+
+QString HttpServer::generateJsonManifest(const QStringList &names) const
 {
     QString serverIP = getLocalIP();
 
     QJsonObject manifest;
     QJsonArray items;
 
-    for (const QString &file : fileList) {
-        QFileInfo info(file);
+    for (const QString &name : names) {
         QJsonObject item;
         item["path"] = QString("http://%1:%2/serve/%3")
                            .arg(serverIP)
                            .arg(port)
                            .arg(QString::fromUtf8(
-                               QUrl::toPercentEncoding(info.fileName())));
+                               QUrl::toPercentEncoding(name)));
         items.append(item);
     }
 
@@ -20,13 +20,114 @@
 #ifndef HTTPSERVER_H
 #define HTTPSERVER_H
 
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QList>
 #include <QMap>
 #include <QObject>
 #include <QStringList>
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <QThread>
 #include <QTimer>
+#include <memory>
 
+/**
+ * @brief Files served by an HttpServer, looked up by the name in
+ * /serve/<name>. Built once by start() and only read afterwards.
+ */
+struct HttpFileIndex {
+    struct Entry {
+        QString path;
+        QString mimeType;
+    };
+    QHash<QString, Entry> files;
+    QString manifestPath;
+    QByteArray manifest;
+};
+
+/**
+ * @brief Serves the connections handed to it, on the thread it lives in
+ */
+class HttpWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HttpWorker(std::shared_ptr<const HttpFileIndex> index);
+    ~HttpWorker();
+
+    // Call on the worker's thread
+    void handleConnection(qintptr socketDescriptor);
+
+signals:
+    void downloadProgress(const QString &fileName, qint64 bytesDownloaded,
+                          qint64 totalBytes);
+
+private:
+    struct HttpRequest {
+        QString method;
+        QString path;
+        QString httpVersion;
+        QMap<QString, QString> headers;
+        bool keepAlive = true;
+        bool hasRange = false;
+        // -1 for a suffix range ("bytes=-500"), rangeEnd is then its length
+        qint64 rangeStart = 0;
+        qint64 rangeEnd = -1;
+    };
+
+    // One client connection. Requests are parsed as bytes arrive and
+    // answered in order, a pipelined request waits until the body before it
+    // has been sent.
+    struct Connection {
+        QTcpSocket *socket = nullptr;
+        QTimer *idleTimer = nullptr;
+        // Received bytes not parsed yet
+        QByteArray pending;
+        bool keepAlive = true;
+        bool closed = false;
+        bool headOnly = false;
+
+        // File body being sent, a chunk at a time
+        bool sending = false;
+        QFile *file = nullptr;
+        // The whole file if it could be mapped, otherwise it is read
+        const uchar *mapped = nullptr;
+        QString fileName;
+        qint64 fileSize = 0;
+        qint64 position = 0;
+        qint64 bytesRemaining = 0;
+        qint64 reported = 0;
+    };
+
+    static bool parseHttpRequest(const QByteArray &header,
+                                 HttpRequest &request);
+    void processRequests(Connection *connection);
+    void handleRequest(Connection *connection, const HttpRequest &request);
+    QByteArray connectionHeaders(const Connection *connection) const;
+    void sendResponse(Connection *connection, int statusCode,
+                      const QString &contentType, const QByteArray &data,
+                      const QByteArray &extraHeaders = QByteArray());
+    void sendFile(Connection *connection, const HttpFileIndex::Entry &entry,
+                  const QString &fileName, const HttpRequest &request);
+    void writeNextChunk(Connection *connection);
+    void endTransfer(Connection *connection);
+    void finishResponse(Connection *connection);
+    void closeConnection(Connection *connection);
+
+    std::shared_ptr<const HttpFileIndex> m_index;
+    QHash<QTcpSocket *, Connection *> m_connections;
+};
+
+/**
+ * @brief HTTP server the wireless photo import Shortcut downloads from
+ *
+ * Connections are spread over a few worker threads, so large downloads
+ * neither wait on the GUI nor on each other. Supports persistent
+ * connections and single byte ranges, so interrupted downloads can resume.
+ */
 class HttpServer : public QObject
 {
     Q_OBJECT
@@ -42,27 +143,22 @@ public:
 signals:
     void serverStarted();
     void serverError(const QString &error);
-    void downloadProgress(const QString &fileName, int bytesDownloaded,
-                          int totalBytes);
-
-private slots:
-    void onNewConnection();
-    void onReadyRead();
-    void onDisconnected();
+    void downloadProgress(const QString &fileName, qint64 bytesDownloaded,
+                          qint64 totalBytes);
 
 private:
     QTcpServer *server;
     QStringList fileList;
     int port;
     QString jsonFileName;
-    QMap<QString, int> downloadTracker;
-
-    void handleRequest(QTcpSocket *socket, const QString &path);
-    void sendResponse(QTcpSocket *socket, int statusCode,
-                      const QString &contentType, const QByteArray &data);
-    void sendFile(QTcpSocket *socket, const QString &filePath);
-    void sendJsonManifest(QTcpSocket *socket);
-    QString generateJsonManifest() const;
+    QList<QThread *> workerThreads;
+    QList<HttpWorker *> workers;
+    int nextWorker = 0;
+
+    void onNewConnection(qintptr socketDescriptor);
+    std::shared_ptr<const HttpFileIndex> buildIndex() const;
+    QStringList servedNames() const;
+    QString generateJsonManifest(const QStringList &names) const;
     QString getMimeType(const QString &filePath) const;
     QString getLocalIP() const;
 };
@@ -95,6 +95,24 @@ struct DiskInfo {
     uint64_t totalDataAvailable;
 };
 
+struct CableInfo {
+    bool isConnected = false;
+    bool isGenuine = false;
+    bool isTypeC = false;
+    QString manufacturer;
+    QString modelNumber;
+    QString accessoryName;
+    QString serialNumber;
+    QString interfaceModuleSerial;
+    uint64_t currentLimit = 0;
+    uint64_t chargingVoltage = 0;
+    QString connectionType;
+    QString triStarClass;
+    QStringList supportedTransports;
+    QStringList activeTransports;
+    bool isFakeInfo = false;
+};
+
 // Carefull not all the vars are initialized in init_device.cpp
 struct DeviceInfo {
     enum class ActivationState {
@@ -402,9 +420,15 @@ bool is_product_type_newer(const std::string &productType,
 bool is_product_type_older(const std::string &productType,
                            const std::string &otherProductType);
 
+/**
+ * @brief Query MobileGestalt keys in chunks over one diagnostics session
+ * @param values Receives a dict with every answered key (caller frees)
+ * @param failedKeys If set, receives the keys of chunks that got no answer
+ * @return true if at least one chunk was answered
+ */
 bool query_mobile_gestalt(iDescriptorDevice *id_device, const QStringList &keys,
-                          uint32_t &xml_size, char *&xml_data);
-;
+                          plist_t &values, QStringList *failedKeys = nullptr,
+                          int chunkSize = 100);
 
 std::string safeGetXML(const char *key, pugi::xml_node dict);
 
@@ -420,7 +444,18 @@ void fetchAppIconFromApple(QNetworkAccessManager *manager,
 
 afc_error_t afc2_client_new(idevice_t device, afc_client_t *afc);
 
-void get_cable_info(idevice_t device, plist_t &response);
+/**
+ * @brief Query IOPMPowerSource and AppleTriStarBuiltIn over one diagnostics
+ * relay session
+ * @param power Receives the IOPMPowerSource response (caller frees)
+ * @param accessory Receives the AppleTriStarBuiltIn response (caller frees)
+ * @return true if at least one of the entries could be queried
+ */
+bool get_diagnostics_snapshot(idevice_t device, plist_t &power,
+                              plist_t &accessory);
+
+void parseCableInfo(PlistNavigator &ioreg, const BatteryInfo &battery,
+                    CableInfo &c);
 
 struct NetworkDevice {
     QString name;                           // service name
@@ -435,7 +470,51 @@ struct NetworkDevice {
     }
 };
 
-QPixmap load_heic(const QByteArray &data);
+/**
+ * @brief Decode a HEIC image. With a valid targetSize the smallest embedded
+ * thumbnail covering it is decoded instead of the primary image and the
+ * result is scaled to fit targetSize.
+ * @param fullSize if set, receives the size of the primary image
+ */
+QImage load_heic(const QByteArray &data, const QSize &targetSize = QSize(),
+                 QSize *fullSize = nullptr);
+
+/**
+ * @brief Extract the EXIF block of a HEIC image as a TIFF structure, ready to
+ * go into a JPEG APP1 segment. Empty if the image carries no EXIF.
+ */
+QByteArray load_heic_exif(const QByteArray &data);
+
+/**
+ * @brief Extract the EXIF block of a JPEG image as a TIFF structure. Empty if
+ * the image carries no EXIF.
+ */
+QByteArray load_jpeg_exif(const QByteArray &data);
+
+/**
+ * @brief Set the orientation tag of an EXIF TIFF structure to upright, for
+ * images that were rotated while decoding
+ */
+void reset_exif_orientation(QByteArray &tiff);
+
+/**
+ * @brief Encode image as JPEG with exif (a TIFF structure) in an APP1
+ * segment
+ * @return empty on failure
+ */
+QByteArray encode_jpeg(const QImage &image, const QByteArray &exif,
+                       int quality);
+
+/**
+ * @brief Read the thumbnail embedded in a JPEG (EXIF) or HEIF file using
+ * small range reads instead of downloading the whole file
+ * @param fileSize st_size of the file, looked up over AFC when 0
+ * @param minSize returns a null image if the embedded thumbnail is smaller
+ * than this in both dimensions
+ * @return null image if the file has no usable embedded thumbnail
+ */
+QImage load_embedded_thumbnail(iDescriptorDevice *device, const char *path,
+                               uint64_t fileSize, const QSize &minSize);
 
 QByteArray read_afc_file_to_byte_array(afc_client_t afcClient,
                                        const char *path);
@@ -0,0 +1,303 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "importpreprocessor.h"
+#include "iDescriptor.h"
+#include "videotranscoder.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QImageReader>
+#include <QStandardPaths>
+#include <QThread>
+#include <QUuid>
+#include <QtConcurrent/QtConcurrent>
+
+// Longest side of an imported image
+static constexpr int MAX_IMAGE_DIMENSION = 4096;
+// Photos at or under MAX_IMAGE_DIMENSION are recompressed beyond this size
+static constexpr qint64 MAX_IMAGE_BYTES = 20 * 1024 * 1024;
+static constexpr int JPEG_QUALITY = 90;
+// The EXIF APP1 segment comes before the image data and is at most 64 KB
+static constexpr qint64 JPEG_HEAD_SIZE = 128 * 1024;
+// Videos converted at once
+static constexpr int VIDEO_JOBS = 2;
+static constexpr qint64 HASH_CHUNK_SIZE = 1024 * 1024;
+// Part of every cache key, change it when the outputs change
+static const QByteArray PROCESSING_VERSION = "2";
+// Outputs unused for this long are dropped, then the least recently used
+// ones until the cache fits MAX_CACHE_BYTES
+static constexpr qint64 MAX_CACHE_AGE_DAYS = 30;
+static constexpr qint64 MAX_CACHE_BYTES = 4LL * 1024 * 1024 * 1024;
+
+static bool isVideoSuffix(const QString &suffix)
+{
+    static const QStringList videoSuffixes = {"mp4", "mov", "avi", "mkv",
+                                              "m4v", "3gp", "webm"};
+    return videoSuffixes.contains(suffix);
+}
+
+static bool imageNeedsProcessing(const QString &path, const QString &suffix)
+{
+    // Photos takes these as they are, and GIFs may be animated
+    if (suffix == "heic" || suffix == "heif" || suffix == "gif")
+        return false;
+    // BMP, TIFF, WebP
+    if (suffix != "jpg" && suffix != "jpeg" && suffix != "png")
+        return true;
+
+    const QSize size = QImageReader(path).size();
+    return QFileInfo(path).size() > MAX_IMAGE_BYTES ||
+           (size.isValid() &&
+            qMax(size.width(), size.height()) > MAX_IMAGE_DIMENSION);
+}
+
+// Empty if the file cannot be read or the import was cancelled
+static QString contentHash(const QString &path,
+                           const std::atomic<bool> &cancelRequested)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(PROCESSING_VERSION);
+    while (!file.atEnd()) {
+        if (cancelRequested.load())
+            return QString();
+        const QByteArray chunk = file.read(HASH_CHUNK_SIZE);
+        if (chunk.isEmpty())
+            return QString();
+        hash.addData(chunk);
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+// Scales the image to fit MAX_IMAGE_DIMENSION and writes it to
+// outputBase.jpg, or outputBase.png if it has transparency
+static bool convertImage(const QString &path, const QString &outputBase,
+                         QString &outputSuffix)
+{
+    QImageReader reader(path);
+    reader.setAutoTransform(true);
+    const QSize size = reader.size();
+    if (size.isValid() &&
+        qMax(size.width(), size.height()) > MAX_IMAGE_DIMENSION) {
+        reader.setScaledSize(size.scaled(MAX_IMAGE_DIMENSION,
+                                         MAX_IMAGE_DIMENSION,
+                                         Qt::KeepAspectRatio));
+    }
+    const bool isJpeg = reader.format() == "jpeg";
+    const QImage image = reader.read();
+    if (image.isNull()) {
+        qWarning() << "ImportPreprocessor: Failed to read" << path << ":"
+                   << reader.errorString();
+        return false;
+    }
+
+    if (image.hasAlphaChannel()) {
+        outputSuffix = "png";
+        return image.save(outputBase + ".png", "PNG");
+    }
+
+    // Keeps the date and camera details; the image is upright by now
+    QByteArray exif;
+    if (isJpeg) {
+        QFile input(path);
+        if (input.open(QIODevice::ReadOnly))
+            exif = load_jpeg_exif(input.read(JPEG_HEAD_SIZE));
+        reset_exif_orientation(exif);
+    }
+    const QByteArray jpeg = encode_jpeg(image, exif, JPEG_QUALITY);
+
+    outputSuffix = "jpg";
+    QFile output(outputBase + ".jpg");
+    return !jpeg.isEmpty() && output.open(QIODevice::WriteOnly) &&
+           output.write(jpeg) == jpeg.size();
+}
+
+ImportPreprocessor::ImportPreprocessor(QObject *parent) : QObject(parent)
+{
+    m_videoPool.setMaxThreadCount(VIDEO_JOBS);
+}
+
+ImportPreprocessor::~ImportPreprocessor()
+{
+    cancel();
+    m_imagePool.waitForDone();
+    m_videoPool.waitForDone();
+}
+
+QString ImportPreprocessor::cacheDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           "/import";
+}
+
+// Each content hash directory holds the outputs of one input, the newest
+// file time in it says when it was last written or reused
+void ImportPreprocessor::pruneCache()
+{
+    struct Entry {
+        QString path;
+        QDateTime lastUsed;
+        qint64 size = 0;
+    };
+
+    const QDateTime cutoff =
+        QDateTime::currentDateTime().addDays(-MAX_CACHE_AGE_DAYS);
+    QList<Entry> entries;
+    qint64 total = 0;
+    const QFileInfoList dirs = QDir(cacheDirectory())
+                                   .entryInfoList(QDir::Dirs |
+                                                  QDir::NoDotAndDotDot);
+    for (const QFileInfo &dirInfo : dirs) {
+        Entry entry{dirInfo.absoluteFilePath(), dirInfo.lastModified()};
+        const QFileInfoList files =
+            QDir(entry.path).entryInfoList(QDir::Files | QDir::Hidden);
+        for (const QFileInfo &file : files) {
+            entry.size += file.size();
+            entry.lastUsed = qMax(entry.lastUsed, file.lastModified());
+        }
+        if (entry.lastUsed < cutoff) {
+            QDir(entry.path).removeRecursively();
+            continue;
+        }
+        total += entry.size;
+        entries.append(entry);
+    }
+
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry &a, const Entry &b) {
+                  return a.lastUsed < b.lastUsed;
+              });
+    for (const Entry &entry : entries) {
+        if (total <= MAX_CACHE_BYTES)
+            break;
+        QDir(entry.path).removeRecursively();
+        total -= entry.size;
+    }
+}
+
+void ImportPreprocessor::start(const QStringList &files)
+{
+    pruneCache();
+
+    m_cancelRequested = false;
+    m_results = files;
+    m_filesDone = 0;
+    emit progress(0, files.size());
+    if (files.isEmpty()) {
+        emit finished(m_results);
+        return;
+    }
+
+    for (int i = 0; i < files.size(); ++i) {
+        const QString path = files[i];
+        const bool video = isVideoSuffix(QFileInfo(path).suffix().toLower());
+
+        auto *watcher = new QFutureWatcher<QString>(this);
+        connect(watcher, &QFutureWatcher<QString>::finished, this,
+                [this, watcher, i]() {
+                    watcher->deleteLater();
+                    if (m_cancelRequested.load())
+                        return;
+                    m_results[i] = watcher->result();
+                    emit progress(++m_filesDone, m_results.size());
+                    if (m_filesDone == m_results.size())
+                        emit finished(m_results);
+                });
+        watcher->setFuture(QtConcurrent::run(
+            video ? &m_videoPool : &m_imagePool, [this, path]() {
+                return processFile(path, m_cancelRequested);
+            }));
+    }
+}
+
+void ImportPreprocessor::cancel() { m_cancelRequested = true; }
+
+QString
+ImportPreprocessor::processFile(const QString &path,
+                                const std::atomic<bool> &cancelRequested)
+{
+    const QFileInfo info(path);
+    const QString suffix = info.suffix().toLower();
+    const bool video = isVideoSuffix(suffix);
+
+    if (cancelRequested.load())
+        return path;
+    if (video ? !VideoTranscoder::needsConversion(path)
+              : !imageNeedsProcessing(path, suffix))
+        return path;
+
+    const QString hash = contentHash(path, cancelRequested);
+    if (hash.isEmpty())
+        return path;
+
+    // Output of an earlier import of the same content. The original suffix
+    // stays in the name, so clip.mkv and clip.mp4 come out as clip.mkv.mp4
+    // and clip.mp4 and are never served under the same name.
+    const QDir dir(cacheDirectory() + "/" + hash);
+    const QString baseName = info.fileName();
+    const QStringList cached = dir.entryList(QDir::Files);
+    for (const QString &fileName : cached) {
+        if (QFileInfo(fileName).completeBaseName() == baseName) {
+            // Marks it as recently used for pruneCache()
+            QFile file(dir.filePath(fileName));
+            if (file.open(QIODevice::Append))
+                file.setFileTime(QDateTime::currentDateTime(),
+                                 QFileDevice::FileModificationTime);
+            return file.fileName();
+        }
+    }
+
+    // Written under a temporary name, so an interrupted conversion is never
+    // mistaken for a finished one
+    dir.mkpath(".");
+    const QString partialBase =
+        dir.filePath("." + QUuid::createUuid().toString(QUuid::Id128));
+    QString outputSuffix;
+    bool converted;
+    if (video) {
+        outputSuffix = "mp4";
+        const int threads =
+            qMax(1, QThread::idealThreadCount() / VIDEO_JOBS);
+        converted = VideoTranscoder::transcodeFileToH264(
+                        path, partialBase + ".mp4", threads, cancelRequested)
+                        .isEmpty();
+    } else {
+        converted = convertImage(path, partialBase, outputSuffix);
+    }
+
+    const QString partial = partialBase + "." + outputSuffix;
+    const QString output = dir.filePath(baseName + "." + outputSuffix);
+    if (!converted || cancelRequested.load() ||
+        !QFile::rename(partial, output)) {
+        QFile::remove(partial);
+        // Another import of the same content may have finished first
+        return QFileInfo::exists(output) ? output : path;
+    }
+    qDebug() << "ImportPreprocessor: Converted" << path << "to" << output;
+    return output;
+}
@@ -0,0 +1,72 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMPORTPREPROCESSOR_H
+#define IMPORTPREPROCESSOR_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <atomic>
+
+/**
+ * @brief Prepares files for a wireless gallery import
+ *
+ * Images larger than a device needs are scaled down and recompressed, BMP,
+ * TIFF and WebP become JPEG (PNG if transparent) and videos that are not
+ * H.264 or HEVC in MP4/MOV are converted to H.264 MP4. Files run in parallel
+ * on a thread pool, videos on a smaller one of their own. Outputs are cached
+ * by content hash, so importing the same files again reuses them, and the
+ * cache is pruned by age and size when an import starts. Files that need
+ * nothing are served as they are.
+ */
+class ImportPreprocessor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ImportPreprocessor(QObject *parent = nullptr);
+    ~ImportPreprocessor();
+
+    // Processes files in the background, finished() reports the result
+    void start(const QStringList &files);
+    // finished() is not emitted after this
+    void cancel();
+
+signals:
+    void progress(int filesDone, int filesTotal);
+    // What to serve in place of each input, in the same order. A file that
+    // could not be converted is served as it is.
+    void finished(const QStringList &files);
+
+private:
+    static QString processFile(const QString &path,
+                               const std::atomic<bool> &cancelRequested);
+    static QString cacheDirectory();
+    static void pruneCache();
+
+    QThreadPool m_imagePool;
+    QThreadPool m_videoPool;
+    std::atomic<bool> m_cancelRequested{false};
+    QStringList m_results;
+    int m_filesDone = 0;
+};
+
+#endif // IMPORTPREPROCESSOR_H
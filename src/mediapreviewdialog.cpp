@@ -19,9 +19,10 @@
 
 #include "mediapreviewdialog.h"
 #include "mediastreamermanager.h"
-#include "photomodel.h"
+#include "servicemanager.h"
 #include <QApplication>
 #include <QAudioOutput>
+#include <QBuffer>
 #include <QCoreApplication>
 #include <QDebug>
 #include <QFileInfo>
@@ -30,6 +31,7 @@
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QHBoxLayout>
+#include <QImageReader>
 #include <QKeyEvent>
 #include <QLabel>
 #include <QMediaPlayer>
@@ -43,16 +45,32 @@
 #include <QWheelEvent>
 #include <QtConcurrent/QtConcurrent>
 #include <QtGlobal>
+#include <memory>
 #include "appcontext.h"
 #include "iDescriptor-ui.h"
 
-
+// Full resolution images are split into tiles of this size so the view only
+// paints the pixmaps that intersect the viewport
+#define IMAGE_TILE_SIZE 1024
 
 MediaPreviewDialog::MediaPreviewDialog(iDescriptorDevice *device,
                                        afc_client_t afcClient,
                                        const QString &filePath, QWidget *parent)
-    : QDialog(parent), m_device(device), m_filePath(filePath),
-      m_isVideo(isVideoFile(filePath)), m_mainLayout(nullptr),
+    : MediaPreviewDialog(device, afcClient, QStringList{filePath}, 0, {},
+                         parent)
+{
+}
+
+MediaPreviewDialog::MediaPreviewDialog(iDescriptorDevice *device,
+                                       afc_client_t afcClient,
+                                       const QStringList &filePaths,
+                                       int currentIndex,
+                                       const ThumbnailProvider &thumbnails,
+                                       QWidget *parent)
+    : QDialog(parent), m_device(device),
+      m_filePath(filePaths.value(currentIndex)),
+      m_isVideo(isVideoFile(filePaths.value(currentIndex))),
+      m_currentIndex(0), m_thumbnails(thumbnails), m_mainLayout(nullptr),
       m_controlsLayout(nullptr), m_imageView(nullptr), m_imageScene(nullptr),
       m_pixmapItem(nullptr), m_videoWidget(nullptr), m_mediaPlayer(nullptr),
       m_videoControlsLayout(nullptr), m_playPauseBtn(nullptr),
@@ -60,10 +78,23 @@ MediaPreviewDialog::MediaPreviewDialog(iDescriptorDevice *device,
       m_timeLabel(nullptr), m_volumeSlider(nullptr), m_volumeLabel(nullptr),
       m_progressTimer(nullptr), m_loadingLabel(nullptr), m_statusLabel(nullptr),
       m_zoomInBtn(nullptr), m_zoomOutBtn(nullptr), m_zoomResetBtn(nullptr),
-      m_fitToWindowBtn(nullptr), m_zoomFactor(1.0), m_isRepeatEnabled(true),
+      m_fitToWindowBtn(nullptr), m_prevBtn(nullptr), m_nextBtn(nullptr),
+      m_zoomFactor(1.0), m_stage(ImageStage::None), m_previewWidth(0),
+      m_fullResRequested(false), m_isRepeatEnabled(true),
       m_isDraggingTimeline(false), m_videoDuration(0), m_afcClient(afcClient)
 {
-    setWindowTitle(QFileInfo(filePath).fileName() + " - iDescriptor");
+    // Navigation only steps through images, a video opens on its own
+    if (m_isVideo) {
+        m_filePaths = {m_filePath};
+    } else {
+        for (const QString &path : filePaths) {
+            if (!isVideoFile(path))
+                m_filePaths.append(path);
+        }
+        m_currentIndex = qMax(0, m_filePaths.indexOf(m_filePath));
+    }
+
+    setWindowTitle(QFileInfo(m_filePath).fileName() + " - iDescriptor");
 
     // Make dialog fullscreen
     setWindowState(Qt::WindowMaximized);
@@ -85,9 +116,9 @@ MediaPreviewDialog::MediaPreviewDialog(iDescriptorDevice *device,
 
 MediaPreviewDialog::~MediaPreviewDialog()
 {
-    // Release the streamer if it was used for video
-    if (m_isVideo) {
-        MediaStreamerManager::sharedInstance()->releaseStreamer(m_filePath);
+    // Release the stream if it was used for video
+    if (!m_streamUrl.isEmpty()) {
+        MediaStreamerManager::sharedInstance()->releaseStream(m_streamUrl);
     }
 }
 
@@ -128,6 +159,7 @@ void MediaPreviewDialog::setupImageView()
     m_imageView = new QGraphicsView(m_imageScene, this);
     m_imageView->setDragMode(QGraphicsView::ScrollHandDrag);
     m_imageView->setRenderHint(QPainter::Antialiasing);
+    m_imageView->setRenderHint(QPainter::SmoothPixmapTransform);
     m_imageView->setVisible(false);
     m_mainLayout->addWidget(m_imageView);
 
@@ -139,12 +171,18 @@ void MediaPreviewDialog::setupImageView()
     m_zoomOutBtn = new QPushButton("Zoom Out", this);
     m_zoomResetBtn = new QPushButton("100%", this);
     m_fitToWindowBtn = new QPushButton("Fit to Window", this);
+    m_prevBtn = new QPushButton("Previous", this);
+    m_prevBtn->setToolTip("Previous (Left)");
+    m_nextBtn = new QPushButton("Next", this);
+    m_nextBtn->setToolTip("Next (Right)");
 
     m_controlsLayout->addWidget(m_zoomInBtn);
     m_controlsLayout->addWidget(m_zoomOutBtn);
     m_controlsLayout->addWidget(m_zoomResetBtn);
     m_controlsLayout->addWidget(m_fitToWindowBtn);
     m_controlsLayout->addStretch();
+    m_controlsLayout->addWidget(m_prevBtn);
+    m_controlsLayout->addWidget(m_nextBtn);
 
     m_mainLayout->addLayout(m_controlsLayout);
 
@@ -157,6 +195,10 @@ void MediaPreviewDialog::setupImageView()
             &MediaPreviewDialog::zoomReset);
     connect(m_fitToWindowBtn, &QPushButton::clicked, this,
             &MediaPreviewDialog::fitToWindow);
+    connect(m_prevBtn, &QPushButton::clicked, this,
+            &MediaPreviewDialog::showPrevious);
+    connect(m_nextBtn, &QPushButton::clicked, this,
+            &MediaPreviewDialog::showNext);
 }
 
 void MediaPreviewDialog::setupVideoView()
@@ -209,67 +251,352 @@ void MediaPreviewDialog::loadMedia()
     loadImage();
 }
 
-void MediaPreviewDialog::loadImage()
+void MediaPreviewDialog::loadImage() { showImageAt(m_currentIndex); }
+
+MediaPreviewDialog::PreviewImage
+MediaPreviewDialog::decodePreview(iDescriptorDevice *device,
+                                  const QString &filePath,
+                                  const QSize &screenSize)
+{
+    PreviewImage preview;
+    preview.data = ServiceManager::safeReadAfcFileToByteArray(
+        device, filePath.toUtf8().constData());
+    if (preview.data.isEmpty()) {
+        qDebug() << "Could not read from device:" << filePath;
+        return preview;
+    }
+
+    if (filePath.endsWith(".heic", Qt::CaseInsensitive)) {
+        preview.image =
+            load_heic(preview.data, screenSize, &preview.fullSize);
+        return preview;
+    }
+
+    QBuffer buffer(&preview.data);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+    reader.setAutoTransform(true);
+
+    // The scaled size is applied before the EXIF rotation, so fit the
+    // stored size into a screen box turned the same way. JPEG scales while
+    // decoding, which is most of the win over a full decode.
+    const QSize storedSize = reader.size();
+    if (storedSize.isValid()) {
+        const bool rotated =
+            reader.transformation() & QImageIOHandler::TransformationRotate90;
+        preview.fullSize = rotated ? storedSize.transposed() : storedSize;
+        const QSize box = rotated ? screenSize.transposed() : screenSize;
+        if (storedSize.width() > box.width() ||
+            storedSize.height() > box.height()) {
+            reader.setScaledSize(
+                storedSize.scaled(box, Qt::KeepAspectRatio));
+        }
+    }
+
+    preview.image = reader.read();
+    if (preview.image.isNull())
+        qDebug() << "Could not decode image data for:" << filePath
+                 << reader.errorString();
+    else if (!preview.fullSize.isValid())
+        preview.fullSize = preview.image.size();
+    return preview;
+}
+
+QList<MediaPreviewDialog::ImageTile>
+MediaPreviewDialog::decodeTiles(QByteArray data, bool isHeic)
 {
-    auto future = QtConcurrent::run(
-        [this]() { return PhotoModel::loadImage(m_device, m_filePath); });
+    QImage image;
+    if (isHeic) {
+        image = load_heic(data);
+    } else {
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::ReadOnly);
+        QImageReader reader(&buffer);
+        reader.setAutoTransform(true);
+        image = reader.read();
+    }
 
-    auto *watcher = new QFutureWatcher<QPixmap>(this);
-    connect(watcher, &QFutureWatcher<QPixmap>::finished, this,
-            [this, watcher]() {
-                QPixmap pixmap = watcher->result();
-                if (!pixmap.isNull()) {
-                    m_originalPixmap = pixmap;
-                    onImageLoaded();
-                } else {
-                    onImageLoadFailed();
+    QList<ImageTile> tiles;
+    if (image.isNull())
+        return tiles;
+    // Tiles address whole pixels and carry no colour table
+    if (image.depth() < 8 || image.format() == QImage::Format_Indexed8)
+        image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    // Tiles are views into the decoded image rather than copies of it, so a
+    // large photo is held once. It is freed along with the last tile.
+    using SharedImage = std::shared_ptr<const QImage>;
+    const SharedImage source = std::make_shared<const QImage>(std::move(image));
+    const qsizetype stride = source->bytesPerLine();
+    const int pixelBytes = source->depth() / 8;
+    for (int y = 0; y < source->height(); y += IMAGE_TILE_SIZE) {
+        for (int x = 0; x < source->width(); x += IMAGE_TILE_SIZE) {
+            const QRect rect =
+                QRect(x, y, IMAGE_TILE_SIZE, IMAGE_TILE_SIZE) & source->rect();
+            const uchar *bits =
+                source->constBits() + rect.y() * stride + rect.x() * pixelBytes;
+            QImage tile(
+                bits, rect.width(), rect.height(), stride, source->format(),
+                [](void *info) { delete static_cast<SharedImage *>(info); },
+                new SharedImage(source));
+            tile.setColorSpace(source->colorSpace());
+            tiles.append({rect.topLeft(), std::move(tile)});
+        }
+    }
+    return tiles;
+}
+
+void MediaPreviewDialog::clearImage()
+{
+    // Deletes the preview and tile items
+    m_imageScene->clear();
+    m_pixmapItem = nullptr;
+    m_tileItems.clear();
+    m_stage = ImageStage::None;
+    m_imageSize = QSize();
+    m_previewWidth = 0;
+    m_imageData.clear();
+    m_fullResRequested = false;
+}
+
+void MediaPreviewDialog::showImageAt(int index)
+{
+    if (index < 0 || index >= m_filePaths.size())
+        return;
+
+    clearImage();
+    m_currentIndex = index;
+    m_filePath = m_filePaths.at(index);
+    setWindowTitle(QFileInfo(m_filePath).fileName() + " - iDescriptor");
+    updateNavigationButtons();
+
+    // A neighbor decoded in the background shows at screen size right away
+    auto it = m_prefetched.constFind(m_filePath);
+    if (it != m_prefetched.constEnd()) {
+        applyPreview(*it);
+        return;
+    }
+
+    m_statusLabel->setText(
+        QString("Loading: %1").arg(QFileInfo(m_filePath).fileName()));
+
+    // The gallery's thumbnail shows at once, while the whole file is still
+    // downloading
+    const QImage cached = m_thumbnails ? m_thumbnails(m_filePath) : QImage();
+    if (!cached.isNull()) {
+        setPreviewImage(cached, QSize());
+        m_stage = ImageStage::Thumbnail;
+        fitToWindow();
+        requestPreview(m_filePath);
+        return;
+    }
+
+    // Otherwise the embedded thumbnail, it is a few range reads away
+    const QString filePath = m_filePath;
+    iDescriptorDevice *device = m_device;
+    auto *thumbWatcher = new QFutureWatcher<QImage>(this);
+    connect(thumbWatcher, &QFutureWatcher<QImage>::finished, this,
+            [this, thumbWatcher, filePath]() {
+                const QImage thumbnail = thumbWatcher->result();
+                thumbWatcher->deleteLater();
+                if (filePath != m_filePath || m_stage != ImageStage::None ||
+                    thumbnail.isNull())
+                    return;
+
+                setPreviewImage(thumbnail, QSize());
+                m_stage = ImageStage::Thumbnail;
+                fitToWindow();
+            });
+    thumbWatcher->setFuture(QtConcurrent::run([device, filePath]() {
+        return load_embedded_thumbnail(device, filePath.toUtf8().constData(),
+                                       0, QSize());
+    }));
+
+    requestPreview(m_filePath);
+}
+
+void MediaPreviewDialog::requestPreview(const QString &filePath)
+{
+    if (m_prefetched.contains(filePath) || m_prefetching.contains(filePath))
+        return;
+    m_prefetching.insert(filePath);
+
+    const QScreen *screen = QApplication::primaryScreen();
+    const QSize screenSize = screen->size() * screen->devicePixelRatio();
+    iDescriptorDevice *device = m_device;
+
+    auto *watcher = new QFutureWatcher<PreviewImage>(this);
+    connect(watcher, &QFutureWatcher<PreviewImage>::finished, this,
+            [this, watcher, filePath]() {
+                const PreviewImage preview = watcher->result();
+                watcher->deleteLater();
+                m_prefetching.remove(filePath);
+
+                if (filePath == m_filePath) {
+                    if (preview.image.isNull()) {
+                        onImageLoadFailed();
+                        return;
+                    }
+                    m_prefetched.insert(filePath, preview);
+                    if (m_stage < ImageStage::Screen)
+                        applyPreview(preview);
+                    return;
                 }
+
+                // Only keep it if it is still next to the current image
+                const int index = m_filePaths.indexOf(filePath);
+                if (!preview.image.isNull() &&
+                    qAbs(index - m_currentIndex) == 1) {
+                    m_prefetched.insert(filePath, preview);
+                }
+            });
+    watcher->setFuture(QtConcurrent::run([device, filePath, screenSize]() {
+        return decodePreview(device, filePath, screenSize);
+    }));
+}
+
+void MediaPreviewDialog::applyPreview(const PreviewImage &preview)
+{
+    m_imageData = preview.data;
+    setPreviewImage(preview.image, preview.fullSize);
+    m_stage = ImageStage::Screen;
+    fitToWindow();
+    prefetchNeighbors();
+}
+
+void MediaPreviewDialog::setPreviewImage(const QImage &image,
+                                         const QSize &fullSize)
+{
+    m_loadingLabel->hide();
+    m_imageView->setVisible(true);
+
+    m_imageSize = fullSize.isValid() ? fullSize : image.size();
+    m_previewWidth = image.width();
+
+    const QPixmap pixmap = QPixmap::fromImage(image);
+    if (!m_pixmapItem) {
+        m_pixmapItem = m_imageScene->addPixmap(pixmap);
+        m_pixmapItem->setTransformationMode(Qt::SmoothTransformation);
+    } else {
+        m_pixmapItem->setPixmap(pixmap);
+    }
+    // Stretched over the full resolution rect so zoom and scroll positions
+    // carry over when a sharper stage replaces it
+    m_pixmapItem->setScale(static_cast<double>(m_imageSize.width()) /
+                           image.width());
+    m_imageScene->setSceneRect(QRectF(QPointF(0, 0), m_imageSize));
+}
+
+void MediaPreviewDialog::prefetchNeighbors()
+{
+    const QString previous = m_filePaths.value(m_currentIndex - 1);
+    const QString next = m_filePaths.value(m_currentIndex + 1);
+
+    for (auto it = m_prefetched.begin(); it != m_prefetched.end();) {
+        if (it.key() == m_filePath || it.key() == previous ||
+            it.key() == next) {
+            ++it;
+        } else {
+            it = m_prefetched.erase(it);
+        }
+    }
+
+    if (!next.isEmpty())
+        requestPreview(next);
+    if (!previous.isEmpty())
+        requestPreview(previous);
+}
+
+// Decodes the full resolution image the first time the screen sized one
+// would be magnified, and only draws its tiles while it is
+void MediaPreviewDialog::updateResolution()
+{
+    if (m_isVideo || m_previewWidth <= 0)
+        return;
+
+    const bool magnified = m_zoomFactor * m_imageSize.width() > m_previewWidth;
+    for (QGraphicsPixmapItem *tile : m_tileItems)
+        tile->setVisible(magnified);
+
+    if (!magnified || m_stage != ImageStage::Screen || m_fullResRequested ||
+        m_imageData.isEmpty())
+        return;
+
+    m_fullResRequested = true;
+    const QString filePath = m_filePath;
+    const QByteArray data = m_imageData;
+    const bool isHeic = filePath.endsWith(".heic", Qt::CaseInsensitive);
+
+    auto *watcher = new QFutureWatcher<QList<ImageTile>>(this);
+    connect(watcher, &QFutureWatcher<QList<ImageTile>>::finished, this,
+            [this, watcher, filePath]() {
+                const QList<ImageTile> tiles = watcher->result();
                 watcher->deleteLater();
+                if (filePath != m_filePath ||
+                    m_stage != ImageStage::Screen || tiles.isEmpty())
+                    return;
+
+                const bool magnified =
+                    m_zoomFactor * m_imageSize.width() > m_previewWidth;
+                for (const ImageTile &tile : tiles) {
+                    QGraphicsPixmapItem *item =
+                        m_imageScene->addPixmap(QPixmap::fromImage(tile.image));
+                    item->setPos(tile.pos);
+                    item->setZValue(1);
+                    item->setVisible(magnified);
+                    m_tileItems.append(item);
+                }
+                m_stage = ImageStage::Full;
+                // The prefetch entry still holds the bytes if we come back
+                m_imageData.clear();
+                updateZoomStatus();
             });
-    watcher->setFuture(future);
+    watcher->setFuture(QtConcurrent::run(
+        [data, isHeic]() { return decodeTiles(data, isHeic); }));
+    updateZoomStatus();
+}
+
+void MediaPreviewDialog::updateNavigationButtons()
+{
+    if (!m_prevBtn)
+        return;
+    const bool navigable = m_filePaths.size() > 1;
+    m_prevBtn->setVisible(navigable);
+    m_nextBtn->setVisible(navigable);
+    m_prevBtn->setEnabled(m_currentIndex > 0);
+    m_nextBtn->setEnabled(m_currentIndex < m_filePaths.size() - 1);
 }
 
+void MediaPreviewDialog::showPrevious() { showImageAt(m_currentIndex - 1); }
+
+void MediaPreviewDialog::showNext() { showImageAt(m_currentIndex + 1); }
+
 void MediaPreviewDialog::loadVideo()
 {
     m_videoWidget->setVisible(true);
 
     // Get streamer URL from the singleton manager
-    QUrl streamUrl = MediaStreamerManager::sharedInstance()->getStreamUrl(
+    m_streamUrl = MediaStreamerManager::sharedInstance()->getStreamUrl(
         m_device, m_afcClient, m_filePath);
-    qDebug() << "Streaming video from URL:" << streamUrl;
-    if (streamUrl.isEmpty()) {
+    qDebug() << "Streaming video from URL:" << m_streamUrl;
+    if (m_streamUrl.isEmpty()) {
         m_statusLabel->setText("Failed to start video stream");
         return;
     }
 
-    m_mediaPlayer->setSource(streamUrl);
+    m_mediaPlayer->setSource(m_streamUrl);
     m_mediaPlayer->play();
     m_loadingLabel->hide();
     m_statusLabel->setText(
         QString("Playing: %1").arg(QFileInfo(m_filePath).fileName()));
 }
 
-void MediaPreviewDialog::onImageLoaded()
-{
-    m_loadingLabel->hide();
-    m_imageView->setVisible(true);
-
-    // Add pixmap to scene
-    m_pixmapItem = m_imageScene->addPixmap(m_originalPixmap);
-    m_imageScene->setSceneRect(m_originalPixmap.rect());
-
-    // Fit to window initially
-    fitToWindow();
-
-    // Update status
-    m_statusLabel->setText(QString("Image: %1 (%2x%3)")
-                               .arg(QFileInfo(m_filePath).fileName())
-                               .arg(m_originalPixmap.width())
-                               .arg(m_originalPixmap.height()));
-}
-
 void MediaPreviewDialog::onImageLoadFailed()
 {
+    if (m_stage == ImageStage::None) {
+        m_imageView->setVisible(false);
+        m_loadingLabel->show();
+    }
     m_loadingLabel->setText("Failed to load image");
     m_statusLabel->setText("Error loading image");
 }
@@ -314,6 +641,14 @@ void MediaPreviewDialog::keyPressEvent(QKeyEvent *event)
             fitToWindow();
             event->accept();
             return;
+        case Qt::Key_Left:
+            showPrevious();
+            event->accept();
+            return;
+        case Qt::Key_Right:
+            showNext();
+            event->accept();
+            return;
         }
     }
 
@@ -368,9 +703,9 @@ void MediaPreviewDialog::resizeEvent(QResizeEvent *event)
 
     // Auto-fit when window is resized if we're close to fit-to-window size
     if (!m_isVideo && m_imageView && m_imageView->isVisible() &&
-        !m_originalPixmap.isNull()) {
+        m_imageSize.isValid()) {
         const QSize viewSize = m_imageView->viewport()->size();
-        const QSize pixmapSize = m_originalPixmap.size();
+        const QSize pixmapSize = m_imageSize;
         const double fitScale =
             qMin(static_cast<double>(viewSize.width()) / pixmapSize.width(),
                  static_cast<double>(viewSize.height()) / pixmapSize.height());
@@ -388,20 +723,21 @@ void MediaPreviewDialog::zoomOut() { zoom(1.0 / 1.25); }
 
 void MediaPreviewDialog::zoomReset()
 {
-    if (m_imageView && m_originalPixmap.isNull() == false) {
+    if (m_imageView && m_imageSize.isValid()) {
         m_imageView->resetTransform();
         m_zoomFactor = 1.0;
+        updateResolution();
         updateZoomStatus();
     }
 }
 
 void MediaPreviewDialog::fitToWindow()
 {
-    if (!m_imageView || m_originalPixmap.isNull())
+    if (!m_imageView || !m_imageSize.isValid())
         return;
 
     const QSize viewSize = m_imageView->viewport()->size();
-    const QSize pixmapSize = m_originalPixmap.size();
+    const QSize pixmapSize = m_imageSize;
 
     const double scaleX =
         static_cast<double>(viewSize.width()) / pixmapSize.width();
@@ -412,6 +748,7 @@ void MediaPreviewDialog::fitToWindow()
     m_imageView->resetTransform();
     m_imageView->scale(scale, scale);
     m_zoomFactor = scale;
+    updateResolution();
     updateZoomStatus();
 }
 
@@ -422,6 +759,7 @@ void MediaPreviewDialog::zoom(double factor)
 
     m_imageView->scale(factor, factor);
     m_zoomFactor *= factor;
+    updateResolution();
     updateZoomStatus();
 }
 
@@ -438,12 +776,19 @@ void MediaPreviewDialog::zoom(double factor)
 
 void MediaPreviewDialog::updateZoomStatus()
 {
-    if (!m_isVideo && !m_originalPixmap.isNull()) {
-        m_statusLabel->setText(QString("Image: %1 (%2x%3) - Zoom: %4%")
-                                   .arg(QFileInfo(m_filePath).fileName())
-                                   .arg(m_originalPixmap.width())
-                                   .arg(m_originalPixmap.height())
-                                   .arg(qRound(m_zoomFactor * 100)));
+    if (!m_isVideo && m_imageSize.isValid()) {
+        QString status = QString("Image: %1 (%2x%3) - Zoom: %4%")
+                             .arg(QFileInfo(m_filePath).fileName())
+                             .arg(m_imageSize.width())
+                             .arg(m_imageSize.height())
+                             .arg(qRound(m_zoomFactor * 100));
+        if (m_fullResRequested && m_stage != ImageStage::Full)
+            status += " - Loading full resolution...";
+        if (m_filePaths.size() > 1)
+            status += QString(" - %1 of %2")
+                          .arg(m_currentIndex + 1)
+                          .arg(m_filePaths.size());
+        m_statusLabel->setText(status);
     }
 }
 
@@ -28,14 +28,19 @@
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QHBoxLayout>
+#include <QHash>
+#include <QImage>
 #include <QLabel>
 #include <QMediaPlayer>
 #include <QPushButton>
+#include <QSet>
 #include <QSlider>
 #include <QTimer>
+#include <QUrl>
 #include <QVBoxLayout>
 #include <QVideoWidget>
 #include <QtGlobal>
+#include <functional>
 #include <libimobiledevice/afc.h>
 
 /**
@@ -43,6 +48,9 @@
  *
  * Features:
  * - Image viewing with zoom and pan using QGraphicsView
+ * - Progressive image loading: embedded thumbnail, then a screen sized
+ *   decode, then full resolution in tiles once zoomed past it
+ * - Previous/next navigation with neighbors decoded in the background
  * - Video streaming with timeline scrubbing support
  * - Asynchronous loading from device
  * - Proper memory management
@@ -52,9 +60,22 @@ class MediaPreviewDialog : public QDialog
     Q_OBJECT
 
 public:
+    // Returns an already cached thumbnail of a file, or a null image
+    using ThumbnailProvider = std::function<QImage(const QString &)>;
+
     explicit MediaPreviewDialog(iDescriptorDevice *device,
                                 afc_client_t afcClient, const QString &filePath,
                                 QWidget *parent = nullptr);
+    /**
+     * @brief Preview filePaths[currentIndex] and allow stepping through the
+     * other images of the list. Videos are skipped while navigating.
+     * Thumbnails from the provider are shown while an image loads.
+     */
+    explicit MediaPreviewDialog(iDescriptorDevice *device,
+                                afc_client_t afcClient,
+                                const QStringList &filePaths, int currentIndex,
+                                const ThumbnailProvider &thumbnails = {},
+                                QWidget *parent = nullptr);
     ~MediaPreviewDialog();
 
 protected:
@@ -64,12 +85,13 @@ protected:
     bool event(QEvent *event) override; // handle ShortcutOverride
 
 private slots:
-    void onImageLoaded();
     void onImageLoadFailed();
     void zoomIn();
     void zoomOut();
     void zoomReset();
     void fitToWindow();
+    void showPrevious();
+    void showNext();
 
     // Video control slots
     void onPlayPauseClicked();
@@ -85,6 +107,24 @@ private slots:
     void onMediaPlayerPositionChanged(qint64 position);
 
 private:
+    enum class ImageStage { None, Thumbnail, Screen, Full };
+
+    struct PreviewImage {
+        QByteArray data; // encoded file, kept for the full resolution pass
+        QImage image;    // decoded to fit the screen
+        QSize fullSize;
+    };
+
+    struct ImageTile {
+        QPoint pos;
+        QImage image;
+    };
+
+    static PreviewImage decodePreview(iDescriptorDevice *device,
+                                      const QString &filePath,
+                                      const QSize &screenSize);
+    static QList<ImageTile> decodeTiles(QByteArray data, bool isHeic);
+
     void setupUI();
     void setupImageView();
     void setupVideoView();
@@ -92,6 +132,14 @@ private:
     void loadMedia();
     void loadImage();
     void loadVideo();
+    void showImageAt(int index);
+    void clearImage();
+    void setPreviewImage(const QImage &image, const QSize &fullSize);
+    void applyPreview(const PreviewImage &preview);
+    void requestPreview(const QString &filePath);
+    void prefetchNeighbors();
+    void updateResolution();
+    void updateNavigationButtons();
     void zoom(double factor);
     void updateZoomStatus();
     void updateVideoTimeDisplay();
@@ -102,6 +150,11 @@ private:
     iDescriptorDevice *m_device;
     QString m_filePath;
     bool m_isVideo;
+    // Released when the dialog goes away
+    QUrl m_streamUrl;
+    QStringList m_filePaths;
+    int m_currentIndex;
+    ThumbnailProvider m_thumbnails;
 
     // UI components
     QVBoxLayout *m_mainLayout;
@@ -110,7 +163,8 @@ private:
     // Image viewing components
     QGraphicsView *m_imageView;
     QGraphicsScene *m_imageScene;
-    QGraphicsPixmapItem *m_pixmapItem;
+    QGraphicsPixmapItem *m_pixmapItem; // best decode so far, scaled up
+    QList<QGraphicsPixmapItem *> m_tileItems; // full resolution
 
     // Video viewing components
     QVideoWidget *m_videoWidget;
@@ -136,10 +190,21 @@ private:
     QPushButton *m_zoomOutBtn;
     QPushButton *m_zoomResetBtn;
     QPushButton *m_fitToWindowBtn;
+    QPushButton *m_prevBtn;
+    QPushButton *m_nextBtn;
 
     // State
     double m_zoomFactor;
-    QPixmap m_originalPixmap;
+
+    // Progressive image state. Scene coordinates are full resolution pixels
+    // whatever stage is currently drawn.
+    ImageStage m_stage;
+    QSize m_imageSize;
+    int m_previewWidth; // pixel width of m_pixmapItem's pixmap
+    QByteArray m_imageData;
+    bool m_fullResRequested;
+    QHash<QString, PreviewImage> m_prefetched; // current image and neighbors
+    QSet<QString> m_prefetching;
 
     // Video state
     bool m_isRepeatEnabled;
@@ -21,55 +21,225 @@
 #include <QtGlobal>
 
 #include "iDescriptor.h"
+#include "mediastreamermanager.h"
 #include "servicemanager.h"
 #include <QDebug>
 #include <QFileInfo>
 #include <QHostAddress>
-#include <QMutexLocker>
+#include <QMutex>
+#include <QQueue>
 #include <QTcpSocket>
 #include <QTimer>
+#include <QtConcurrent/QtConcurrent>
+#include <functional>
 #include <libimobiledevice/afc.h>
 #include <memory>
 
-MediaStreamer::MediaStreamer(iDescriptorDevice *device, afc_client_t afcClient,
-                             const QString &filePath, QObject *parent)
-    : QTcpServer(parent), m_device(device), m_afcClient(afcClient),
-      m_filePath(filePath), m_cachedFileSize(-1), m_fileSizeCached(false)
+static const QString STREAM_PATH_PREFIX = "/device/";
+
+// Requests with a larger header are refused
+static constexpr int MAX_HEADER_SIZE = 16 * 1024;
+// GET and HEAD carry no body, anything bigger is not a request for us
+static constexpr qint64 MAX_BODY_SIZE = 64 * 1024;
+// Idle keep-alive connections are closed after this long
+static constexpr int KEEP_ALIVE_TIMEOUT_MS = 30000;
+static constexpr int CHUNK_SIZE = 64 * 1024;
+// More is written once the socket has less than this left to send
+static constexpr qint64 SOCKET_BUFFER_LOW = 256 * 1024;
+// How far a response is read ahead of the socket
+static constexpr qint64 READ_AHEAD_SIZE = 2 * 1024 * 1024;
+// Concurrent device reads, across all responses
+static constexpr int READ_THREADS = 4;
+
+/*
+ * Reads a byte range of a file on the read pool, at most READ_AHEAD_SIZE
+ * bytes ahead of what the I/O thread has taken. dataReady is called from the
+ * pool when data arrives in an empty buffer and when reading stops, never
+ * after cancel() has returned.
+ */
+class RangeReader : public std::enable_shared_from_this<RangeReader>
+{
+public:
+    RangeReader(QThreadPool *pool, StreamSource source, qint64 start,
+                qint64 length, std::function<void()> dataReady)
+        : m_pool(pool), m_source(std::move(source)), m_position(start),
+          m_remaining(length), m_dataReady(std::move(dataReady))
+    {
+    }
+
+    void start()
+    {
+        QMutexLocker locker(&m_mutex);
+        scheduleFill();
+    }
+
+    // Stops reading, the buffer is dropped
+    void cancel()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_cancelled = true;
+        m_chunks.clear();
+        m_buffered = 0;
+    }
+
+    // Buffered data up to maxBytes, empty if nothing is buffered yet
+    QByteArray take(qint64 maxBytes)
+    {
+        QMutexLocker locker(&m_mutex);
+        QByteArray data;
+        while (!m_chunks.isEmpty() &&
+               data.size() + m_chunks.head().size() <= maxBytes) {
+            data += m_chunks.dequeue();
+        }
+        if (data.isEmpty() && !m_chunks.isEmpty())
+            data = m_chunks.dequeue();
+        m_buffered -= data.size();
+        scheduleFill();
+        return data;
+    }
+
+    // The device read failed, nothing more will arrive
+    bool failed() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_failed;
+    }
+
+private:
+    // Called with m_mutex held
+    void scheduleFill()
+    {
+        if (m_filling || m_cancelled || m_failed || m_remaining == 0 ||
+            m_buffered >= READ_AHEAD_SIZE)
+            return;
+        m_filling = true;
+        QtConcurrent::run(m_pool,
+                          [self = shared_from_this()]() { self->fill(); });
+    }
+
+    void fill()
+    {
+        auto buffer = std::make_unique<char[]>(CHUNK_SIZE);
+        for (;;) {
+            qint64 position;
+            qint64 toRead;
+            {
+                QMutexLocker locker(&m_mutex);
+                if (m_cancelled || m_remaining == 0 ||
+                    m_buffered >= READ_AHEAD_SIZE) {
+                    m_filling = false;
+                    return;
+                }
+                position = m_position;
+                toRead = qMin<qint64>(CHUNK_SIZE, m_remaining);
+            }
+
+            const qint64 bytesRead = m_source.read(
+                position, buffer.get(), static_cast<uint64_t>(toRead));
+
+            QMutexLocker locker(&m_mutex);
+            if (m_cancelled) {
+                m_filling = false;
+                return;
+            }
+            if (bytesRead <= 0) {
+                m_failed = true;
+                m_filling = false;
+                m_dataReady();
+                return;
+            }
+            m_chunks.enqueue(QByteArray(buffer.get(), bytesRead));
+            m_buffered += bytesRead;
+            m_position += bytesRead;
+            m_remaining -= bytesRead;
+            // The I/O thread drains everything it can, it only needs waking
+            // when it found the buffer empty
+            if (m_chunks.size() == 1)
+                m_dataReady();
+        }
+    }
+
+    QThreadPool *m_pool;
+    StreamSource m_source;
+    mutable QMutex m_mutex;
+    QQueue<QByteArray> m_chunks;
+    qint64 m_buffered = 0;
+    qint64 m_position;
+    qint64 m_remaining;
+    bool m_filling = false;
+    bool m_cancelled = false;
+    bool m_failed = false;
+    std::function<void()> m_dataReady;
+};
+
+MediaStreamer::MediaStreamer(QObject *parent) : QTcpServer(parent)
+{
+    m_readPool.setMaxThreadCount(READ_THREADS);
+}
+
+bool MediaStreamer::start()
 {
     // Listen on localhost with automatic port assignment
     if (!listen(QHostAddress::LocalHost, 0)) {
         qWarning() << "MediaStreamer failed to start:" << errorString();
-    } else {
-        qDebug() << "MediaStreamer listening on" << getUrl().toString();
+        return false;
     }
+    m_port = serverPort();
+    qDebug() << "MediaStreamer listening on port" << m_port;
+    return true;
 }
 
 MediaStreamer::~MediaStreamer()
 {
     // Close all active connections
-    QMutexLocker locker(&m_connectionsMutex);
-    for (QTcpSocket *socket : m_activeConnections) {
-        socket->disconnectFromHost();
+    const QList<Connection *> connections = m_connections.values();
+    for (Connection *connection : connections) {
+        QTcpSocket *socket = connection->socket;
+        closeConnection(connection);
         if (socket->state() != QAbstractSocket::UnconnectedState) {
             socket->waitForDisconnected(1000);
         }
-        socket->deleteLater();
     }
-    m_activeConnections.clear();
+    // Reads still running hold only their own reader
+    m_readPool.waitForDone();
 }
 
-QUrl MediaStreamer::getUrl() const
+QUrl MediaStreamer::urlForFile(const QString &udid,
+                               const QString &filePath) const
 {
     if (!isListening()) {
         return QUrl();
     }
-    // todo pass folder/filename
-    return QUrl(QString("http://127.0.0.1:%1/%2")
-                    .arg(serverPort())
-                    .arg(QFileInfo(m_filePath).fileName()));
+
+    QUrl url;
+    url.setScheme("http");
+    url.setHost("127.0.0.1");
+    url.setPort(m_port);
+    // Ends in the file name, so the player can tell the format from it
+    url.setPath(STREAM_PATH_PREFIX + udid +
+                (filePath.startsWith('/') ? filePath : "/" + filePath));
+    return url;
 }
 
-bool MediaStreamer::isListening() const { return QTcpServer::isListening(); }
+bool MediaStreamer::parseStreamPath(const QString &requestPath, QString &udid,
+                                    QString &filePath)
+{
+    QString path = requestPath.section('?', 0, 0);
+    path = QUrl::fromPercentEncoding(path.toUtf8());
+    if (!path.startsWith(STREAM_PATH_PREFIX))
+        return false;
+
+    const int slash = path.indexOf('/', STREAM_PATH_PREFIX.size());
+    if (slash <= STREAM_PATH_PREFIX.size() || slash == path.size() - 1)
+        return false;
+
+    udid = path.mid(STREAM_PATH_PREFIX.size(),
+                    slash - STREAM_PATH_PREFIX.size());
+    filePath = path.mid(slash);
+    return true;
+}
+
+bool MediaStreamer::isListening() const { return m_port != 0; }
 
 void MediaStreamer::incomingConnection(qintptr socketDescriptor)
 {
@@ -80,73 +250,129 @@ void MediaStreamer::incomingConnection(qintptr socketDescriptor)
         return;
     }
 
-    // Add to active connections
-    {
-        QMutexLocker locker(&m_connectionsMutex);
-        m_activeConnections.append(socket);
-    }
+    auto *connection = new Connection();
+    connection->socket = socket;
+    connection->idleTimer = new QTimer(socket);
+    connection->idleTimer->setSingleShot(true);
+    connection->idleTimer->setInterval(KEEP_ALIVE_TIMEOUT_MS);
+    m_connections.insert(socket, connection);
+
+    // Lives as long as the socket, so handlers running when the connection
+    // is closed can still look at it
+    connect(socket, &QObject::destroyed, [connection]() { delete connection; });
+
+    connect(socket, &QTcpSocket::readyRead, this, [this, connection]() {
+        connection->pending += connection->socket->readAll();
+        processRequests(connection);
+    });
 
-    connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
-        QByteArray requestData = socket->readAll();
-        HttpRequest request = parseHttpRequest(requestData);
-        handleRequest(socket, request);
+    connect(socket, &QTcpSocket::bytesWritten, this, [this, connection]() {
+        // Continue streaming when socket buffer has space
+        if (connection->streaming &&
+            connection->socket->bytesToWrite() < SOCKET_BUFFER_LOW) {
+            streamNextChunk(connection);
+        }
     });
 
     connect(socket, &QTcpSocket::disconnected, this,
-            &MediaStreamer::handleClientDisconnected);
+            [this, connection]() { closeConnection(connection); });
+    connect(connection->idleTimer, &QTimer::timeout, this,
+            [this, connection]() { closeConnection(connection); });
     connect(socket,
             QOverload<QAbstractSocket::SocketError>::of(
                 &QAbstractSocket::errorOccurred),
-            this, [this, socket](QAbstractSocket::SocketError error) {
-                qWarning() << "Socket error:" << error << socket->errorString();
-                socket->deleteLater();
+            this, [this, connection](QAbstractSocket::SocketError error) {
+                // The player hanging up is how keep-alive connections end
+                if (error != QAbstractSocket::RemoteHostClosedError)
+                    qWarning() << "Socket error:" << error
+                               << connection->socket->errorString();
+                closeConnection(connection);
             });
 
+    connection->idleTimer->start();
     qDebug() << "MediaStreamer: Client connected from"
              << socket->peerAddress().toString();
 }
 
-void MediaStreamer::handleClientDisconnected()
+void MediaStreamer::closeConnection(Connection *connection)
 {
-    auto *socket = qobject_cast<QTcpSocket *>(sender());
-    if (!socket)
+    if (connection->closed)
         return;
-
-    {
-        QMutexLocker locker(&m_connectionsMutex);
-        m_activeConnections.removeAll(socket);
+    connection->closed = true;
+    connection->streaming = false;
+    if (connection->reader) {
+        connection->reader->cancel();
+        connection->reader.reset();
     }
+    m_connections.remove(connection->socket);
+
+    disconnect(connection->socket, nullptr, this, nullptr);
+    disconnect(connection->idleTimer, nullptr, this, nullptr);
+    connection->idleTimer->stop();
 
+    // Sends what is still buffered first
+    connection->socket->disconnectFromHost();
+    connection->socket->deleteLater();
     qDebug() << "MediaStreamer: Client disconnected";
-    socket->deleteLater();
 }
 
-MediaStreamer::HttpRequest
-MediaStreamer::parseHttpRequest(const QByteArray &requestData)
+// Answers complete requests in the buffer, one at a time
+void MediaStreamer::processRequests(Connection *connection)
 {
-    HttpRequest request;
+    while (!connection->closed && !connection->streaming) {
+        const qsizetype headerEnd = connection->pending.indexOf("\r\n\r\n");
+        if (headerEnd < 0) {
+            if (connection->pending.size() > MAX_HEADER_SIZE) {
+                connection->keepAlive = false;
+                sendErrorResponse(connection, 431,
+                                  "Request Header Fields Too Large");
+            }
+            return;
+        }
 
-    const QString requestStr = QString::fromUtf8(requestData);
-    const QStringList lines = requestStr.split("\r\n");
+        HttpRequest request;
+        const bool valid =
+            parseHttpRequest(connection->pending.left(headerEnd), request);
+        bool lengthOk = true;
+        const qint64 bodyLength =
+            request.headers.value("content-length", "0").toLongLong(&lengthOk);
+        if (!valid || !lengthOk || bodyLength < 0 ||
+            bodyLength > MAX_BODY_SIZE) {
+            connection->keepAlive = false;
+            sendErrorResponse(connection, 400, "Bad Request");
+            return;
+        }
+
+        // Wait for the body, then drop it along with the request
+        const qsizetype requestSize = headerEnd + 4 + bodyLength;
+        if (connection->pending.size() < requestSize)
+            return;
+        connection->pending.remove(0, requestSize);
 
-    if (lines.isEmpty()) {
-        return request;
+        connection->idleTimer->stop();
+        connection->keepAlive = request.keepAlive;
+        handleRequest(connection, request);
     }
+}
+
+bool MediaStreamer::parseHttpRequest(const QByteArray &header,
+                                     HttpRequest &request)
+{
+    const QString requestStr = QString::fromUtf8(header);
+    const QStringList lines = requestStr.split("\r\n");
 
     // Parse request line: "GET /path HTTP/1.1"
     const QStringList requestLine = lines[0].split(" ");
-    if (requestLine.size() >= 3) {
-        request.method = requestLine[0];
-        request.path = requestLine[1];
-        request.httpVersion = requestLine[2];
+    if (requestLine.size() != 3 || !requestLine[2].startsWith("HTTP/1.")) {
+        return false;
     }
+    request.method = requestLine[0];
+    request.path = requestLine[1];
+    request.httpVersion = requestLine[2];
 
     // Parse headers
     for (int i = 1; i < lines.size(); ++i) {
         const QString &line = lines[i];
-        if (line.isEmpty())
-            break; // End of headers
-
         const int colonPos = line.indexOf(':');
         if (colonPos > 0) {
             const QString key = line.left(colonPos).trimmed();
@@ -155,6 +381,13 @@ MediaStreamer::parseHttpRequest(const QByteArray &requestData)
         }
     }
 
+    // HTTP/1.1 keeps the connection unless told otherwise, 1.0 the reverse
+    const QString connectionHeader =
+        request.headers.value("connection").toLower();
+    request.keepAlive = request.httpVersion == "HTTP/1.1"
+                            ? !connectionHeader.contains("close")
+                            : connectionHeader.contains("keep-alive");
+
     // Parse Range header if present
     if (request.headers.contains("range")) {
         const QString rangeHeader = request.headers["range"];
@@ -165,9 +398,13 @@ MediaStreamer::parseHttpRequest(const QByteArray &requestData)
             if (rangeParts.size() == 2) {
                 request.hasRange = true;
                 bool ok;
-                request.rangeStart = rangeParts[0].toLongLong(&ok);
-                if (!ok)
-                    request.rangeStart = 0;
+                if (rangeParts[0].isEmpty()) {
+                    request.rangeStart = -1;
+                } else {
+                    request.rangeStart = rangeParts[0].toLongLong(&ok);
+                    if (!ok)
+                        request.rangeStart = 0;
+                }
 
                 if (!rangeParts[1].isEmpty()) {
                     request.rangeEnd = rangeParts[1].toLongLong(&ok);
@@ -178,20 +415,38 @@ MediaStreamer::parseHttpRequest(const QByteArray &requestData)
         }
     }
 
-    return request;
+    return true;
 }
 
-void MediaStreamer::handleRequest(QTcpSocket *socket,
+QByteArray MediaStreamer::connectionHeaders(const Connection *connection) const
+{
+    if (!connection->keepAlive)
+        return "Connection: close\r\n";
+    return QString("Connection: keep-alive\r\n"
+                   "Keep-Alive: timeout=%1\r\n")
+        .arg(KEEP_ALIVE_TIMEOUT_MS / 1000)
+        .toUtf8();
+}
+
+void MediaStreamer::handleRequest(Connection *connection,
                                   const HttpRequest &request)
 {
     if (request.method != "GET" && request.method != "HEAD") {
-        sendErrorResponse(socket, 405, "Method Not Allowed");
+        sendErrorResponse(connection, 405, "Method Not Allowed");
         return;
     }
 
-    const qint64 fileSize = getFileSize();
+    // Only files someone asked a URL for are served
+    QString udid;
+    QString filePath;
+    StreamSource source;
+    if (parseStreamPath(request.path, udid, filePath))
+        source = MediaStreamerManager::sharedInstance()->openStream(udid,
+                                                                    filePath);
+
+    const qint64 fileSize = source ? static_cast<qint64>(source.size()) : -1;
     if (fileSize <= 0) {
-        sendErrorResponse(socket, 404, "File Not Found");
+        sendErrorResponse(connection, 404, "File Not Found");
         return;
     }
 
@@ -199,20 +454,27 @@ void MediaStreamer::handleRequest(QTcpSocket *socket,
     qint64 rangeEnd = fileSize - 1;
 
     if (request.hasRange) {
-        rangeStart = request.rangeStart;
-        if (request.rangeEnd >= 0 && request.rangeEnd < fileSize) {
-            rangeEnd = request.rangeEnd;
+        if (request.rangeStart < 0) {
+            // Suffix range, the last rangeEnd bytes
+            rangeStart = request.rangeEnd > 0
+                             ? qMax<qint64>(0, fileSize - request.rangeEnd)
+                             : fileSize;
+        } else {
+            rangeStart = request.rangeStart;
+            if (request.rangeEnd >= 0 && request.rangeEnd < fileSize) {
+                rangeEnd = request.rangeEnd;
+            }
         }
 
         // Validate range
         if (rangeStart < 0 || rangeStart >= fileSize || rangeStart > rangeEnd) {
-            sendErrorResponse(socket, 416, "Range Not Satisfiable");
+            sendErrorResponse(connection, 416, "Range Not Satisfiable");
             return;
         }
     }
 
     const qint64 contentLength = rangeEnd - rangeStart + 1;
-    const QString mimeType = getMimeType();
+    const QString mimeType = getMimeType(filePath);
 
     // Send response headers
     QByteArray response;
@@ -230,161 +492,83 @@ void MediaStreamer::handleRequest(QTcpSocket *socket,
     response += "Accept-Ranges: bytes\r\n";
     response += QString("Content-Length: %1\r\n").arg(contentLength).toUtf8();
     response += QString("Content-Type: %1\r\n").arg(mimeType).toUtf8();
-    response += "Connection: close\r\n";
+    response += connectionHeaders(connection);
     response += "Cache-Control: no-cache\r\n";
     response += "\r\n";
 
-    socket->write(response);
-    // Remove blocking call - let Qt handle when bytes are actually written
+    connection->socket->write(response);
 
     // For HEAD requests, don't send body
     if (request.method == "HEAD") {
-        socket->disconnectFromHost();
+        finishResponse(connection);
         return;
     }
 
     // Stream file content
-    streamFileRange(socket, rangeStart, rangeEnd);
+    streamFileRange(connection, std::move(source), filePath, rangeStart,
+                    rangeEnd);
 }
 
-void MediaStreamer::sendErrorResponse(QTcpSocket *socket, int statusCode,
+void MediaStreamer::sendErrorResponse(Connection *connection, int statusCode,
                                       const QString &statusText)
 {
     const QByteArray response = QString("HTTP/1.1 %1 %2\r\n"
-                                        "Content-Length: 0\r\n"
-                                        "Connection: close\r\n"
-                                        "\r\n")
+                                        "Content-Length: 0\r\n")
                                     .arg(statusCode)
                                     .arg(statusText)
-                                    .toUtf8();
+                                    .toUtf8() +
+                                connectionHeaders(connection) + "\r\n";
 
-    socket->write(response);
-    // Remove blocking call
-    socket->disconnectFromHost();
+    connection->socket->write(response);
+    finishResponse(connection);
 }
 
-void MediaStreamer::streamFileRange(QTcpSocket *socket, qint64 startByte,
-                                    qint64 endByte)
+// Ends the response in progress; the connection either waits for the next
+// request or is closed
+void MediaStreamer::finishResponse(Connection *connection)
 {
-    // Create a new streaming context for this request
-    StreamingContext *context = new StreamingContext();
-    context->socket = socket;
-    context->device = m_device;
-    context->filePath = m_filePath;
-    context->startByte = startByte;
-    context->endByte = endByte;
-    context->bytesRemaining = endByte - startByte + 1;
-    context->afcHandle = 0;
-
-    qDebug() << "m_filepath" << m_filePath;
-    // Open file on device using ServiceManager
-    const QByteArray pathBytes = m_filePath.toUtf8();
-    afc_error_t openResult = ServiceManager::safeAfcFileOpen(
-        m_device, pathBytes.constData(), AFC_FOPEN_RDONLY, &context->afcHandle,
-        m_afcClient);
-
-    if (openResult != AFC_E_SUCCESS || context->afcHandle == 0) {
-        qWarning() << "Failed to open file on device:" << m_filePath;
-        delete context;
-        socket->disconnectFromHost();
-        return;
+    connection->streaming = false;
+    if (connection->reader) {
+        connection->reader->cancel();
+        connection->reader.reset();
     }
 
-    // Seek to start position if needed
-    if (startByte > 0) {
-        afc_error_t seekResult = ServiceManager::safeAfcFileSeek(
-            m_device, context->afcHandle, startByte, SEEK_SET, m_afcClient);
-        if (seekResult != AFC_E_SUCCESS) {
-            qWarning() << "Failed to seek in file:" << m_filePath;
-            ServiceManager::safeAfcFileClose(m_device, context->afcHandle,
-                                             m_afcClient);
-            delete context;
-            socket->disconnectFromHost();
-            return;
-        }
+    if (!connection->keepAlive) {
+        closeConnection(connection);
+        return;
     }
-
-    qDebug() << "Starting non-blocking stream for range" << startByte << "-"
-             << endByte << "(" << context->bytesRemaining << "bytes)";
-
-    // Store context as socket property for cleanup
-    socket->setProperty("streamingContext",
-                        QVariant::fromValue(static_cast<void *>(context)));
-
-    // Connect to socket signals for async streaming
-    connect(socket, &QTcpSocket::bytesWritten, this,
-            [this, context](qint64 bytes) {
-                Q_UNUSED(bytes)
-                // Check if context is still valid
-                QTcpSocket *senderSocket = qobject_cast<QTcpSocket *>(sender());
-                if (!senderSocket ||
-                    senderSocket->property("streamingContext").isNull()) {
-                    return; // Context already cleaned up
-                }
-                // Continue streaming when socket buffer has space
-                if (context->socket->bytesToWrite() <
-                    32768) { // Keep buffer below 32KB
-                    streamNextChunk(context);
-                }
-            });
-
-    connect(socket, &QTcpSocket::disconnected, this, [this, context]() {
-        // Check if context is still valid before cleanup
-        QTcpSocket *senderSocket = qobject_cast<QTcpSocket *>(sender());
-        if (!senderSocket ||
-            senderSocket->property("streamingContext").isNull()) {
-            return; // Already cleaned up
-        }
-        cleanupStreamingContext(context);
-    });
-
-    // Start streaming the first chunk
-    streamNextChunk(context);
+    connection->idleTimer->start();
 }
 
-qint64 MediaStreamer::getFileSize()
+void MediaStreamer::streamFileRange(Connection *connection,
+                                    StreamSource source,
+                                    const QString &filePath, qint64 startByte,
+                                    qint64 endByte)
 {
-    QMutexLocker locker(&m_fileSizeMutex);
-
-    if (m_fileSizeCached) {
-        return m_cachedFileSize;
-    }
-
-    // Get file info from device using ServiceManager
-    char **info = nullptr;
-    const QByteArray pathBytes = m_filePath.toUtf8();
-    afc_error_t result = ServiceManager::safeAfcGetFileInfo(
-        m_device, pathBytes.constData(), &info, m_afcClient);
-
-    if (result != AFC_E_SUCCESS || !info) {
-        qWarning() << "Failed to get file info for:" << m_filePath;
-        return -1;
-    }
-
-    qint64 fileSize = -1;
-    for (int i = 0; info[i]; i += 2) {
-        if (strcmp(info[i], "st_size") == 0) {
-            bool ok;
-            fileSize = QString(info[i + 1]).toLongLong(&ok);
-            if (!ok)
-                fileSize = -1;
-            break;
-        }
-    }
-
-    afc_dictionary_free(info);
+    connection->streaming = true;
+    connection->filePath = filePath;
+    connection->bytesRemaining = endByte - startByte + 1;
+
+    // Wakes the I/O thread when read-ahead data arrives; the socket is alive
+    // until the reader is cancelled, which happens before it is deleted
+    QTcpSocket *socket = connection->socket;
+    connection->reader = std::make_shared<RangeReader>(
+        &m_readPool, std::move(source), startByte, connection->bytesRemaining,
+        [this, socket, connection]() {
+            QMetaObject::invokeMethod(
+                socket, [this, connection]() { streamNextChunk(connection); },
+                Qt::QueuedConnection);
+        });
 
-    if (fileSize > 0) {
-        m_cachedFileSize = fileSize;
-        m_fileSizeCached = true;
-    }
+    qDebug() << "Starting non-blocking stream for range" << startByte << "-"
+             << endByte << "(" << connection->bytesRemaining << "bytes)";
 
-    return fileSize;
+    connection->reader->start();
 }
 
-QString MediaStreamer::getMimeType() const
+QString MediaStreamer::getMimeType(const QString &filePath)
 {
-    const QString lower = m_filePath.toLower();
+    const QString lower = filePath.toLower();
 
     if (lower.endsWith(".mp4") || lower.endsWith(".m4v")) {
         return "video/mp4";
@@ -399,111 +583,47 @@ QString MediaStreamer::getMimeType() const
     return "application/octet-stream";
 }
 
-void MediaStreamer::streamNextChunk(StreamingContext *context)
+// Moves read-ahead data to the socket until its buffer reaches
+// SOCKET_BUFFER_LOW; bytesWritten or the reader bring us back for the rest
+void MediaStreamer::streamNextChunk(Connection *connection)
 {
-    if (!context || !context->socket) {
-        return; // Invalid context, don't cleanup here
-    }
-
-    // Check if context has been marked for cleanup
-    if (context->socket->property("streamingContext").isNull()) {
-        return; // Already cleaned up
-    }
-
-    if (context->bytesRemaining <= 0) {
-        qDebug() << "Streaming completed for"
-                 << QFileInfo(context->filePath).fileName();
-        cleanupStreamingContext(context);
-        return;
-    }
-
-    // Check if socket is still valid
-    if (context->socket->state() != QAbstractSocket::ConnectedState) {
-        cleanupStreamingContext(context);
-        return;
-    }
-
-    const int CHUNK_SIZE = 64 * 1024; // 64KB chunks
-    const uint32_t bytesToRead = static_cast<uint32_t>(
-        qMin(static_cast<qint64>(CHUNK_SIZE), context->bytesRemaining));
-
-    auto buffer = std::make_unique<char[]>(bytesToRead);
-    uint32_t bytesRead = 0;
-
-    afc_error_t readResult = ServiceManager::safeAfcFileRead(
-        m_device, context->afcHandle, buffer.get(), bytesToRead, &bytesRead,
-        m_afcClient);
-
-    if (readResult != AFC_E_SUCCESS || bytesRead == 0) {
-        qWarning() << "AFC read error or EOF during streaming";
-        cleanupStreamingContext(context);
-        return;
-    }
-
-    const qint64 bytesWritten = context->socket->write(buffer.get(), bytesRead);
-    if (bytesWritten == -1) {
-        qWarning() << "Socket write error";
-        cleanupStreamingContext(context);
-        return;
-    }
-
-    context->bytesRemaining -= bytesWritten;
-
-    // If we're done, clean up
-    if (context->bytesRemaining <= 0) {
-        qDebug() << "Streaming completed for"
-                 << QFileInfo(context->filePath).fileName();
-        cleanupStreamingContext(context);
+    if (connection->closed || !connection->streaming) {
         return;
     }
 
-    // If socket buffer is getting full, let bytesWritten signal handle the next
-    // chunk Otherwise, continue immediately for better performance
-    if (context->socket->bytesToWrite() >= 32768) {
-        // Wait for bytesWritten signal
-        return;
-    } else {
-        // Continue immediately with safety check
-        QTimer::singleShot(0, this, [this, context]() {
-            // Double-check context is still valid when timer fires
-            if (context && context->socket &&
-                !context->socket->property("streamingContext").isNull()) {
-                streamNextChunk(context);
+    while (connection->bytesRemaining > 0 &&
+           connection->socket->bytesToWrite() < SOCKET_BUFFER_LOW) {
+        const QByteArray data = connection->reader->take(
+            SOCKET_BUFFER_LOW - connection->socket->bytesToWrite());
+        if (data.isEmpty()) {
+            // The response promised more bytes, the connection cannot be
+            // reused
+            if (connection->reader->failed()) {
+                qWarning() << "AFC read error or EOF during streaming";
+                closeConnection(connection);
             }
-        });
-    }
-}
-
-void MediaStreamer::cleanupStreamingContext(StreamingContext *context)
-{
-    if (!context)
-        return;
-
-    // Mark as cleaned up immediately to prevent double cleanup
-    if (context->socket) {
-        // Check if already cleaned up
-        if (context->socket->property("streamingContext").isNull()) {
-            return; // Already cleaned up
+            // Otherwise the reader calls back when data arrives
+            return;
         }
-        context->socket->setProperty("streamingContext", QVariant());
-    }
 
-    if (context->afcHandle != 0) {
-        ServiceManager::safeAfcFileClose(context->device, context->afcHandle,
-                                         m_afcClient);
-        context->afcHandle = 0;
+        if (connection->socket->write(data) == -1) {
+            qWarning() << "Socket write error";
+            closeConnection(connection);
+            return;
+        }
+        connection->bytesRemaining -= data.size();
     }
 
-    if (context->socket) {
-        // Disconnect all our custom signals to prevent further callbacks
-        disconnect(context->socket, &QTcpSocket::bytesWritten, this, nullptr);
-        disconnect(context->socket, &QTcpSocket::disconnected, this, nullptr);
-
-        context->socket->disconnectFromHost();
-        context->socket = nullptr; // Prevent further access
+    if (connection->bytesRemaining > 0) {
+        // Wait for bytesWritten signal
+        return;
     }
 
-    qDebug() << "Streaming context cleaned up for"
-             << QFileInfo(context->filePath).fileName();
-    delete context;
+    qDebug() << "Streaming completed for"
+             << QFileInfo(connection->filePath).fileName();
+    finishResponse(connection);
+    // Requests pipelined behind this one, from the event loop so a run of
+    // small ranges does not recurse
+    QTimer::singleShot(0, connection->socket,
+                       [this, connection]() { processRequests(connection); });
 }
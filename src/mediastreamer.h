@@ -20,17 +20,45 @@
 #ifndef MEDIASTREAMER_H
 #define MEDIASTREAMER_H
 
+#include "core/helpers/afc_block_cache.h"
+#include "core/helpers/faststart_reader.h"
 #include "iDescriptor.h"
+#include <QHash>
 #include <QMap>
-#include <QMutex>
 #include <QTcpServer>
+#include <QThreadPool>
 #include <QUrl>
+#include <atomic>
 #include <libimobiledevice/afc.h>
 
 QT_BEGIN_NAMESPACE
 class QTcpSocket;
+class QTimer;
 QT_END_NAMESPACE
 
+class RangeReader;
+
+/**
+ * @brief The bytes a stream URL serves: a device file, or its faststart view
+ */
+struct StreamSource {
+    std::shared_ptr<AfcBlockCache> cache;
+    std::shared_ptr<FaststartReader> faststart;
+
+    explicit operator bool() const { return cache != nullptr; }
+
+    uint64_t size() const
+    {
+        return faststart ? faststart->size() : cache->size();
+    }
+
+    qint64 read(uint64_t offset, char *data, uint64_t length) const
+    {
+        return faststart ? faststart->read(offset, data, length)
+                         : cache->read(offset, data, length);
+    }
+};
+
 /**
  * @brief A lightweight HTTP server for streaming media files from iOS devices
  *
@@ -39,27 +67,43 @@ QT_END_NAMESPACE
  * - HTTP Range requests for video scrubbing
  * - Streaming from AFC (Apple File Conduit) without loading entire file into
  * memory
- * - Thread-safe operation
+ * - Persistent connections with pipelined requests
  *
- * The server automatically shuts down when the client disconnects.
+ * One server serves every file, requests for /device/<udid>/<path> are routed
+ * to the files MediaStreamerManager has handed out URLs for. The server lives
+ * on its own I/O thread; file data is read ahead on a small pool into a
+ * bounded buffer per response, so neither a busy GUI nor a slow device read
+ * holds up the other.
  */
 class MediaStreamer : public QTcpServer
 {
     Q_OBJECT
 
 public:
-    explicit MediaStreamer(iDescriptorDevice *device, afc_client_t afcClient,
-                           const QString &filePath, QObject *parent = nullptr);
+    explicit MediaStreamer(QObject *parent = nullptr);
     ~MediaStreamer();
 
     /**
-     * @brief Get the URL that clients should use to connect to this server
-     * @return URL in format http://127.0.0.1:port
+     * @brief Start listening, call from the thread the server lives in
+     * @return false if no port could be bound
+     */
+    bool start();
+
+    /**
+     * @brief Get the URL that clients should use to stream a file
+     * @return URL in format http://127.0.0.1:port/device/<udid>/<path>
+     */
+    QUrl urlForFile(const QString &udid, const QString &filePath) const;
+
+    /**
+     * @brief Split a request path made by urlForFile
+     * @return false if the path does not name a device file
      */
-    QUrl getUrl() const;
+    static bool parseStreamPath(const QString &requestPath, QString &udid,
+                                QString &filePath);
 
     /**
-     * @brief Check if the server started successfully
+     * @brief Check if the server started successfully, from any thread
      * @return true if server is listening, false otherwise
      */
     bool isListening() const;
@@ -67,54 +111,59 @@ public:
 protected:
     void incomingConnection(qintptr socketDescriptor) override;
 
-private slots:
-    void handleClientDisconnected();
-
 private:
     struct HttpRequest {
         QString method;
         QString path;
         QString httpVersion;
         QMap<QString, QString> headers;
+        bool keepAlive = true;
         bool hasRange = false;
+        // -1 for a suffix range ("bytes=-500"), rangeEnd is then its length
         qint64 rangeStart = 0;
         qint64 rangeEnd = -1;
     };
 
-    struct StreamingContext {
-        QTcpSocket *socket;
-        iDescriptorDevice *device;
+    // One client connection. Requests are parsed as bytes arrive and
+    // answered in order, a pipelined request waits until the body before it
+    // has been sent.
+    struct Connection {
+        QTcpSocket *socket = nullptr;
+        QTimer *idleTimer = nullptr;
+        // Received bytes not parsed yet
+        QByteArray pending;
+        bool keepAlive = true;
+        bool closed = false;
+
+        // Body of the response being sent
+        bool streaming = false;
+        // Keeps the file readable while its range is streamed, even if its
+        // URL is released meanwhile
+        std::shared_ptr<RangeReader> reader;
         QString filePath;
-        qint64 startByte;
-        qint64 endByte;
-        qint64 bytesRemaining;
-        uint64_t afcHandle;
+        qint64 bytesRemaining = 0;
     };
 
-    HttpRequest parseHttpRequest(const QByteArray &requestData);
-    void handleRequest(QTcpSocket *socket, const HttpRequest &request);
-    void sendErrorResponse(QTcpSocket *socket, int statusCode,
+    static bool parseHttpRequest(const QByteArray &header,
+                                 HttpRequest &request);
+    void processRequests(Connection *connection);
+    void handleRequest(Connection *connection, const HttpRequest &request);
+    void sendErrorResponse(Connection *connection, int statusCode,
                            const QString &statusText);
-    void streamFileRange(QTcpSocket *socket, qint64 startByte, qint64 endByte);
-    void streamNextChunk(StreamingContext *context);
-    void cleanupStreamingContext(StreamingContext *context);
-    qint64 getFileSize();
-    QString getMimeType() const;
-
-    // Core data
-    iDescriptorDevice *m_device;
-    QString m_filePath;
-
-    // File info cache
-    mutable QMutex m_fileSizeMutex;
-    mutable qint64 m_cachedFileSize;
-    mutable bool m_fileSizeCached;
-
-    // Connection management
-    QList<QTcpSocket *> m_activeConnections;
-    QMutex m_connectionsMutex;
-
-    afc_client_t m_afcClient;
+    QByteArray connectionHeaders(const Connection *connection) const;
+    void streamFileRange(Connection *connection, StreamSource source,
+                         const QString &filePath, qint64 startByte,
+                         qint64 endByte);
+    void streamNextChunk(Connection *connection);
+    void finishResponse(Connection *connection);
+    void closeConnection(Connection *connection);
+    static QString getMimeType(const QString &filePath);
+
+    QHash<QTcpSocket *, Connection *> m_connections;
+    // Set once by start(), read from other threads for URLs
+    std::atomic<quint16> m_port{0};
+    // Device reads for all responses
+    QThreadPool m_readPool;
 };
 
-#endif // MEDIASTREAMER_H
\ No newline at end of file
+#endif // MEDIASTREAMER_H
@@ -19,8 +19,11 @@
 
 #include "mediastreamermanager.h"
 #include "mediastreamer.h"
+#include "settingsmanager.h"
+#include <QCoreApplication>
 #include <QDebug>
 #include <QMutexLocker>
+#include <utility>
 
 MediaStreamerManager::~MediaStreamerManager() { cleanup(); }
 
@@ -34,80 +37,158 @@ QUrl MediaStreamerManager::getStreamUrl(iDescriptorDevice *device,
                                         afc_client_t afcClient,
                                         const QString &filePath)
 {
-    QMutexLocker locker(&m_streamersMutex);
-
-    // Check if we already have a streamer for this file
-    auto it = m_streamers.find(filePath);
-    if (it != m_streamers.end()) {
-        // Verify the streamer is still valid and listening
-        if (it->streamer && it->streamer->isListening()) {
-            it->refCount++;
-            qDebug() << "MediaStreamerManager: Reusing existing streamer for"
-                     << filePath << "refCount:" << it->refCount;
-            return it->streamer->getUrl();
-        } else {
-            // Clean up invalid streamer
-            qDebug() << "MediaStreamerManager: Cleaning up invalid streamer for"
-                     << filePath;
-            if (it->streamer) {
-                it->streamer->deleteLater();
-            }
-            m_streamers.erase(it);
+    QMutexLocker locker(&m_streamsMutex);
+
+    if (!m_server) {
+        auto *ioThread = new QThread();
+        ioThread->setObjectName("MediaStreamer");
+        ioThread->start();
+
+        // Without a QObject parent, it lives as long as the manager. Its
+        // sockets must be created on the thread it serves them from, so it
+        // starts listening there too
+        auto *server = new MediaStreamer(nullptr);
+        server->moveToThread(ioThread);
+        bool started = false;
+        QMetaObject::invokeMethod(
+            server, [server, &started]() { started = server->start(); },
+            Qt::BlockingQueuedConnection);
+        if (!started) {
+            qWarning() << "MediaStreamerManager: Failed to start server";
+            QMetaObject::invokeMethod(
+                server, [server]() { delete server; },
+                Qt::BlockingQueuedConnection);
+            ioThread->quit();
+            ioThread->wait();
+            delete ioThread;
+            return QUrl();
         }
-    }
+        m_server = server;
+        m_ioThread = ioThread;
 
-    // Create new streamer without a QObject parent
-    auto *streamer = new MediaStreamer(device, afcClient, filePath, nullptr);
-    if (!streamer->isListening()) {
-        qWarning() << "MediaStreamerManager: Failed to create streamer for"
-                   << filePath;
-        delete streamer;
-        return QUrl();
+        // The thread's event loop is needed to stop the server, which it
+        // may not have by the time static objects are destroyed
+        if (!m_cleanupOnQuit) {
+            m_cleanupOnQuit = true;
+            QObject::connect(qApp, &QCoreApplication::aboutToQuit, qApp,
+                             [this]() { cleanup(); });
+        }
     }
 
-    // Store the streamer info
-    StreamerInfo info;
-    info.streamer = streamer;
-    info.device = device;
-    info.refCount = 1;
-    m_streamers[filePath] = info;
-
-    qDebug() << "MediaStreamerManager: Created new streamer for" << filePath
-             << "at" << streamer->getUrl().toString();
+    const QString udid = QString::fromStdString(device->udid);
+    const QString key = streamKey(udid, filePath);
+    auto it = m_streams.find(key);
+    if (it != m_streams.end()) {
+        it->refCount++;
+        qDebug() << "MediaStreamerManager: Reusing stream for" << filePath
+                 << "refCount:" << it->refCount;
+    } else {
+        // Only movies have a header to move
+        const bool faststart =
+            SettingsManager::sharedInstance()->faststartVideoPreview() &&
+            (filePath.endsWith(".MOV", Qt::CaseInsensitive) ||
+             filePath.endsWith(".MP4", Qt::CaseInsensitive) ||
+             filePath.endsWith(".M4V", Qt::CaseInsensitive));
+        m_streams.insert(key,
+                         StreamInfo{device, afcClient, nullptr, 1, faststart});
+        qDebug() << "MediaStreamerManager: Added stream for" << filePath;
+    }
 
-    return streamer->getUrl();
+    return m_server->urlForFile(udid, filePath);
 }
 
-void MediaStreamerManager::releaseStreamer(const QString &filePath)
+void MediaStreamerManager::releaseStream(const QUrl &url)
 {
-    QMutexLocker locker(&m_streamersMutex);
-    auto it = m_streamers.find(filePath);
-    if (it != m_streamers.end()) {
+    QString udid;
+    QString filePath;
+    if (!MediaStreamer::parseStreamPath(url.path(QUrl::FullyEncoded), udid,
+                                        filePath))
+        return;
+
+    QMutexLocker locker(&m_streamsMutex);
+    auto it = m_streams.find(streamKey(udid, filePath));
+    if (it != m_streams.end()) {
         it->refCount--;
-        qDebug() << "MediaStreamerManager: Released streamer for" << filePath
+        qDebug() << "MediaStreamerManager: Released stream for" << filePath
                  << "refCount:" << it->refCount;
 
-        // If no more references, delete it immediately.
-        // deleteLater() will not work in a thread without an event loop.
+        // Ranges still being sent hold their own reference to the cache
         if (it->refCount <= 0) {
-            qDebug() << "MediaStreamerManager: Deleting streamer for"
+            qDebug() << "MediaStreamerManager: Removing stream for"
                      << filePath;
-            delete it->streamer;
-            m_streamers.erase(it);
+            m_streams.erase(it);
         }
     }
 }
 
-void MediaStreamerManager::cleanup()
+StreamSource MediaStreamerManager::openStream(const QString &udid,
+                                              const QString &filePath)
 {
-    QMutexLocker locker(&m_streamersMutex);
-    auto it = m_streamers.begin();
-    while (it != m_streamers.end()) {
-        qDebug() << "MediaStreamerManager: Cleaning up streamer for"
-                 << it.key();
-        if (it->streamer) {
-            delete it->streamer;
+    const QString key = streamKey(udid, filePath);
+    // Declared before the lock, so a cache that is dropped closes its
+    // handles on the device after the unlock
+    std::shared_ptr<AfcBlockCache> cache;
+    std::shared_ptr<AfcBlockCache> opened;
+    QMutexLocker locker(&m_streamsMutex);
+    auto it = m_streams.find(key);
+    if (it == m_streams.end())
+        return StreamSource();
+
+    cache = it->blockCache;
+    const bool faststart = it->faststart;
+    if (!cache) {
+        // Opening goes to the device, which must not keep getStreamUrl() or
+        // other streams waiting
+        iDescriptorDevice *device = it->device;
+        afc_client_t afcClient = it->afcClient;
+        locker.unlock();
+        opened = AfcBlockCache::open(device, filePath, afcClient);
+        if (!opened) {
+            qWarning() << "Failed to open file on device:" << filePath;
+            return StreamSource();
         }
-        it = m_streamers.erase(it);
+
+        // The stream may have been released meanwhile, or opened by another
+        // request, whose cache is then shared
+        locker.relock();
+        it = m_streams.find(key);
+        if (it == m_streams.end())
+            return StreamSource();
+        if (!it->blockCache)
+            it->blockCache = opened;
+        cache = it->blockCache;
+    }
+    locker.unlock();
+
+    StreamSource source{cache, nullptr};
+    // The first open reads the movie header from the device, also unlocked
+    if (faststart)
+        source.faststart = FaststartReader::open(source.cache, key);
+    return source;
+}
+
+void MediaStreamerManager::cleanup()
+{
+    QMutexLocker locker(&m_streamsMutex);
+    qDebug() << "MediaStreamerManager: Cleaning up" << m_streams.size()
+             << "streams";
+    m_streams.clear();
+    MediaStreamer *server = std::exchange(m_server, nullptr);
+    QThread *ioThread = std::exchange(m_ioThread, nullptr);
+    // The server thread may be waiting for the lock in openStream()
+    locker.unlock();
+
+    if (!server)
+        return;
+    // Its sockets have to be closed on their own thread
+    if (ioThread->isRunning()) {
+        QMetaObject::invokeMethod(
+            server, [server]() { delete server; },
+            Qt::BlockingQueuedConnection);
+        ioThread->quit();
+        ioThread->wait();
+    } else {
+        delete server;
     }
-}
\ No newline at end of file
+    delete ioThread;
+}
@@ -22,18 +22,20 @@
 
 #include "iDescriptor.h"
 #include "mediastreamer.h"
-#include <QMap>
+#include <QHash>
 #include <QMutex>
 #include <QObject>
+#include <QThread>
 #include <QUrl>
 #include <libimobiledevice/afc.h>
 
 /**
- * @brief Singleton manager for MediaStreamer instances
+ * @brief Singleton owner of the process wide MediaStreamer
  *
- * This class manages MediaStreamer instances to avoid creating multiple
- * streamers for the same file. It automatically cleans up unused streamers
- * and provides thread-safe access.
+ * A single local HTTP server streams every file. This class hands out URLs
+ * for device files and keeps per-file state (device, AFC client, block cache)
+ * while a URL is in use, reclaiming it when the last user releases it. The
+ * server runs on a thread of its own; openStream() is called from there.
  */
 class MediaStreamerManager
 {
@@ -45,7 +47,7 @@ public:
     static MediaStreamerManager *sharedInstance();
 
     /**
-     * @brief Get or create a streamer for the specified file
+     * @brief Get a URL for streaming the specified file
      * @param device The iOS device
      * @param filePath The file path on the device
      * @return URL to stream the file, or empty URL if failed
@@ -54,13 +56,21 @@ public:
                       const QString &filePath);
 
     /**
-     * @brief Release a streamer for the specified file
-     * @param filePath The file path to release
+     * @brief Release a URL returned by getStreamUrl
      */
-    void releaseStreamer(const QString &filePath);
+    void releaseStream(const QUrl &url);
 
     /**
-     * @brief Clean up all inactive streamers
+     * @brief What to serve for a file with an unreleased URL. Its block
+     * cache is opened on first use so all requests for the file share it;
+     * movies with a trailing header are served in faststart layout when
+     * that is enabled
+     * @return empty if the file has no URL or cannot be opened
+     */
+    StreamSource openStream(const QString &udid, const QString &filePath);
+
+    /**
+     * @brief Stop the server and forget all files
      */
     void cleanup();
 
@@ -68,17 +78,27 @@ private:
     ~MediaStreamerManager();
 
 private:
-    struct StreamerInfo {
-        MediaStreamer *streamer;
+    struct StreamInfo {
         iDescriptorDevice *device;
+        afc_client_t afcClient;
+        std::shared_ptr<AfcBlockCache> blockCache;
         int refCount;
+        // Serve in faststart layout
+        bool faststart;
     };
 
-    static MediaStreamerManager *s_instance;
-    static QMutex s_instanceMutex;
+    // The separator keeps udid + path pairs from running into each other
+    static QString streamKey(const QString &udid, const QString &filePath)
+    {
+        return udid + '|' + filePath;
+    }
 
-    QMap<QString, StreamerInfo> m_streamers;
-    QMutex m_streamersMutex;
+    // Created on first use, the server lives in m_ioThread
+    MediaStreamer *m_server = nullptr;
+    QThread *m_ioThread = nullptr;
+    bool m_cleanupOnQuit = false;
+    QHash<QString, StreamInfo> m_streams;
+    QMutex m_streamsMutex;
 };
 
-#endif // MEDIASTREAMERMANAGER_H
\ No newline at end of file
+#endif // MEDIASTREAMERMANAGER_H
@@ -0,0 +1,1249 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mobilegestaltengine.h"
+#include "servicemanager.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStandardPaths>
+
+static QVariant plistToVariant(plist_t node)
+{
+    if (!node)
+        return {};
+
+    switch (plist_get_node_type(node)) {
+    case PLIST_BOOLEAN: {
+        uint8_t value = 0;
+        plist_get_bool_val(node, &value);
+        return static_cast<bool>(value);
+    }
+    case PLIST_UINT: {
+        uint64_t value = 0;
+        plist_get_uint_val(node, &value);
+        return static_cast<qulonglong>(value);
+    }
+    case PLIST_REAL: {
+        double value = 0;
+        plist_get_real_val(node, &value);
+        return value;
+    }
+    case PLIST_STRING:
+        return QString::fromStdString(PlistNavigator(node).getString());
+    case PLIST_DATA: {
+        char *data = nullptr;
+        uint64_t length = 0;
+        plist_get_data_val(node, &data, &length);
+        QByteArray bytes(data, static_cast<qsizetype>(length));
+        free(data);
+        return bytes;
+    }
+    case PLIST_ARRAY: {
+        QVariantList list;
+        uint32_t count = plist_array_get_size(node);
+        for (uint32_t i = 0; i < count; i++) {
+            list.append(plistToVariant(plist_array_get_item(node, i)));
+        }
+        return list;
+    }
+    case PLIST_DICT: {
+        QVariantMap map;
+        plist_dict_iter it = nullptr;
+        plist_dict_new_iter(node, &it);
+        plist_t item = nullptr;
+        do {
+            char *key = nullptr;
+            plist_dict_next_item(node, it, &key, &item);
+            if (item && key) {
+                map.insert(QString::fromUtf8(key), plistToVariant(item));
+            }
+            free(key);
+        } while (item);
+        plist_mem_free(it);
+        return map;
+    }
+    default:
+        return {};
+    }
+}
+
+MobileGestaltEngine *MobileGestaltEngine::sharedInstance()
+{
+    static MobileGestaltEngine instance;
+    return &instance;
+}
+
+MobileGestaltEngine::~MobileGestaltEngine()
+{
+    for (CacheEntry &entry : m_cache) {
+        if (entry.values)
+            plist_free(entry.values);
+    }
+}
+
+// Cached answers only change with the OS, so udid + build is a stable key
+QString MobileGestaltEngine::cacheKey(iDescriptorDevice *device)
+{
+    return QString::fromStdString(device->udid) + "-" +
+           QString::fromStdString(device->deviceInfo.buildVersion);
+}
+
+// Volatile keys are never cached, the rest only change with the OS
+static const QSet<QString> &volatileKeys()
+{
+    static const QSet<QString> keys = {
+        "AirplaneMode",
+        "BatteryCurrentCapacity",
+        "BatteryIsCharging",
+        "BatteryIsFullyCharged",
+        "DeviceName",
+        "DiskUsage",
+        "ExternalPowerSourceConnected",
+        "UserAssignedDeviceName",
+    };
+    return keys;
+}
+
+bool MobileGestaltEngine::isVolatile(const QString &key)
+{
+    return volatileKeys().contains(key);
+}
+
+QString MobileGestaltEngine::cacheFilePath(const QString &key)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           "/mobilegestalt/" + key + ".plist";
+}
+
+MobileGestaltEngine::CacheEntry &
+MobileGestaltEngine::entryFor(const QString &key)
+{
+    auto it = m_cache.find(key);
+    if (it != m_cache.end())
+        return *it;
+
+    CacheEntry entry;
+    QFile file(cacheFilePath(key));
+    if (file.open(QIODevice::ReadOnly)) {
+        QByteArray data = file.readAll();
+        plist_t root = nullptr;
+        plist_from_bin(data.constData(), static_cast<uint32_t>(data.size()),
+                       &root);
+        if (root && plist_get_node_type(root) == PLIST_DICT) {
+            plist_t values = plist_dict_get_item(root, "Values");
+            if (values && plist_get_node_type(values) == PLIST_DICT)
+                entry.values = plist_copy(values);
+
+            PlistNavigator missing = PlistNavigator(root)["Missing"];
+            if (missing.valid() &&
+                plist_get_node_type(missing) == PLIST_ARRAY) {
+                uint32_t count = plist_array_get_size(missing);
+                for (uint32_t i = 0; i < count; i++) {
+                    entry.missing.insert(QString::fromStdString(
+                        missing[static_cast<int>(i)].getString()));
+                }
+            }
+        }
+        if (root)
+            plist_free(root);
+    }
+
+    if (!entry.values)
+        entry.values = plist_new_dict();
+
+    // drop volatile answers a cache file from an older version may hold
+    for (const QString &k : volatileKeys()) {
+        plist_dict_remove_item(entry.values, k.toUtf8().constData());
+        entry.missing.remove(k);
+    }
+
+    return *m_cache.insert(key, entry);
+}
+
+void MobileGestaltEngine::save(const QString &key, const CacheEntry &entry)
+{
+    QString path = cacheFilePath(key);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    plist_t root = plist_new_dict();
+    plist_dict_set_item(root, "Values", plist_copy(entry.values));
+    plist_t missing = plist_new_array();
+    for (const QString &k : entry.missing) {
+        plist_array_append_item(missing,
+                                plist_new_string(k.toUtf8().constData()));
+    }
+    plist_dict_set_item(root, "Missing", missing);
+
+    char *bin = nullptr;
+    uint32_t length = 0;
+    plist_to_bin(root, &bin, &length);
+    plist_free(root);
+
+    QFile file(path);
+    if (bin && file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        file.write(bin, length);
+    } else {
+        qDebug() << "Failed to write MobileGestalt cache to" << path;
+    }
+    if (bin)
+        plist_mem_free(bin);
+}
+
+QMap<QString, QVariant>
+MobileGestaltEngine::query(iDescriptorDevice *device, const QStringList &keys)
+{
+    if (!device)
+        return {};
+
+    const QString key = cacheKey(device);
+    QMutexLocker locker(&m_mutex);
+
+    QMap<QString, QVariant> results;
+    QStringList pending;
+    {
+        const CacheEntry &entry = entryFor(key);
+        for (const QString &k : keys) {
+            if (isVolatile(k) ||
+                (!plist_dict_get_item(entry.values, k.toUtf8().constData()) &&
+                 !entry.missing.contains(k))) {
+                pending.append(k);
+            }
+        }
+    }
+
+    if (!pending.isEmpty()) {
+        qDebug() << "MobileGestalt: fetching" << pending.size()
+                 << "uncached key(s) of" << keys.size();
+        // Other devices and invalidate() must not wait for this one
+        locker.unlock();
+        plist_t fetched = nullptr;
+        QStringList failed;
+        bool ok = ServiceManager::executeOperation<bool>(
+            device,
+            [&]() -> bool {
+                return query_mobile_gestalt(device, pending, fetched, &failed);
+            },
+            false);
+        locker.relock();
+
+        // The entry may have been invalidated meanwhile, entryFor() then
+        // starts a fresh one. Only remember misses from chunks that
+        // answered, a failed request says nothing about whether its keys
+        // exist.
+        CacheEntry &entry = entryFor(key);
+        if (ok && fetched) {
+            for (const QString &k : pending) {
+                if (!isVolatile(k))
+                    continue;
+                const QByteArray name = k.toUtf8();
+                plist_t node = plist_dict_get_item(fetched, name.constData());
+                if (node) {
+                    results.insert(k, plistToVariant(node));
+                    plist_dict_remove_item(fetched, name.constData());
+                }
+            }
+
+            plist_dict_merge(&entry.values, fetched);
+            const QSet<QString> unanswered(failed.begin(), failed.end());
+            for (const QString &k : pending) {
+                if (!isVolatile(k) && !unanswered.contains(k) &&
+                    !plist_dict_get_item(fetched, k.toUtf8().constData()))
+                    entry.missing.insert(k);
+            }
+            save(key, entry);
+        }
+        if (fetched)
+            plist_free(fetched);
+    }
+
+    const CacheEntry &entry = entryFor(key);
+    for (const QString &k : keys) {
+        if (isVolatile(k))
+            continue;
+        plist_t node = plist_dict_get_item(entry.values, k.toUtf8().constData());
+        if (node)
+            results.insert(k, plistToVariant(node));
+    }
+    return results;
+}
+
+void MobileGestaltEngine::invalidate(iDescriptorDevice *device)
+{
+    if (!device)
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    const QString key = cacheKey(device);
+    auto it = m_cache.find(key);
+    if (it != m_cache.end()) {
+        if (it->values)
+            plist_free(it->values);
+        m_cache.erase(it);
+    }
+    QFile::remove(cacheFilePath(key));
+}
+
+const QStringList &MobileGestaltEngine::allKeys()
+{
+    // Credits ->
+    // https://github.com/doronz88/pymobiledevice3/blob/master/pymobiledevice3/services/diagnostics.py
+    static const QStringList keys = {
+        "3GProximityCapability",
+        "3GVeniceCapability",
+        "3Gvenice",
+        "3d-imagery",
+        "3d-maps",
+        "64-bit",
+        "720p",
+        "720pPlaybackCapability",
+        "APNCapability",
+        "ARM64ExecutionCapability",
+        "ARMV6ExecutionCapability",
+        "ARMV7ExecutionCapability",
+        "ARMV7SExecutionCapability",
+        "ASTC",
+        "AWDID",
+        "AWDLCapability",
+        "AccelerometerCapability",
+        "AccessibilityCapability",
+        "AcousticID",
+        "ActivationProtocol",
+        "ActiveWirelessTechnology",
+        "ActuatorResonantFrequency",
+        "AdditionalTextTonesCapability",
+        "AggregateDevicePhotoZoomFactor",
+        "AggregateDeviceVideoZoomFactor",
+        "AirDropCapability",
+        "AirDropRestriction",
+        "AirplaneMode",
+        "AirplayMirroringCapability",
+        "AllDeviceCapabilities",
+        "Allow32BitApps",
+        "AllowOnlyATVCPSDKApps",
+        "AllowYouTube",
+        "AllowYouTubePlugin",
+        "AmbientLightSensorCapability",
+        "AmbientLightSensorSerialNumber",
+        "ApNonce",
+        "ApNonceRetrieve",
+        "AppCapacityTVOS",
+        "AppStore",
+        "AppStoreCapability",
+        "AppleInternalInstallCapability",
+        "AppleNeuralEngineSubtype",
+        "ApplicationInstallationCapability",
+        "ArcModuleSerialNumber",
+        "ArrowChipID",
+        "ArrowUniqueChipID",
+        "ArtworkTraits",
+        "AssistantCapability",
+        "AudioPlaybackCapability",
+        "AutoFocusCameraCapability",
+        "AvailableDisplayZoomSizes",
+        "BacklightCapability",
+        "BasebandAPTimeSync",
+        "BasebandBoardSnum",
+        "BasebandCertId",
+        "BasebandChipId",
+        "BasebandChipset",
+        "BasebandClass",
+        "BasebandFirmwareManifestData",
+        "BasebandFirmwareUpdateInfo",
+        "BasebandFirmwareVersion",
+        "BasebandKeyHashInformation",
+        "BasebandPostponementStatus",
+        "BasebandPostponementStatusBlob",
+        "BasebandRegionSKU",
+        "BasebandRegionSKURadioTechnology",
+        "BasebandSecurityInfoBlob",
+        "BasebandSerialNumber",
+        "BasebandSkeyId",
+        "BasebandStatus",
+        "BasebandUniqueId",
+        "BatteryCurrentCapacity",
+        "BatteryIsCharging",
+        "BatteryIsFullyCharged",
+        "BatterySerialNumber",
+        "BlueLightReductionSupported",
+        "BluetoothAddress",
+        "BluetoothAddressData",
+        "BluetoothCapability",
+        "BluetoothLE2Capability",
+        "BluetoothLECapability",
+        "BoardId",
+        "BoardRevision",
+        "BootManifestHash",
+        "BootNonce",
+        "BridgeBuild",
+        "BridgeRestoreVersion",
+        "BuddyLanguagesAnimationRequiresOptimization",
+        "BuildID",
+        "BuildVersion",
+        "C2KDeviceCapability",
+        "CPUArchitecture",
+        "CPUSubType",
+        "CPUType",
+        "CallForwardingCapability",
+        "CallWaitingCapability",
+        "CallerIDCapability",
+        "CameraAppUIVersion",
+        "CameraCapability",
+        "CameraFlashCapability",
+        "CameraFrontFlashCapability",
+        "CameraHDR2Capability",
+        "CameraHDRVersion",
+        "CameraLiveEffectsCapability",
+        "CameraMaxBurstLength",
+        "CameraRestriction",
+        "CarrierBundleInfoArray",
+        "CarrierInstallCapability",
+        "CellBroadcastCapability",
+        "CellularDataCapability",
+        "CellularTelephonyCapability",
+        "CertificateProductionStatus",
+        "CertificateSecurityMode",
+        "ChipID",
+        "CloudPhotoLibraryCapability",
+        "CoastlineGlowRenderingCapability",
+        "CompassCalibration",
+        "CompassCalibrationDictionary",
+        "CompassType",
+        "ComputerName",
+        "ConferenceCallType",
+        "ConfigNumber",
+        "ContainsCellularRadioCapability",
+        "ContinuityCapability",
+        "CoreRoutineCapability",
+        "CoverglassSerialNumber",
+        "DMin",
+        "DataPlanCapability",
+        "DebugBoardRevision",
+        "DelaySleepForHeadsetClickCapability",
+        "DesenseBuild",
+        "DeviceAlwaysPrewarmActuator",
+        "DeviceBackGlassMaterial",
+        "DeviceBackingColor",
+        "DeviceBrand",
+        "DeviceClass",
+        "DeviceClassNumber",
+        "DeviceColor",
+        "DeviceColorMapPolicy",
+        "DeviceCornerRadius",
+        "DeviceCoverGlassColor",
+        "DeviceCoverGlassMaterial",
+        "DeviceCoverMaterial",
+        "DeviceEnclosureColor",
+        "DeviceEnclosureMaterial",
+        "DeviceEnclosureRGBColor",
+        "DeviceHasAggregateCamera",
+        "DeviceHousingColor",
+        "DeviceIsMuseCapable",
+        "DeviceKeyboardCalibration",
+        "DeviceLaunchTimeLimitScale",
+        "DeviceName",
+        "DeviceNameString",
+        "DevicePrefers3DBuildingStrokes",
+        "DevicePrefersBuildingStrokes",
+        "DevicePrefersCheapTrafficShaders",
+        "DevicePrefersProceduralAntiAliasing",
+        "DevicePrefersTrafficAlpha",
+        "DeviceProximityCapability",
+        "DeviceRGBColor",
+        "DeviceRequiresPetalOptimization",
+        "DeviceRequiresProximityAmeliorations",
+        "DeviceRequiresSoftwareBrightnessCalculations",
+        "DeviceSceneUpdateTimeLimitScale",
+        "DeviceSubBrand",
+        "DeviceSupports1080p",
+        "DeviceSupports3DImagery",
+        "DeviceSupports3DMaps",
+        "DeviceSupports3rdPartyHaptics",
+        "DeviceSupports4G",
+        "DeviceSupports4k",
+        "DeviceSupports64Bit",
+        "DeviceSupports720p",
+        "DeviceSupports9Pin",
+        "DeviceSupportsAOP",
+        "DeviceSupportsARKit",
+        "DeviceSupportsASTC",
+        "DeviceSupportsAdaptiveMapsUI",
+        "DeviceSupportsAlwaysListening",
+        "DeviceSupportsAlwaysOnCompass",
+        "DeviceSupportsAlwaysOnTime",
+        "DeviceSupportsApplePencil",
+        "DeviceSupportsAutoLowLightVideo",
+        "DeviceSupportsAvatars",
+        "DeviceSupportsBatteryModuleAuthentication",
+        "DeviceSupportsBerkelium2",
+        "DeviceSupportsCCK",
+        "DeviceSupportsCameraCaptureOnTouchDown",
+        "DeviceSupportsCameraDeferredProcessing",
+        "DeviceSupportsCameraHaptics",
+        "DeviceSupportsCarIntegration",
+        "DeviceSupportsCinnamon",
+        "DeviceSupportsClosedLoopHaptics",
+        "DeviceSupportsCrudeProx",
+        "DeviceSupportsDClr",
+        "DeviceSupportsDoNotDisturbWhileDriving",
+        "DeviceSupportsELabel",
+        "DeviceSupportsEnhancedAC3",
+        "DeviceSupportsEnvironmentalDosimetry",
+        "DeviceSupportsExternalHDR",
+        "DeviceSupportsFloorCounting",
+        "DeviceSupportsHDRDeferredProcessing",
+        "DeviceSupportsHMEInARKit",
+        "DeviceSupportsHaptics",
+        "DeviceSupportsHardwareDetents",
+        "DeviceSupportsHeartHealthAlerts",
+        "DeviceSupportsHeartRateVariability",
+        "DeviceSupportsHiResBuildings",
+        "DeviceSupportsLineIn",
+        "DeviceSupportsLiquidDetection_CorrosionMitigation",
+        "DeviceSupportsLivePhotoAuto",
+        "DeviceSupportsLongFormAudio",
+        "DeviceSupportsMapsBlurredUI",
+        "DeviceSupportsMapsOpticalHeading",
+        "DeviceSupportsMomentCapture",
+        "DeviceSupportsNFC",
+        "DeviceSupportsNavigation",
+        "DeviceSupportsNewton",
+        "DeviceSupportsOnDemandPhotoAnalysis",
+        "DeviceSupportsP3ColorspaceVideoRecording",
+        "DeviceSupportsPeriodicALSUpdates",
+        "DeviceSupportsPhotosLocalLight",
+        "DeviceSupportsPortraitIntensityAdjustments",
+        "DeviceSupportsPortraitLightEffectFilters",
+        "DeviceSupportsRGB10",
+        "DeviceSupportsRaiseToSpeak",
+        "DeviceSupportsSiDP",
+        "DeviceSupportsSideButtonClickSpeed",
+        "DeviceSupportsSimplisticRoadMesh",
+        "DeviceSupportsSingleCameraPortrait",
+        "DeviceSupportsSiriBargeIn",
+        "DeviceSupportsSiriSpeaks",
+        "DeviceSupportsSiriSpokenMessages",
+        "DeviceSupportsSpatialOverCapture",
+        "DeviceSupportsStereoAudioRecording",
+        "DeviceSupportsStudioLightPortraitPreview",
+        "DeviceSupportsSwimmingWorkouts",
+        "DeviceSupportsTapToWake",
+        "DeviceSupportsTelephonyOverUSB",
+        "DeviceSupportsTethering",
+        "DeviceSupportsToneMapping",
+        "DeviceSupportsUSBTypeC",
+        "DeviceSupportsVSHCompensation",
+        "DeviceSupportsVoiceOverCanUseSiriVoice",
+        "DeviceSupportsWebkit",
+        "DeviceSupportsWirelessSplitting",
+        "DeviceSupportsYCbCr10",
+        "DeviceVariant",
+        "DeviceVariantGuess",
+        "DiagData",
+        "DictationCapability",
+        "DieId",
+        "DiskUsage",
+        "DisplayDriverICChipID",
+        "DisplayFCCLogosViaSoftwareCapability",
+        "DisplayMirroringCapability",
+        "DisplayPortCapability",
+        "DualSIMActivationPolicyCapable",
+        "EUICCChipID",
+        "EffectiveProductionStatus",
+        "EffectiveProductionStatusAp",
+        "EffectiveProductionStatusSEP",
+        "EffectiveSecurityMode",
+        "EffectiveSecurityModeAp",
+        "EffectiveSecurityModeSEP",
+        "EncodeAACCapability",
+        "EncryptedDataPartitionCapability",
+        "EnforceCameraShutterClick",
+        "EnforceGoogleMail",
+        "EthernetMacAddress",
+        "EthernetMacAddressData",
+        "ExplicitContentRestriction",
+        "ExternalChargeCapability",
+        "ExternalPowerSourceConnected",
+        "FDRSealingStatus",
+        "FMFAllowed",
+        "FaceTimeBackCameraTemporalNoiseReductionMode",
+        "FaceTimeBitRate2G",
+        "FaceTimeBitRate3G",
+        "FaceTimeBitRateLTE",
+        "FaceTimeBitRateWiFi",
+        "FaceTimeCameraRequiresFastSwitchOptions",
+        "FaceTimeCameraSupportsHardwareFaceDetection",
+        "FaceTimeDecodings",
+        "FaceTimeEncodings",
+        "FaceTimeFrontCameraTemporalNoiseReductionMode",
+        "FaceTimePhotosOptIn",
+        "FaceTimePreferredDecoding",
+        "FaceTimePreferredEncoding",
+        "FirmwareNonce",
+        "FirmwarePreflightInfo",
+        "FirmwareVersion",
+        "FirstPartyLaunchTimeLimitScale",
+        "ForwardCameraCapability",
+        "FrontCameraOffsetFromDisplayCenter",
+        "FrontCameraRotationFromDisplayNormal",
+        "FrontFacingCameraAutoHDRCapability",
+        "FrontFacingCameraBurstCapability",
+        "FrontFacingCameraCapability",
+        "FrontFacingCameraHDRCapability",
+        "FrontFacingCameraHDROnCapability",
+        "FrontFacingCameraHFRCapability",
+        "FrontFacingCameraHFRVideoCapture1080pMaxFPS",
+        "FrontFacingCameraHFRVideoCapture720pMaxFPS",
+        "FrontFacingCameraMaxVideoZoomFactor",
+        "FrontFacingCameraModuleSerialNumber",
+        "FrontFacingCameraStillDurationForBurst",
+        "FrontFacingCameraVideoCapture1080pMaxFPS",
+        "FrontFacingCameraVideoCapture4kMaxFPS",
+        "FrontFacingCameraVideoCapture720pMaxFPS",
+        "FrontFacingIRCameraModuleSerialNumber",
+        "FrontFacingIRStructuredLightProjectorModuleSerialNumber",
+        "Full6FeaturesCapability",
+        "GPSCapability",
+        "GSDeviceName",
+        "GameKitCapability",
+        "GasGaugeBatteryCapability",
+        "GreenTeaDeviceCapability",
+        "GyroscopeCapability",
+        "H264EncoderCapability",
+        "HDRImageCaptureCapability",
+        "HDVideoCaptureCapability",
+        "HEVCDecoder10bitSupported",
+        "HEVCDecoder12bitSupported",
+        "HEVCDecoder8bitSupported",
+        "HEVCEncodingCapability",
+        "HMERefreshRateInARKit",
+        "HWModelStr",
+        "HallEffectSensorCapability",
+        "HardwareEncodeSnapshotsCapability",
+        "HardwareKeyboardCapability",
+        "HardwarePlatform",
+        "HardwareSnapshotsRequirePurpleGfxCapability",
+        "HasAllFeaturesCapability",
+        "HasAppleNeuralEngine",
+        "HasBaseband",
+        "HasBattery",
+        "HasDaliMode",
+        "HasExtendedColorDisplay",
+        "HasIcefall",
+        "HasInternalSettingsBundle",
+        "HasMesa",
+        "HasPKA",
+        "HasSEP",
+        "HasSpringBoard",
+        "HasThinBezel",
+        "HealthKitCapability",
+        "HearingAidAudioEqualizationCapability",
+        "HearingAidLowEnergyAudioCapability",
+        "HearingAidPowerReductionCapability",
+        "HiDPICapability",
+        "HiccoughInterval",
+        "HideNonDefaultApplicationsCapability",
+        "HighestSupportedVideoMode",
+        "HomeButtonType",
+        "HomeScreenWallpaperCapability",
+        "IDAMCapability",
+        "IOSurfaceBackedImagesCapability",
+        "IOSurfaceFormatDictionary",
+        "IceFallID",
+        "IcefallInRestrictedMode",
+        "IcefallInfo",
+        "Image4CryptoHashMethod",
+        "Image4Supported",
+        "InDiagnosticsMode",
+        "IntegratedCircuitCardIdentifier",
+        "IntegratedCircuitCardIdentifier2",
+        "InternalBuild",
+        "InternationalMobileEquipmentIdentity",
+        "InternationalMobileEquipmentIdentity2",
+        "InternationalSettingsCapability",
+        "InverseDeviceID",
+        "IsEmulatedDevice",
+        "IsLargeFormatPhone",
+        "IsPwrOpposedVol",
+        "IsServicePart",
+        "IsSimulator",
+        "IsThereEnoughBatteryLevelForSoftwareUpdate",
+        "IsUIBuild",
+        "JasperSerialNumber",
+        "LTEDeviceCapability",
+        "LaunchTimeLimitScaleSupported",
+        "LisaCapability",
+        "LoadThumbnailsWhileScrollingCapability",
+        "LocalizedDeviceNameString",
+        "LocationRemindersCapability",
+        "LocationServicesCapability",
+        "LowPowerWalletMode",
+        "LunaFlexSerialNumber",
+        "LynxPublicKey",
+        "LynxSerialNumber",
+        "MLBSerialNumber",
+        "MLEHW",
+        "MMSCapability",
+        "MacBridgingKeys",
+        "MagnetometerCapability",
+        "MainDisplayRotation",
+        "MainScreenCanvasSizes",
+        "MainScreenClass",
+        "MainScreenHeight",
+        "MainScreenOrientation",
+        "MainScreenPitch",
+        "MainScreenScale",
+        "MainScreenStaticInfo",
+        "MainScreenWidth",
+        "MarketingNameString",
+        "MarketingProductName",
+        "MarketingVersion",
+        "MaxH264PlaybackLevel",
+        "MaximumScreenScale",
+        "MedusaFloatingLiveAppCapability",
+        "MedusaOverlayAppCapability",
+        "MedusaPIPCapability",
+        "MedusaPinnedAppCapability",
+        "MesaSerialNumber",
+        "MetalCapability",
+        "MicrophoneCapability",
+        "MicrophoneCount",
+        "MinimumSupportediTunesVersion",
+        "MixAndMatchPrevention",
+        "MobileDeviceMinimumVersion",
+        "MobileEquipmentIdentifier",
+        "MobileEquipmentInfoBaseId",
+        "MobileEquipmentInfoBaseProfile",
+        "MobileEquipmentInfoBaseVersion",
+        "MobileEquipmentInfoCSN",
+        "MobileEquipmentInfoDisplayCSN",
+        "MobileSubscriberCountryCode",
+        "MobileSubscriberNetworkCode",
+        "MobileWifi",
+        "ModelNumber",
+        "MonarchLowEndHardware",
+        "MultiLynxPublicKeyArray",
+        "MultiLynxSerialNumberArray",
+        "MultitaskingCapability",
+        "MultitaskingGesturesCapability",
+        "MusicStore",
+        "MusicStoreCapability",
+        "N78aHack",
+        "NFCRadio",
+        "NFCRadioCalibrationDataPresent",
+        "NFCUniqueChipID",
+        "NVRAMDictionary",
+        "NandControllerUID",
+        "NavajoFusingState",
+        "NikeIpodCapability",
+        "NotGreenTeaDeviceCapability",
+        "OLEDDisplay",
+        "OTAActivationCapability",
+        "OfflineDictationCapability",
+        "OpenGLES1Capability",
+        "OpenGLES2Capability",
+        "OpenGLES3Capability",
+        "OpenGLESVersion",
+        "PTPLargeFilesCapability",
+        "PanelSerialNumber",
+        "PanoramaCameraCapability",
+        "PartitionType",
+        "PasswordConfigured",
+        "PasswordProtected",
+        "PearlCameraCapability",
+        "PearlIDCapability",
+        "PeekUICapability",
+        "PeekUIWidth",
+        "Peer2PeerCapability",
+        "PersonalHotspotCapability",
+        "PhoneNumber",
+        "PhoneNumber2",
+        "PhosphorusCapability",
+        "PhotoAdjustmentsCapability",
+        "PhotoCapability",
+        "PhotoSharingCapability",
+        "PhotoStreamCapability",
+        "PhotosPostEffectsCapability",
+        "PiezoClickerCapability",
+        "PintoMacAddress",
+        "PintoMacAddressData",
+        "PipelinedStillImageProcessingCapability",
+        "PlatformStandAloneContactsCapability",
+        "PlatinumCapability",
+        "ProductHash",
+        "ProductName",
+        "ProductType",
+        "ProductVersion",
+        "ProximitySensorCalibration",
+        "ProximitySensorCalibrationDictionary",
+        "ProximitySensorCapability",
+        "RF-exposure-separation-distance",
+        "RFExposureSeparationDistance",
+        "RawPanelSerialNumber",
+        "RearCameraCapability",
+        "RearCameraOffsetFromDisplayCenter",
+        "RearFacingCamera60fpsVideoCaptureCapability",
+        "RearFacingCameraAutoHDRCapability",
+        "RearFacingCameraBurstCapability",
+        "RearFacingCameraCapability",
+        "RearFacingCameraHDRCapability",
+        "RearFacingCameraHDROnCapability",
+        "RearFacingCameraHFRCapability",
+        "RearFacingCameraHFRVideoCapture1080pMaxFPS",
+        "RearFacingCameraHFRVideoCapture720pMaxFPS",
+        "RearFacingCameraMaxVideoZoomFactor",
+        "RearFacingCameraModuleSerialNumber",
+        "RearFacingCameraStillDurationForBurst",
+        "RearFacingCameraSuperWideCameraCapability",
+        "RearFacingCameraTimeOfFlightCameraCapability",
+        "RearFacingCameraVideoCapture1080pMaxFPS",
+        "RearFacingCameraVideoCapture4kMaxFPS",
+        "RearFacingCameraVideoCapture720pMaxFPS",
+        "RearFacingCameraVideoCaptureFPS",
+        "RearFacingLowLightCameraCapability",
+        "RearFacingSuperWideCameraModuleSerialNumber",
+        "RearFacingTelephotoCameraCapability",
+        "RearFacingTelephotoCameraModuleSerialNumber",
+        "RecoveryOSVersion",
+        "RegionCode",
+        "RegionInfo",
+        "RegionSupportsCinnamon",
+        "RegionalBehaviorAll",
+        "RegionalBehaviorChinaBrick",
+        "RegionalBehaviorEUVolumeLimit",
+        "RegionalBehaviorGB18030",
+        "RegionalBehaviorGoogleMail",
+        "RegionalBehaviorNTSC",
+        "RegionalBehaviorNoPasscodeLocationTiles",
+        "RegionalBehaviorNoVOIP",
+        "RegionalBehaviorNoWiFi",
+        "RegionalBehaviorShutterClick",
+        "RegionalBehaviorValid",
+        "RegionalBehaviorVolumeLimit",
+        "RegulatoryModelNumber",
+        "ReleaseType",
+        "RemoteBluetoothAddress",
+        "RemoteBluetoothAddressData",
+        "RenderWideGamutImagesAtDisplayTime",
+        "RendersLetterPressSlowly",
+        "RequiredBatteryLevelForSoftwareUpdate",
+        "RestoreOSBuild",
+        "RestrictedCountryCodes",
+        "RingerSwitchCapability",
+        "RosalineSerialNumber",
+        "RoswellChipID",
+        "RotateToWakeStatus",
+        "SBAllowSensitiveUI",
+        "SBCanForceDebuggingInfo",
+        "SDIOManufacturerTuple",
+        "SDIOProductInfo",
+        "SEInfo",
+        "SEPNonce",
+        "SIMCapability",
+        "SIMPhonebookCapability",
+        "SIMStatus",
+        "SIMStatus2",
+        "SIMTrayStatus",
+        "SIMTrayStatus2",
+        "SMSCapability",
+        "SavageChipID",
+        "SavageInfo",
+        "SavageSerialNumber",
+        "SavageUID",
+        "ScreenDimensions",
+        "ScreenDimensionsCapability",
+        "ScreenRecorderCapability",
+        "ScreenSerialNumber",
+        "SecondaryBluetoothMacAddress",
+        "SecondaryBluetoothMacAddressData",
+        "SecondaryEthernetMacAddress",
+        "SecondaryEthernetMacAddressData",
+        "SecondaryWifiMacAddress",
+        "SecondaryWifiMacAddressData",
+        "SecureElement",
+        "SecureElementID",
+        "SecurityDomain",
+        "SensitiveUICapability",
+        "SerialNumber",
+        "ShoeboxCapability",
+        "ShouldHactivate",
+        "SiKACapability",
+        "SigningFuse",
+        "SiliconBringupBoard",
+        "SimultaneousCallAndDataCurrentlySupported",
+        "SimultaneousCallAndDataSupported",
+        "SiriGestureCapability",
+        "SiriOfflineCapability",
+        "Skey",
+        "SoftwareBehavior",
+        "SoftwareBundleVersion",
+        "SoftwareDimmingAlpha",
+        "SpeakerCalibrationMiGa",
+        "SpeakerCalibrationSpGa",
+        "SpeakerCalibrationSpTS",
+        "SphereCapability",
+        "StarkCapability",
+        "StockholmJcopInfo",
+        "StrictWakeKeyboardCases",
+        "SupportedDeviceFamilies",
+        "SupportedKeyboards",
+        "SupportsBurninMitigation",
+        "SupportsEDUMU",
+        "SupportsForceTouch",
+        "SupportsIrisCapture",
+        "SupportsLowPowerMode",
+        "SupportsPerseus",
+        "SupportsRotateToWake",
+        "SupportsSOS",
+        "SupportsSSHBButtonType",
+        "SupportsTouchRemote",
+        "SysCfg",
+        "SysCfgDict",
+        "SystemImageID",
+        "SystemTelephonyOfAnyKindCapability",
+        "TVOutCrossfadeCapability",
+        "TVOutSettingsCapability",
+        "TelephonyCapability",
+        "TelephonyMaximumGeneration",
+        "TimeSyncCapability",
+        "TopModuleAuthChipID",
+        "TouchDelivery120Hz",
+        "TouchIDCapability",
+        "TristarID",
+        "UIBackgroundQuality",
+        "UIParallaxCapability",
+        "UIProceduralWallpaperCapability",
+        "UIReachability",
+        "UMTSDeviceCapability",
+        "UnifiedIPodCapability",
+        "UniqueChipID",
+        "UniqueDeviceID",
+        "UniqueDeviceIDData",
+        "UserAssignedDeviceName",
+        "UserIntentPhysicalButtonCGRect",
+        "UserIntentPhysicalButtonCGRectString",
+        "UserIntentPhysicalButtonNormalizedCGRect",
+        "VOIPCapability",
+        "VeniceCapability",
+        "VibratorCapability",
+        "VideoCameraCapability",
+        "VideoStillsCapability",
+        "VoiceControlCapability",
+        "VolumeButtonCapability",
+        "WAGraphicQuality",
+        "WAPICapability",
+        "WLANBkgScanCache",
+        "WSKU",
+        "WatchCompanionCapability",
+        "WatchSupportsAutoPlaylistPlayback",
+        "WatchSupportsHighQualityClockFaceGraphics",
+        "WatchSupportsListeningOnGesture",
+        "WatchSupportsMusicStreaming",
+        "WatchSupportsSiriCommute",
+        "WiFiCallingCapability",
+        "WiFiCapability",
+        "WifiAddress",
+        "WifiAddressData",
+        "WifiAntennaSKUVersion",
+        "WifiCallingSecondaryDeviceCapability",
+        "WifiChipset",
+        "WifiFirmwareVersion",
+        "WifiVendor",
+        "WirelessBoardSnum",
+        "WirelessChargingCapability",
+        "YonkersChipID",
+        "YonkersSerialNumber",
+        "YonkersUID",
+        "YouTubeCapability",
+        "YouTubePluginCapability",
+        "accelerometer",
+        "accessibility",
+        "additional-text-tones",
+        "aggregate-cam-photo-zoom",
+        "aggregate-cam-video-zoom",
+        "airDropRestriction",
+        "airplay-mirroring",
+        "airplay-no-mirroring",
+        "all-features",
+        "allow-32bit-apps",
+        "ambient-light-sensor",
+        "ane",
+        "any-telephony",
+        "apn",
+        "apple-internal-install",
+        "applicationInstallation",
+        "arkit",
+        "arm64",
+        "armv6",
+        "armv7",
+        "armv7s",
+        "assistant",
+        "auto-focus",
+        "auto-focus-camera",
+        "baseband-chipset",
+        "bitrate-2g",
+        "bitrate-3g",
+        "bitrate-lte",
+        "bitrate-wifi",
+        "bluetooth",
+        "bluetooth-le",
+        "board-id",
+        "boot-manifest-hash",
+        "boot-nonce",
+        "builtin-mics",
+        "c2k-device",
+        "calibration",
+        "call-forwarding",
+        "call-waiting",
+        "caller-id",
+        "camera-flash",
+        "camera-front",
+        "camera-front-flash",
+        "camera-rear",
+        "cameraRestriction",
+        "car-integration",
+        "cell-broadcast",
+        "cellular-data",
+        "certificate-production-status",
+        "certificate-security-mode",
+        "chip-id",
+        "class",
+        "closed-loop",
+        "config-number",
+        "contains-cellular-radio",
+        "crypto-hash-method",
+        "dali-mode",
+        "data-plan",
+        "debug-board-revision",
+        "delay-sleep-for-headset-click",
+        "device-color-policy",
+        "device-colors",
+        "device-name",
+        "device-name-localized",
+        "dictation",
+        "die-id",
+        "display-mirroring",
+        "display-rotation",
+        "displayport",
+        "does-not-support-gamekit",
+        "effective-production-status",
+        "effective-production-status-ap",
+        "effective-production-status-sep",
+        "effective-security-mode",
+        "effective-security-mode-ap",
+        "effective-security-mode-sep",
+        "enc-top-type",
+        "encode-aac",
+        "encrypted-data-partition",
+        "enforce-googlemail",
+        "enforce-shutter-click",
+        "euicc-chip-id",
+        "explicitContentRestriction",
+        "face-detection-support",
+        "fast-switch-options",
+        "fcc-logos-via-software",
+        "fcm-type",
+        "firmware-version",
+        "flash",
+        "front-auto-hdr",
+        "front-burst",
+        "front-burst-image-duration",
+        "front-facing-camera",
+        "front-flash-capability",
+        "front-hdr",
+        "front-hdr-on",
+        "front-max-video-fps-1080p",
+        "front-max-video-fps-4k",
+        "front-max-video-fps-720p",
+        "front-max-video-zoom",
+        "front-slowmo",
+        "full-6",
+        "function-button_halleffect",
+        "function-button_ringerab",
+        "gamekit",
+        "gas-gauge-battery",
+        "gps",
+        "gps-capable",
+        "green-tea",
+        "gyroscope",
+        "h264-encoder",
+        "hall-effect-sensor",
+        "haptics",
+        "hardware-keyboard",
+        "has-sphere",
+        "hd-video-capture",
+        "hdr-image-capture",
+        "healthkit",
+        "hearingaid-audio-equalization",
+        "hearingaid-low-energy-audio",
+        "hearingaid-power-reduction",
+        "hiccough-interval",
+        "hide-non-default-apps",
+        "hidpi",
+        "home-button-type",
+        "homescreen-wallpaper",
+        "hw-encode-snapshots",
+        "hw-snapshots-need-purplegfx",
+        "iAP2Capability",
+        "iPadCapability",
+        "iTunesFamilyID",
+        "iap2-protocol-supported",
+        "image4-supported",
+        "international-settings",
+        "io-surface-backed-images",
+        "ipad",
+        "kConferenceCallType",
+        "kSimultaneousCallAndDataCurrentlySupported",
+        "kSimultaneousCallAndDataSupported",
+        "large-format-phone",
+        "live-effects",
+        "live-photo-capture",
+        "load-thumbnails-while-scrolling",
+        "location-reminders",
+        "location-services",
+        "low-power-wallet-mode",
+        "lte-device",
+        "magnetometer",
+        "main-screen-class",
+        "main-screen-height",
+        "main-screen-orientation",
+        "main-screen-pitch",
+        "main-screen-scale",
+        "main-screen-width",
+        "marketing-name",
+        "mesa",
+        "metal",
+        "microphone",
+        "mix-n-match-prevention-status",
+        "mms",
+        "modelIdentifier",
+        "multi-touch",
+        "multitasking",
+        "multitasking-gestures",
+        "n78a-mode",
+        "name",
+        "navigation",
+        "nfc",
+        "nfcWithRadio",
+        "nike-ipod",
+        "nike-support",
+        "no-coreroutine",
+        "no-hi-res-buildings",
+        "no-simplistic-road-mesh",
+        "not-green-tea",
+        "offline-dictation",
+        "opal",
+        "opengles-1",
+        "opengles-2",
+        "opengles-3",
+        "opposed-power-vol-buttons",
+        "ota-activation",
+        "panorama",
+        "peek-ui-width",
+        "peer-peer",
+        "personal-hotspot",
+        "photo-adjustments",
+        "photo-stream",
+        "piezo-clicker",
+        "pipelined-stillimage-capability",
+        "platinum",
+        "post-effects",
+        "pressure",
+        "prox-sensor",
+        "proximity-sensor",
+        "ptp-large-files",
+        "public-key-accelerator",
+        "rear-auto-hdr",
+        "rear-burst",
+        "rear-burst-image-duration",
+        "rear-cam-telephoto-capability",
+        "rear-facing-camera",
+        "rear-hdr",
+        "rear-hdr-on",
+        "rear-max-slomo-video-fps-1080p",
+        "rear-max-slomo-video-fps-720p",
+        "rear-max-video-fps-1080p",
+        "rear-max-video-fps-4k",
+        "rear-max-video-fps-720p",
+        "rear-max-video-frame_rate",
+        "rear-max-video-zoom",
+        "rear-slowmo",
+        "regulatory-model-number",
+        "ringer-switch",
+        "role",
+        "s8000\")",
+        "s8003\")",
+        "sandman-support",
+        "screen-dimensions",
+        "sensitive-ui",
+        "shoebox",
+        "sika-support",
+        "sim",
+        "sim-phonebook",
+        "siri-gesture",
+        "slow-letterpress-rendering",
+        "sms",
+        "software-bundle-version",
+        "software-dimming-alpha",
+        "stand-alone-contacts",
+        "still-camera",
+        "stockholm",
+        "supports-always-listening",
+        "t7000\")",
+        "telephony",
+        "telephony-maximum-generation",
+        "thin-bezel",
+        "tnr-mode-back",
+        "tnr-mode-front",
+        "touch-id",
+        "tv-out-crossfade",
+        "tv-out-settings",
+        "ui-background-quality",
+        "ui-no-parallax",
+        "ui-no-procedural-wallpaper",
+        "ui-pip",
+        "ui-reachability",
+        "ui-traffic-cheap-shaders",
+        "ui-weather-quality",
+        "umts-device",
+        "unified-ipod",
+        "unique-chip-id",
+        "venice",
+        "video-camera",
+        "video-cap",
+        "video-stills",
+        "voice-control",
+        "voip",
+        "volume-buttons",
+        "wapi",
+        "watch-companion",
+        "wi-fi",
+        "wifi",
+        "wifi-antenna-sku-info",
+        "wifi-chipset",
+        "wifi-module-sn",
+        "wlan",
+        "wlan.background-scan-cache",
+        "youtube",
+        "youtubePlugin"};
+
+    return keys;
+}
@@ -0,0 +1,74 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOBILEGESTALTENGINE_H
+#define MOBILEGESTALTENGINE_H
+
+#include "iDescriptor.h"
+#include <QMap>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+#include <QVariant>
+#include <plist/plist.h>
+
+/**
+ * @brief Cached MobileGestalt lookups
+ *
+ * Keys are fetched from the device in chunked requests over one diagnostics
+ * session and the answers are cached per device and build, both in memory and
+ * on disk. Keys the device did not answer are remembered too, so a later
+ * query only goes to the device for keys that were never asked before.
+ * Volatile keys (battery, name, disk usage, ...) are never cached.
+ */
+class MobileGestaltEngine
+{
+public:
+    static MobileGestaltEngine *sharedInstance();
+
+    // Every key known to iDescriptor
+    static const QStringList &allKeys();
+
+    // Keys whose answer changes at runtime, always fetched from the device
+    static bool isVolatile(const QString &key);
+
+    QMap<QString, QVariant> query(iDescriptorDevice *device,
+                                  const QStringList &keys);
+
+    void invalidate(iDescriptorDevice *device);
+
+private:
+    MobileGestaltEngine() = default;
+    ~MobileGestaltEngine();
+
+    struct CacheEntry {
+        plist_t values = nullptr;
+        QSet<QString> missing;
+    };
+
+    static QString cacheKey(iDescriptorDevice *device);
+    static QString cacheFilePath(const QString &key);
+    CacheEntry &entryFor(const QString &key);
+    void save(const QString &key, const CacheEntry &entry);
+
+    QMap<QString, CacheEntry> m_cache;
+    QMutex m_mutex;
+};
+
+#endif // MOBILEGESTALTENGINE_H
@@ -156,8 +156,15 @@ void PhotoImportDialog::onServerStarted()
 }
 
 void PhotoImportDialog::onDownloadProgress(const QString &fileName,
-                                           int bytesDownloaded, int totalBytes)
+                                           qint64 bytesDownloaded,
+                                           qint64 totalBytes)
 {
+    if (bytesDownloaded < totalBytes) {
+        progressLabel->setText(QString("Sending: %1 (%2%)")
+                                   .arg(fileName)
+                                   .arg(bytesDownloaded * 100 / totalBytes));
+        return;
+    }
     progressLabel->setText(QString("Downloaded: %1 (%2 KB)")
                                .arg(fileName)
                                .arg(bytesDownloaded / 1024));
@@ -0,0 +1,298 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "photolibraryindex.h"
+#include "servicemanager.h"
+#include <QAtomicInt>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QReadLocker>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStandardPaths>
+
+static constexpr const char *REMOTE_DB_PATH = "/PhotoData/Photos.sqlite";
+static constexpr const char *REMOTE_WAL_PATH = "/PhotoData/Photos.sqlite-wal";
+static constexpr uint32_t COPY_CHUNK_SIZE = 1024 * 1024;
+// WAL growth that makes the local copy worth refreshing
+static constexpr quint64 WAL_RECOPY_THRESHOLD = 4 * 1024 * 1024;
+// Core Data stores dates as seconds since 2001-01-01 00:00:00 UTC
+static constexpr qint64 CORE_DATA_EPOCH_OFFSET = 978307200;
+
+PhotoLibraryIndex *PhotoLibraryIndex::sharedInstance()
+{
+    static PhotoLibraryIndex instance;
+    return &instance;
+}
+
+QString PhotoLibraryIndex::localDir(const QString &udid)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           "/photodb/" + udid;
+}
+
+bool PhotoLibraryIndex::statRemote(iDescriptorDevice *device,
+                                   const char *path, quint64 &size,
+                                   quint64 &mtime)
+{
+    plist_t info = nullptr;
+    if (ServiceManager::safeAfcGetFileInfoPlist(device, path, &info) !=
+            AFC_E_SUCCESS ||
+        !info) {
+        return false;
+    }
+
+    uint64_t value = 0;
+    plist_t node = plist_dict_get_item(info, "st_size");
+    if (node && plist_get_node_type(node) == PLIST_UINT) {
+        plist_get_uint_val(node, &value);
+        size = value;
+    }
+    value = 0;
+    node = plist_dict_get_item(info, "st_mtime");
+    if (node && plist_get_node_type(node) == PLIST_UINT) {
+        plist_get_uint_val(node, &value);
+        mtime = value;
+    }
+    plist_free(info);
+    return true;
+}
+
+bool PhotoLibraryIndex::copyRemote(iDescriptorDevice *device,
+                                   const char *remotePath,
+                                   const QString &localPath)
+{
+    uint64_t handle = 0;
+    if (ServiceManager::safeAfcFileOpen(device, remotePath, AFC_FOPEN_RDONLY,
+                                        &handle) != AFC_E_SUCCESS) {
+        qDebug() << "Could not open" << remotePath;
+        return false;
+    }
+
+    QFile out(localPath);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        ServiceManager::safeAfcFileClose(device, handle);
+        return false;
+    }
+
+    QByteArray buffer(COPY_CHUNK_SIZE, Qt::Uninitialized);
+    bool success = true;
+    while (true) {
+        uint32_t bytesRead = 0;
+        afc_error_t err = ServiceManager::safeAfcFileRead(
+            device, handle, buffer.data(), COPY_CHUNK_SIZE, &bytesRead);
+        if (err != AFC_E_SUCCESS) {
+            qDebug() << "Failed to read" << remotePath << "Error:" << err;
+            success = false;
+            break;
+        }
+        if (bytesRead == 0)
+            break;
+        if (out.write(buffer.constData(), bytesRead) != bytesRead) {
+            success = false;
+            break;
+        }
+    }
+    ServiceManager::safeAfcFileClose(device, handle);
+    out.close();
+
+    if (!success)
+        out.remove();
+    return success;
+}
+
+bool PhotoLibraryIndex::refresh(iDescriptorDevice *device,
+                                const QString &dir)
+{
+    const QString udid = QString::fromStdString(device->udid);
+
+    Snapshot current;
+    if (!statRemote(device, REMOTE_DB_PATH, current.dbSize,
+                    current.dbMtime)) {
+        qDebug() << "Photos library is not reachable over AFC";
+        return false;
+    }
+    const bool hasWal = statRemote(device, REMOTE_WAL_PATH, current.walSize,
+                                   current.walMtime);
+
+    // The WAL changes with nearly every library write. Small growth is not
+    // worth another copy, assets it holds are stat'ed by the caller instead.
+    const QString dbPath = dir + "/Photos.sqlite";
+    auto it = m_snapshots.constFind(udid);
+    if (it != m_snapshots.constEnd() && it->dbSize == current.dbSize &&
+        it->dbMtime == current.dbMtime &&
+        current.walSize < it->walSize + WAL_RECOPY_THRESHOLD &&
+        QFile::exists(dbPath)) {
+        return true;
+    }
+
+    // Copy next to the live files so queries keep reading the old copy, and
+    // a failed copy never leaves a truncated database behind
+    QDir().mkpath(dir);
+    const QString dbPart = dbPath + ".part";
+    const QString walPart = dbPath + "-wal.part";
+    if (!copyRemote(device, REMOTE_DB_PATH, dbPart))
+        return false;
+    const bool walCopied = hasWal && current.walSize > 0 &&
+                           copyRemote(device, REMOTE_WAL_PATH, walPart);
+    if (!walCopied) {
+        // The main database alone is still usable, just slightly behind
+        if (hasWal && current.walSize > 0)
+            qDebug() << "Could not copy Photos.sqlite-wal, using main "
+                        "database";
+        current.walSize = 0;
+        current.walMtime = 0;
+    }
+
+    QWriteLocker files(&m_filesLock);
+    // A stale wal-index would not match the new WAL, SQLite rebuilds it
+    QFile::remove(dbPath + "-shm");
+    QFile::remove(dbPath + "-wal");
+    QFile::remove(dbPath);
+    if (!QFile::rename(dbPart, dbPath) ||
+        (walCopied && !QFile::rename(walPart, dbPath + "-wal"))) {
+        m_snapshots.remove(udid);
+        return false;
+    }
+
+    m_snapshots.insert(udid, current);
+    return true;
+}
+
+QHash<QString, PhotoLibraryAsset>
+PhotoLibraryIndex::albumAssets(iDescriptorDevice *device,
+                               const QString &albumPath, bool *ok)
+{
+    if (ok)
+        *ok = false;
+    if (!device)
+        return {};
+
+    const QString udid = QString::fromStdString(device->udid);
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!refresh(device, localDir(udid)))
+            return {};
+    }
+    return queryAlbum(udid, albumPath, ok);
+}
+
+QHash<QString, PhotoLibraryAsset>
+PhotoLibraryIndex::cachedAlbumAssets(const QString &udid,
+                                     const QString &albumPath, bool *ok)
+{
+    if (ok)
+        *ok = false;
+    return queryAlbum(udid, albumPath, ok);
+}
+
+QHash<QString, PhotoLibraryAsset>
+PhotoLibraryIndex::queryAlbum(const QString &udid, const QString &albumPath,
+                              bool *ok)
+{
+    QHash<QString, PhotoLibraryAsset> assets;
+    QReadLocker files(&m_filesLock);
+    // Opening a missing file would create an empty database in its place
+    const QString dbPath = localDir(udid) + "/Photos.sqlite";
+    if (!QFile::exists(dbPath))
+        return assets;
+
+    // Connections are per thread, so every call gets its own
+    static QAtomicInt connectionCounter;
+    const QString connectionName =
+        QString("photolibrary-%1").arg(connectionCounter.fetchAndAddRelaxed(1));
+
+    bool success = false;
+    {
+        QSqlDatabase db =
+            QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(dbPath);
+        if (!db.open()) {
+            qDebug() << "Failed to open Photos.sqlite:"
+                     << db.lastError().text();
+        } else {
+            // The asset entity was renamed from ZGENERICASSET in iOS 14
+            QString assetTable;
+            QSqlQuery tables(db);
+            if (tables.exec("SELECT name FROM sqlite_master WHERE type = "
+                            "'table' AND name IN ('ZASSET', "
+                            "'ZGENERICASSET')")) {
+                while (tables.next()) {
+                    assetTable = tables.value(0).toString();
+                    if (assetTable == "ZASSET")
+                        break;
+                }
+            }
+
+            // ZDIRECTORY is relative to the media root, e.g. DCIM/100APPLE
+            QString directory = albumPath;
+            while (directory.startsWith('/'))
+                directory.remove(0, 1);
+
+            QSqlQuery query(db);
+            query.setForwardOnly(true);
+            if (!assetTable.isEmpty() &&
+                query.prepare(
+                    QString("SELECT a.ZFILENAME, a.ZDATECREATED, "
+                            "a.ZWIDTH, a.ZHEIGHT, a.ZKIND, "
+                            "aa.ZORIGINALFILESIZE FROM %1 a "
+                            "LEFT JOIN ZADDITIONALASSETATTRIBUTES aa ON "
+                            "aa.ZASSET = a.Z_PK WHERE a.ZDIRECTORY = ? "
+                            "ORDER BY a.Z_PK")
+                        .arg(assetTable))) {
+                query.addBindValue(directory);
+                if (query.exec()) {
+                    while (query.next()) {
+                        const QString fileName = query.value(0).toString();
+                        if (fileName.isEmpty() || assets.contains(fileName))
+                            continue;
+
+                        PhotoLibraryAsset asset;
+                        if (!query.value(1).isNull()) {
+                            asset.dateTime = QDateTime::fromSecsSinceEpoch(
+                                static_cast<qint64>(
+                                    query.value(1).toDouble()) +
+                                    CORE_DATA_EPOCH_OFFSET,
+                                Qt::UTC);
+                        }
+                        asset.dimensions = QSize(query.value(2).toInt(),
+                                                 query.value(3).toInt());
+                        asset.isVideo = query.value(4).toInt() == 1;
+                        asset.fileSize = query.value(5).toULongLong();
+                        assets.insert(fileName, asset);
+                    }
+                    success = true;
+                }
+            }
+            if (!success) {
+                qDebug() << "Photos.sqlite query failed:"
+                         << query.lastError().text();
+            }
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+
+    if (ok)
+        *ok = success;
+    return assets;
+}
@@ -0,0 +1,100 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PHOTOLIBRARYINDEX_H
+#define PHOTOLIBRARYINDEX_H
+
+#include "iDescriptor.h"
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QSize>
+#include <QString>
+
+/*
+ * Metadata of one asset as recorded by the Photos library, keyed by the
+ * file name inside its DCIM directory.
+ */
+struct PhotoLibraryAsset {
+    QDateTime dateTime;
+    QSize dimensions;
+    quint64 fileSize = 0;
+    bool isVideo = false;
+};
+
+/**
+ * @brief Local index of the device's Photos.sqlite
+ *
+ * Copies /PhotoData/Photos.sqlite (and its WAL) into the cache directory,
+ * re-copying only when the device copy changed, and answers album queries
+ * with SQLite so populating an album costs no per-file AFC round trips.
+ * Thread safe; queries are blocking and meant for worker threads. A refresh
+ * copies beside the live files, so cached queries are not held up by it.
+ */
+class PhotoLibraryIndex
+{
+public:
+    static PhotoLibraryIndex *sharedInstance();
+
+    /*
+     * Returns the assets of a DCIM album (e.g. "/DCIM/100APPLE") keyed by
+     * file name, refreshing the local copy first. Sets *ok to false when
+     * the library is not readable, in which case callers should fall back
+     * to stat'ing the files. Assets added since the last copy may be
+     * missing.
+     */
+    QHash<QString, PhotoLibraryAsset> albumAssets(iDescriptorDevice *device,
+                                                  const QString &albumPath,
+                                                  bool *ok = nullptr);
+
+    // Same as albumAssets, but answers from whatever local copy exists
+    // without touching the device
+    QHash<QString, PhotoLibraryAsset>
+    cachedAlbumAssets(const QString &udid, const QString &albumPath,
+                      bool *ok = nullptr);
+
+private:
+    PhotoLibraryIndex() = default;
+
+    struct Snapshot {
+        quint64 dbSize = 0;
+        quint64 dbMtime = 0;
+        quint64 walSize = 0;
+        quint64 walMtime = 0;
+    };
+
+    bool refresh(iDescriptorDevice *device, const QString &localDir);
+    QHash<QString, PhotoLibraryAsset> queryAlbum(const QString &udid,
+                                                 const QString &albumPath,
+                                                 bool *ok);
+    static bool statRemote(iDescriptorDevice *device, const char *path,
+                           quint64 &size, quint64 &mtime);
+    static bool copyRemote(iDescriptorDevice *device, const char *remotePath,
+                           const QString &localPath);
+    static QString localDir(const QString &udid);
+
+    QHash<QString, Snapshot> m_snapshots;
+    QMutex m_mutex; // serializes refreshes, guards m_snapshots
+    // Held for reading by queries and for writing while a refresh swaps in
+    // the new files
+    QReadWriteLock m_filesLock;
+};
+
+#endif // PHOTOLIBRARYINDEX_H
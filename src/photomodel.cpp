@@ -18,14 +18,21 @@
  */
 
 #include "photomodel.h"
+#include "core/helpers/afc_avio_reader.h"
+#include "duplicateindex.h"
 #include "iDescriptor.h"
 #include "mediastreamermanager.h"
+#include "photolibraryindex.h"
 #include "servicemanager.h"
+#include "settingsmanager.h"
+#include "thumbnailcache.h"
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QEventLoop>
 #include <QIcon>
 #include <QImage>
 #include <QImageReader>
+#include <QMutexLocker>
 #include <QMediaPlayer>
 #include <QPixmap>
 #include <QRegularExpression>
@@ -34,6 +41,7 @@
 #include <QVideoFrame>
 #include <QVideoSink>
 #include <QtConcurrent/QtConcurrent>
+#include <queue>
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
@@ -45,13 +53,126 @@ extern "C" {
 // exhaustion
 QSemaphore PhotoModel::m_videoThumbnailSemaphore(4);
 
+// Population hands rows to the model in batches of this size, or whatever was
+// collected after the interval when files have to be stat'ed one by one
+static constexpr qsizetype POPULATE_BATCH_SIZE = 256;
+static constexpr qint64 POPULATE_BATCH_INTERVAL_MS = 100;
+
+// Thumbnails decoded at once, and requests remembered before the view has
+// reported its visible range
+static constexpr int MAX_THUMBNAIL_JOBS = 6;
+static constexpr qsizetype MAX_PENDING_THUMBNAILS = 256;
+
+// Video thumbnails stop probing after this much data and give up after this
+// many keyframes without a decoded picture
+static constexpr int64_t VIDEO_THUMBNAIL_PROBE_SIZE = 64 * 1024;
+static constexpr int VIDEO_THUMBNAIL_MAX_PACKETS = 16;
+
+/*
+ * Opened keyframe-only decoders kept for reuse. Opening an H.264/HEVC decoder
+ * costs more than decoding a single keyframe, and an album is mostly clips of
+ * the same codec and size, so contexts are keyed by codec, dimensions, lowres
+ * and extradata and handed back flushed after each thumbnail.
+ */
+class VideoDecoderPool
+{
+public:
+    static VideoDecoderPool *sharedInstance()
+    {
+        static VideoDecoderPool instance;
+        return &instance;
+    }
+
+    ~VideoDecoderPool()
+    {
+        for (PooledDecoder &decoder : m_idle)
+            avcodec_free_context(&decoder.context);
+    }
+
+    AVCodecContext *acquire(const AVCodecParameters *params,
+                            const QSize &targetSize, QByteArray &key)
+    {
+        const AVCodec *codec = avcodec_find_decoder(params->codec_id);
+        if (!codec)
+            return nullptr;
+
+        // Each lowres step halves the decoded size, stay above the target
+        int lowres = 0;
+        while (lowres < codec->max_lowres &&
+               (params->width >> (lowres + 1)) >= targetSize.width() &&
+               (params->height >> (lowres + 1)) >= targetSize.height()) {
+            lowres++;
+        }
+
+        key = QByteArray::number(params->codec_id) + ':' +
+              QByteArray::number(params->width) + 'x' +
+              QByteArray::number(params->height) + ':' +
+              QByteArray::number(lowres) + ':' +
+              QByteArray(reinterpret_cast<const char *>(params->extradata),
+                         params->extradata_size);
+
+        {
+            QMutexLocker locker(&m_mutex);
+            for (int i = 0; i < m_idle.size(); ++i) {
+                if (m_idle.at(i).key == key)
+                    return m_idle.takeAt(i).context;
+            }
+        }
+
+        AVCodecContext *context = avcodec_alloc_context3(codec);
+        if (!context)
+            return nullptr;
+        if (avcodec_parameters_to_context(context, params) < 0) {
+            avcodec_free_context(&context);
+            return nullptr;
+        }
+        context->lowres = lowres;
+        context->skip_frame = AVDISCARD_NONKEY;
+        context->flags2 |= AV_CODEC_FLAG2_FAST;
+        // Frame threading delays output by a frame per thread
+        context->thread_type = FF_THREAD_SLICE;
+        if (avcodec_open2(context, codec, nullptr) < 0) {
+            avcodec_free_context(&context);
+            return nullptr;
+        }
+        return context;
+    }
+
+    void release(const QByteArray &key, AVCodecContext *context)
+    {
+        avcodec_flush_buffers(context);
+
+        QMutexLocker locker(&m_mutex);
+        m_idle.append({key, context});
+        while (m_idle.size() > MAX_IDLE_DECODERS) {
+            AVCodecContext *oldest = m_idle.takeFirst().context;
+            avcodec_free_context(&oldest);
+        }
+    }
+
+private:
+    VideoDecoderPool() = default;
+
+    static constexpr int MAX_IDLE_DECODERS = 6;
+
+    struct PooledDecoder {
+        QByteArray key;
+        AVCodecContext *context;
+    };
+    QList<PooledDecoder> m_idle;
+    QMutex m_mutex;
+};
+
 PhotoModel::PhotoModel(iDescriptorDevice *device, FilterType filterType,
                        QObject *parent)
     : QAbstractListModel(parent), m_device(device), m_thumbnailSize(120, 120),
       m_sortOrder(NewestFirst), m_filterType(filterType)
 {
-    // 350 MB cache for thumbnails
-    m_thumbnailCache.setMaxCost(350 * 1024 * 1024);
+    // Thumbnails are kept as JPEG (~5 KB each at 120px), so the 350 MB
+    // budget holds every thumbnail of even very large libraries. Only what is
+    // on screen stays decoded.
+    m_encodedThumbnails.setMaxCost(350 * 1024 * 1024);
+    m_decodedThumbnails.setMaxCost(32 * 1024 * 1024);
 
     connect(this, &PhotoModel::thumbnailNeedsToBeLoaded, this,
             &PhotoModel::requestThumbnail, Qt::QueuedConnection);
@@ -59,6 +180,8 @@ PhotoModel::PhotoModel(iDescriptorDevice *device, FilterType filterType,
 
 void PhotoModel::clear()
 {
+    cancelPopulation();
+
     // Clean up any active watchers
     for (auto *watcher : m_activeLoaders.values()) {
         if (watcher) {
@@ -68,8 +191,13 @@ void PhotoModel::clear()
         }
     }
     m_activeLoaders.clear();
-    m_loadingPaths.clear();
-    m_thumbnailCache.clear();
+    m_pendingThumbnails.clear();
+    m_failedThumbnails.clear();
+    m_visibleFirst = m_visibleLast = -1;
+    m_encodedThumbnails.clear();
+    m_decodedThumbnails.clear();
+    m_hashes.clear();
+    m_hashScanNext = 0;
 }
 
 PhotoModel::~PhotoModel()
@@ -84,299 +212,154 @@ QPixmap PhotoModel::generateVideoThumbnailFFmpeg(iDescriptorDevice *device,
 {
     QPixmap thumbnail;
 
-    uint64_t fileHandle = 0;
-
-    afc_error_t openResult = ServiceManager::safeAfcFileOpen(
-        device, filePath.toUtf8().constData(), AFC_FOPEN_RDONLY, &fileHandle);
-
-    if (openResult != AFC_E_SUCCESS || fileHandle == 0) {
+    std::unique_ptr<AfcAvioReader> reader =
+        AfcAvioReader::open(device, filePath);
+    if (!reader) {
         qWarning() << "Failed to open video file for thumbnail:" << filePath;
         return {};
     }
 
-    // Get file size
-    char **fileInfo = nullptr;
-    afc_error_t infoResult = ServiceManager::safeAfcGetFileInfo(
-        device, filePath.toUtf8().constData(), &fileInfo);
-
-    uint64_t fileSize = 0;
-    if (infoResult == AFC_E_SUCCESS && fileInfo) {
-        for (int i = 0; fileInfo[i]; i += 2) {
-            if (strcmp(fileInfo[i], "st_size") == 0) {
-                fileSize = strtoull(fileInfo[i + 1], nullptr, 10);
-                break;
-            }
-        }
-        afc_dictionary_free(fileInfo);
-    }
-
-    if (fileSize == 0) {
-        ServiceManager::safeAfcFileClose(device, fileHandle);
-        qWarning() << "Invalid video file size for thumbnail:" << filePath;
-        return {};
-    }
-
-    // Create custom AVIOContext for reading from device on-demand
     AVFormatContext *formatCtx = avformat_alloc_context();
     if (!formatCtx) {
-        ServiceManager::safeAfcFileClose(device, fileHandle);
         qWarning() << "Failed to allocate format context";
         return {};
     }
 
-    // Context for streaming read from device
-    struct StreamContext {
-        iDescriptorDevice *device;
-        uint64_t fileHandle;
-        uint64_t fileSize;
-        uint64_t currentPos;
-    };
-
-    StreamContext *streamCtx =
-        new StreamContext{device, fileHandle, fileSize, 0};
-
-    // Custom read function that reads from device on-demand
-    auto readPacket = [](void *opaque, uint8_t *buf, int bufSize) -> int {
-        StreamContext *ctx = static_cast<StreamContext *>(opaque);
-
-        if (ctx->currentPos >= ctx->fileSize) {
-            return AVERROR_EOF;
-        }
-
-        uint32_t toRead =
-            std::min(static_cast<uint32_t>(bufSize),
-                     static_cast<uint32_t>(ctx->fileSize - ctx->currentPos));
-        uint32_t bytesRead = 0;
-
-        afc_error_t result = ServiceManager::safeAfcFileRead(
-            ctx->device, ctx->fileHandle, reinterpret_cast<char *>(buf), toRead,
-            &bytesRead);
-
-        if (result != AFC_E_SUCCESS || bytesRead == 0) {
-            return AVERROR(EIO);
-        }
-
-        ctx->currentPos += bytesRead;
-        return static_cast<int>(bytesRead);
-    };
-
-    // Custom seek function using AFC seek
-    auto seekPacket = [](void *opaque, int64_t offset, int whence) -> int64_t {
-        StreamContext *ctx = static_cast<StreamContext *>(opaque);
-
-        if (whence == AVSEEK_SIZE) {
-            return static_cast<int64_t>(ctx->fileSize);
-        }
-
-        int64_t newPos = 0;
-        int seekWhence = SEEK_SET;
-
-        if (whence == SEEK_SET) {
-            newPos = offset;
-            seekWhence = SEEK_SET;
-        } else if (whence == SEEK_CUR) {
-            newPos = static_cast<int64_t>(ctx->currentPos) + offset;
-            seekWhence = SEEK_SET;
-        } else if (whence == SEEK_END) {
-            newPos = static_cast<int64_t>(ctx->fileSize) + offset;
-            seekWhence = SEEK_SET;
-        } else {
-            return -1;
-        }
-
-        if (newPos < 0 || newPos > static_cast<int64_t>(ctx->fileSize)) {
-            return -1;
-        }
+    AVCodecContext *codecCtx = nullptr;
+    QByteArray decoderKey;
+    AVFrame *frame = nullptr;
+    AVPacket *packet = nullptr;
 
-        // Use AFC seek
-        afc_error_t result = ServiceManager::safeAfcFileSeek(
-            ctx->device, ctx->fileHandle, newPos, seekWhence);
-
-        if (result != AFC_E_SUCCESS) {
-            return -1;
-        }
-
-        ctx->currentPos = static_cast<uint64_t>(newPos);
-        return newPos;
+    // Every exit below goes through here
+    auto cleanup = [&]() {
+        if (frame)
+            av_frame_free(&frame);
+        if (packet)
+            av_packet_free(&packet);
+        if (codecCtx)
+            VideoDecoderPool::sharedInstance()->release(decoderKey, codecCtx);
+        if (formatCtx)
+            avformat_close_input(&formatCtx);
     };
 
-    const int avioBufferSize = 32768; // 32KB buffer for streaming
-    unsigned char *avioBuffer =
-        static_cast<unsigned char *>(av_malloc(avioBufferSize));
-    if (!avioBuffer) {
-        delete streamCtx;
-        ServiceManager::safeAfcFileClose(device, fileHandle);
-        avformat_free_context(formatCtx);
-        return {};
-    }
-
-    AVIOContext *avioCtx =
-        avio_alloc_context(avioBuffer, avioBufferSize, 0, streamCtx, readPacket,
-                           nullptr, seekPacket);
-
-    if (!avioCtx) {
-        av_free(avioBuffer);
-        delete streamCtx;
-        ServiceManager::safeAfcFileClose(device, fileHandle);
-        avformat_free_context(formatCtx);
-        return {};
-    }
-
-    formatCtx->pb = avioCtx;
+    formatCtx->pb = reader->context();
     formatCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+    // Container headers are all we need, keep probing to a single read.
+    // max_analyze_duration 0 would mean FFmpeg's default of several seconds.
+    formatCtx->probesize = VIDEO_THUMBNAIL_PROBE_SIZE;
+    formatCtx->max_analyze_duration = AV_TIME_BASE / 2;
 
-    // Open input
+    // Open input, on failure avformat_open_input frees the context itself
     if (avformat_open_input(&formatCtx, nullptr, nullptr, nullptr) < 0) {
         qWarning() << "Failed to open video format";
-        av_free(avioCtx->buffer);
-        avio_context_free(&avioCtx);
-        avformat_free_context(formatCtx);
-        return {};
-    }
-
-    // Find stream info
-    if (avformat_find_stream_info(formatCtx, nullptr) < 0) {
-        qWarning() << "Failed to find stream info";
-        avformat_close_input(&formatCtx);
-        av_free(avioCtx->buffer);
-        avio_context_free(&avioCtx);
+        formatCtx = nullptr;
+        cleanup();
         return {};
     }
 
-    // Find video stream
-    int videoStreamIndex = -1;
-    const AVCodec *codec = nullptr;
-    AVCodecParameters *codecParams = nullptr;
-
-    for (unsigned int i = 0; i < formatCtx->nb_streams; i++) {
-        if (formatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-            videoStreamIndex = i;
-            codecParams = formatCtx->streams[i]->codecpar;
-            codec = avcodec_find_decoder(codecParams->codec_id);
-            break;
+    int videoStreamIndex =
+        av_find_best_stream(formatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+
+    // MOV/MP4 headers carry the codec parameters, only fall back to decoding
+    // frames (avformat_find_stream_info) when they do not
+    if (videoStreamIndex < 0 ||
+        formatCtx->streams[videoStreamIndex]->codecpar->width <= 0) {
+        if (avformat_find_stream_info(formatCtx, nullptr) < 0) {
+            qWarning() << "Failed to find stream info";
+            cleanup();
+            return {};
         }
+        videoStreamIndex = av_find_best_stream(formatCtx, AVMEDIA_TYPE_VIDEO,
+                                               -1, -1, nullptr, 0);
     }
 
-    if (videoStreamIndex == -1 || !codec) {
+    if (videoStreamIndex < 0) {
         qWarning() << "No video stream found";
-        avformat_close_input(&formatCtx);
-        av_free(avioCtx->buffer);
-        avio_context_free(&avioCtx);
+        cleanup();
         return {};
     }
 
-    // Allocate codec context
-    AVCodecContext *codecCtx = avcodec_alloc_context3(codec);
-    if (!codecCtx) {
-        avformat_close_input(&formatCtx);
-        av_free(avioCtx->buffer);
-        avio_context_free(&avioCtx);
-        return {};
+    AVStream *videoStream = formatCtx->streams[videoStreamIndex];
+    for (unsigned int i = 0; i < formatCtx->nb_streams; i++) {
+        if (static_cast<int>(i) != videoStreamIndex)
+            formatCtx->streams[i]->discard = AVDISCARD_ALL;
     }
 
-    if (avcodec_parameters_to_context(codecCtx, codecParams) < 0) {
-        avcodec_free_context(&codecCtx);
-        avformat_close_input(&formatCtx);
-        av_free(avioCtx->buffer);
-        avio_context_free(&avioCtx);
+    codecCtx = VideoDecoderPool::sharedInstance()->acquire(
+        videoStream->codecpar, requestedSize, decoderKey);
+    frame = av_frame_alloc();
+    packet = av_packet_alloc();
+    if (!codecCtx || !frame || !packet) {
+        cleanup();
         return {};
     }
 
-    // Open codec
-    if (avcodec_open2(codecCtx, codec, nullptr) < 0) {
-        avcodec_free_context(&codecCtx);
-        avformat_close_input(&formatCtx);
-        av_free(avioCtx->buffer);
-        avio_context_free(&avioCtx);
-        return {};
+    // Jump to the keyframe at or before the configured offset, clamped for
+    // clips shorter than that
+    int64_t offsetMs = static_cast<int64_t>(
+                           SettingsManager::sharedInstance()
+                               ->videoThumbnailOffset()) *
+                       1000;
+    if (formatCtx->duration > 0) {
+        offsetMs =
+            std::min(offsetMs, formatCtx->duration / (2 * AV_TIME_BASE / 1000));
     }
-
-    // Allocate frame
-    AVFrame *frame = av_frame_alloc();
-    AVPacket *packet = av_packet_alloc();
-
-    if (!frame || !packet) {
-        if (frame)
-            av_frame_free(&frame);
-        if (packet)
-            av_packet_free(&packet);
-        avcodec_free_context(&codecCtx);
-        avformat_close_input(&formatCtx);
-        av_free(avioCtx->buffer);
-        avio_context_free(&avioCtx);
-        return {};
+    if (offsetMs > 0) {
+        const int64_t target = av_rescale_q(offsetMs, AVRational{1, 1000},
+                                            videoStream->time_base);
+        if (av_seek_frame(formatCtx, videoStreamIndex, target,
+                          AVSEEK_FLAG_BACKWARD) < 0) {
+            av_seek_frame(formatCtx, videoStreamIndex, 0,
+                          AVSEEK_FLAG_BACKWARD);
+        }
     }
 
-    // Read frames until we get a valid one
+    // Only keyframes are decoded, so the first frame out is the one we want
     bool frameDecoded = false;
-    while (av_read_frame(formatCtx, packet) >= 0) {
-        if (packet->stream_index == videoStreamIndex) {
-            if (avcodec_send_packet(codecCtx, packet) >= 0) {
-                if (avcodec_receive_frame(codecCtx, frame) >= 0) {
-                    frameDecoded = true;
-                    av_packet_unref(packet);
-                    break;
-                }
+    int packetsRead = 0;
+    while (!frameDecoded && packetsRead < VIDEO_THUMBNAIL_MAX_PACKETS &&
+           av_read_frame(formatCtx, packet) >= 0) {
+        if (packet->stream_index == videoStreamIndex &&
+            (packet->flags & AV_PKT_FLAG_KEY)) {
+            packetsRead++;
+            if (avcodec_send_packet(codecCtx, packet) >= 0 &&
+                avcodec_receive_frame(codecCtx, frame) >= 0) {
+                frameDecoded = true;
             }
         }
         av_packet_unref(packet);
     }
+    if (!frameDecoded) {
+        // Decoders with delay hold the frame until they are drained
+        avcodec_send_packet(codecCtx, nullptr);
+        frameDecoded = avcodec_receive_frame(codecCtx, frame) >= 0;
+    }
 
     if (frameDecoded) {
-        // Convert frame to RGB24
-        SwsContext *swsCtx =
-            sws_getContext(frame->width, frame->height,
-                           static_cast<AVPixelFormat>(frame->format),
-                           frame->width, frame->height, AV_PIX_FMT_RGB24,
-                           SWS_BILINEAR, nullptr, nullptr, nullptr);
+        // Scale and convert in one pass, straight into the image we return
+        const QSize targetSize =
+            QSize(frame->width, frame->height)
+                .scaled(requestedSize, Qt::KeepAspectRatio)
+                .boundedTo(QSize(frame->width, frame->height));
+        SwsContext *swsCtx = sws_getContext(
+            frame->width, frame->height,
+            static_cast<AVPixelFormat>(frame->format), targetSize.width(),
+            targetSize.height(), AV_PIX_FMT_RGB24, SWS_BILINEAR, nullptr,
+            nullptr, nullptr);
 
         if (swsCtx) {
-            AVFrame *rgbFrame = av_frame_alloc();
-            if (rgbFrame) {
-                rgbFrame->format = AV_PIX_FMT_RGB24;
-                rgbFrame->width = frame->width;
-                rgbFrame->height = frame->height;
-
-                if (av_frame_get_buffer(rgbFrame, 0) >= 0) {
-                    sws_scale(swsCtx, frame->data, frame->linesize, 0,
-                              frame->height, rgbFrame->data,
-                              rgbFrame->linesize);
-
-                    // Convert to QImage
-                    QImage img(rgbFrame->data[0], rgbFrame->width,
-                               rgbFrame->height, rgbFrame->linesize[0],
-                               QImage::Format_RGB888);
-
-                    // Create a deep copy since AVFrame will be freed
-                    QImage imgCopy = img.copy();
-
-                    // Scale to requested size
-                    thumbnail = QPixmap::fromImage(
-                        imgCopy.scaled(requestedSize, Qt::KeepAspectRatio,
-                                       Qt::SmoothTransformation));
-                }
-
-                av_frame_free(&rgbFrame);
-            }
-
+            QImage image(targetSize, QImage::Format_RGB888);
+            uint8_t *dstData[4] = {image.bits(), nullptr, nullptr, nullptr};
+            int dstLinesize[4] = {static_cast<int>(image.bytesPerLine()), 0, 0,
+                                  0};
+            sws_scale(swsCtx, frame->data, frame->linesize, 0, frame->height,
+                      dstData, dstLinesize);
             sws_freeContext(swsCtx);
+            thumbnail = QPixmap::fromImage(std::move(image));
         }
     }
 
-    // Cleanup
-    av_frame_free(&frame);
-    av_packet_free(&packet);
-    avcodec_free_context(&codecCtx);
-    avformat_close_input(&formatCtx);
-
-    // Close the AFC file handle
-    ServiceManager::safeAfcFileClose(device, fileHandle);
-
-    // Free AVIO context and stream context
-    av_free(avioCtx->buffer);
-    avio_context_free(&avioCtx);
-    delete streamCtx;
-
+    cleanup();
     return thumbnail;
 }
 
@@ -404,14 +387,13 @@ QVariant PhotoModel::data(const QModelIndex &index, int role) const
         qDebug() << "DecorationRole requested for index:" << index.row();
 
         // Check memory cache first
-        if (QPixmap *cached = m_thumbnailCache.object(info.filePath)) {
+        if (const QPixmap *cached = thumbnailPixmap(info.id)) {
             qDebug() << "Cache HIT for:" << info.fileName;
             return QIcon(*cached);
         }
 
         // Prevent duplicate requests
-        if (m_loadingPaths.contains(info.filePath) ||
-            m_activeLoaders.contains(info.filePath)) {
+        if (m_activeLoaders.contains(info.id)) {
             qDebug() << "Already loading:" << info.fileName;
             // Return appropriate placeholder based on file type
             if (info.fileName.endsWith(".MOV", Qt::CaseInsensitive) ||
@@ -425,10 +407,10 @@ QVariant PhotoModel::data(const QModelIndex &index, int role) const
         }
 
         // Start async loading for both images and videos
-        if (!m_loadingPaths.contains(info.filePath)) {
+        if (needsThumbnail(info.id)) {
             qDebug() << "Starting load for:" << info.fileName;
             emit const_cast<PhotoModel *>(this)->thumbnailNeedsToBeLoaded(
-                index.row());
+                info.id);
         }
 
         // Return placeholder while loading
@@ -451,56 +433,222 @@ QVariant PhotoModel::data(const QModelIndex &index, int role) const
     }
 }
 
-void PhotoModel::requestThumbnail(int index)
+void PhotoModel::requestThumbnail(int id)
+{
+    // Rows move while the album is being populated, so requests carry the
+    // photo id rather than the row
+    if (id < 0 || id >= m_allPhotos.size())
+        return;
+    m_allPhotos[id].thumbnailRequested = true;
+
+    // Once the view reports what it shows, the visible range drives loading
+    // and individual requests only kick the scheduler
+    if (m_visibleFirst < 0 && !m_activeLoaders.contains(id)) {
+        m_pendingThumbnails.removeOne(id);
+        m_pendingThumbnails.append(id);
+        if (m_pendingThumbnails.size() > MAX_PENDING_THUMBNAILS)
+            m_pendingThumbnails.removeFirst();
+    }
+    scheduleThumbnails();
+}
+
+void PhotoModel::setVisibleRange(int first, int last)
 {
-    if (index < 0 || index >= m_photos.size())
+    if (first > last || first < 0) {
+        m_visibleFirst = m_visibleLast = -1;
+        return;
+    }
+    if (first == m_visibleFirst && last == m_visibleLast)
         return;
 
-    PhotoInfo &info = m_photos[index];
-    info.thumbnailRequested = true;
+    if (m_visibleFirst >= 0 && first != m_visibleFirst)
+        m_scrollingDown = first > m_visibleFirst;
+    m_visibleFirst = first;
+    m_visibleLast = last;
 
-    if (m_loadingPaths.contains(info.filePath))
+    // Whatever was queued for rows that scrolled away is stale now
+    m_pendingThumbnails.clear();
+    scheduleThumbnails();
+}
+
+bool PhotoModel::needsThumbnail(int id) const
+{
+    return !m_encodedThumbnails.contains(id) &&
+           !m_activeLoaders.contains(id) && !m_failedThumbnails.contains(id);
+}
+
+// Decodes the stored JPEG on first draw, decoded pixmaps live in a small
+// cache of their own that only has to cover a few screens
+const QPixmap *PhotoModel::thumbnailPixmap(int id) const
+{
+    if (const QPixmap *pixmap = m_decodedThumbnails.object(id))
+        return pixmap;
+
+    const QByteArray *encoded = m_encodedThumbnails.object(id);
+    if (!encoded)
+        return nullptr;
+
+    auto *pixmap = new QPixmap();
+    if (!pixmap->loadFromData(*encoded, "JPG")) {
+        delete pixmap;
+        return nullptr;
+    }
+    const int cost = pixmap->width() * pixmap->height() * 4;
+    if (!m_decodedThumbnails.insert(id, pixmap, cost))
+        return nullptr;
+    return pixmap;
+}
+
+QImage PhotoModel::cachedThumbnail(const QString &filePath) const
+{
+    const int id = m_idByPath.value(filePath, -1);
+    if (id < 0)
+        return {};
+    if (const QPixmap *pixmap = thumbnailPixmap(id))
+        return pixmap->toImage();
+
+    // Files populated from the Photos library have no stat to key on yet,
+    // and video keys also depend on a setting, see statThumbnailKey
+    const PhotoInfo &info = m_allPhotos.at(id);
+    if (info.fileType == PhotoInfo::Video || !info.fileSize ||
+        !info.modifiedTime)
+        return {};
+    const ThumbnailKey key{info.filePath, info.fileSize, info.modifiedTime,
+                           m_thumbnailSize};
+    return ThumbnailCache::sharedInstance()->lookup(
+        QString::fromStdString(m_device->udid), info.albumPath, key);
+}
+
+int PhotoModel::rowForId(int id) const
+{
+    if (m_rowIndexDirty) {
+        m_rowById.fill(-1, m_allPhotos.size());
+        for (int row = 0; row < m_photos.size(); ++row)
+            m_rowById[m_photos.at(row).id] = row;
+        m_rowIndexDirty = false;
+    }
+    return id >= 0 && id < m_rowById.size() ? m_rowById.at(id) : -1;
+}
+
+void PhotoModel::scheduleThumbnails()
+{
+    if (m_visibleFirst < 0) {
+        // No viewport known yet, newest request first
+        while (m_activeLoaders.size() < MAX_THUMBNAIL_JOBS &&
+               !m_pendingThumbnails.isEmpty()) {
+            const int id = m_pendingThumbnails.takeLast();
+            if (needsThumbnail(id))
+                startThumbnailJob(id);
+        }
+    } else {
+        // Visible rows first, then one screen ahead in the scroll direction
+        const int rowCount = m_photos.size();
+        const int span = m_visibleLast - m_visibleFirst + 1;
+
+        auto startRange = [&](int from, int to, int step) {
+            for (int row = from; row != to + step; row += step) {
+                if (m_activeLoaders.size() >= MAX_THUMBNAIL_JOBS)
+                    return;
+                if (row < 0 || row >= rowCount)
+                    continue;
+                const int id = m_photos.at(row).id;
+                if (needsThumbnail(id))
+                    startThumbnailJob(id);
+            }
+        };
+        startRange(m_visibleFirst, m_visibleLast, 1);
+        if (m_scrollingDown)
+            startRange(m_visibleLast + 1, m_visibleLast + span, 1);
+        else
+            startRange(m_visibleFirst - 1, m_visibleFirst - span, -1);
+    }
+
+    // Slots the view leaves free hash the rest of the album, the thumbnails
+    // this produces end up in the caches like any other
+    if (!duplicateScanActive())
         return;
+    while (m_activeLoaders.size() < MAX_THUMBNAIL_JOBS &&
+           m_hashScanNext < m_allPhotos.size()) {
+        const int id = m_hashScanNext++;
+        // Only stills are compared, see onPhotoHashed
+        if (m_allPhotos.at(id).fileType == PhotoInfo::Video)
+            continue;
+        if (!m_hashes.contains(id) && !m_activeLoaders.contains(id) &&
+            !m_failedThumbnails.contains(id))
+            startThumbnailJob(id);
+    }
+}
+
+void PhotoModel::startThumbnailJob(int id)
+{
+    if (id < 0 || id >= m_allPhotos.size())
+        return;
+
+    const PhotoInfo &info = m_allPhotos.at(id);
 
-    m_loadingPaths.insert(info.filePath);
-
-    auto *watcher = new QFutureWatcher<QPixmap>();
-    m_activeLoaders[info.filePath] = watcher;
-
-    connect(watcher, &QFutureWatcher<QPixmap>::finished, this,
-            [this, watcher, filePath = info.filePath]() {
-                qDebug() << "Thumbnail load finished for:" << filePath;
-                QPixmap thumbnail = watcher->result();
-
-                m_loadingPaths.remove(filePath);
-                m_activeLoaders.remove(filePath);
-                if (!thumbnail.isNull()) {
-                    int cost = thumbnail.width() * thumbnail.height() * 4;
-                    m_thumbnailCache.insert(filePath, new QPixmap(thumbnail),
-                                            cost);
-
-                    for (int i = 0; i < m_photos.size(); ++i) {
-                        if (m_photos[i].filePath == filePath) {
-                            QModelIndex idx = createIndex(i, 0);
-                            emit dataChanged(idx, idx, {Qt::DecorationRole});
-                            break;
-                        }
+    auto *watcher = new QFutureWatcher<ThumbnailResult>();
+    m_activeLoaders[id] = watcher;
+
+    connect(watcher, &QFutureWatcher<ThumbnailResult>::finished, this,
+            [this, watcher, id, fileName = info.fileName]() {
+                // Loaders abandoned by clear() are already gone from the map
+                if (m_activeLoaders.value(id) != watcher) {
+                    watcher->deleteLater();
+                    return;
+                }
+                qDebug() << "Thumbnail load finished for:" << fileName;
+                ThumbnailResult result = watcher->result();
+                QByteArray encoded = std::move(result.encoded);
+
+                m_activeLoaders.remove(id);
+                if (result.hash)
+                    onPhotoHashed(id, *result.hash);
+                if (!encoded.isEmpty()) {
+                    const int cost = encoded.size();
+                    m_encodedThumbnails.insert(
+                        id, new QByteArray(std::move(encoded)), cost);
+
+                    const int row = rowForId(id);
+                    if (row >= 0) {
+                        QModelIndex idx = createIndex(row, 0);
+                        emit dataChanged(idx, idx, {Qt::DecorationRole});
                     }
                 } else {
-                    qDebug() << "Failed to load thumbnail for:"
-                             << QFileInfo(filePath).fileName();
+                    qDebug() << "Failed to load thumbnail for:" << fileName;
+                    m_failedThumbnails.insert(id);
                 }
 
                 watcher->deleteLater();
+                scheduleThumbnails();
             });
 
     bool isVideo = info.fileName.endsWith(".MOV", Qt::CaseInsensitive) ||
                    info.fileName.endsWith(".MP4", Qt::CaseInsensitive) ||
                    info.fileName.endsWith(".M4V", Qt::CaseInsensitive);
 
-    QFuture<QPixmap> future;
+    // Workers consult the on-disk store before going to the device
+    const QString udid = QString::fromStdString(m_device->udid);
+    const QString albumPath = info.albumPath;
+
+    // Workers hand back the JPEG bytes, which is also what the memory pool
+    // and the disk cache keep, so a thumbnail is encoded exactly once. For
+    // photos the dHash is taken from the same decoded image and cached
+    // alongside.
+    QFuture<ThumbnailResult> future;
     if (isVideo) {
-        future = QtConcurrent::run([this, info]() {
+        future = QtConcurrent::run([this, info, udid, albumPath]() {
+            ThumbnailKey key;
+            const bool cacheable =
+                statThumbnailKey(m_device, info, m_thumbnailSize, key);
+            if (cacheable) {
+                ThumbnailResult cached;
+                cached.encoded =
+                    ThumbnailCache::sharedInstance()->lookupEncoded(
+                        udid, albumPath, key, &cached.hash);
+                if (!cached.encoded.isEmpty())
+                    return cached;
+            }
+
             // Acquire semaphore FIRST to limit concurrent video processing
             qDebug() << "Waiting for semaphore for:" << info.fileName;
             m_videoThumbnailSemaphore.acquire();
@@ -513,23 +661,82 @@ void PhotoModel::requestThumbnail(int index)
             // Release semaphore
             qDebug() << "Releasing semaphore for:" << info.fileName;
             m_videoThumbnailSemaphore.release();
-            return thumbnail;
+
+            ThumbnailResult result;
+            result.encoded = ThumbnailCache::encode(thumbnail.toImage());
+            if (cacheable)
+                ThumbnailCache::sharedInstance()->storeEncoded(
+                    udid, albumPath, key, result.encoded, result.hash);
+            return result;
         });
     } else {
-        future = QtConcurrent::run([info, this]() {
-            return loadThumbnailFromDevice(m_device, info.filePath,
-                                           m_thumbnailSize);
+        future = QtConcurrent::run([info, this, udid, albumPath]() {
+            ThumbnailKey key;
+            const bool cacheable =
+                statThumbnailKey(m_device, info, m_thumbnailSize, key);
+            if (cacheable) {
+                ThumbnailResult cached;
+                cached.encoded =
+                    ThumbnailCache::sharedInstance()->lookupEncoded(
+                        udid, albumPath, key, &cached.hash);
+                if (!cached.encoded.isEmpty())
+                    return cached;
+            }
+
+            QPixmap thumbnail =
+                loadThumbnailFromDevice(m_device, info.filePath,
+                                        m_thumbnailSize, key.fileSize);
+            const QImage image = thumbnail.toImage();
+            ThumbnailResult result;
+            result.encoded = ThumbnailCache::encode(image);
+            if (!image.isNull())
+                result.hash = DuplicateIndex::perceptualHash(image);
+            if (cacheable)
+                ThumbnailCache::sharedInstance()->storeEncoded(
+                    udid, albumPath, key, result.encoded, result.hash);
+            return result;
         });
     }
 
     watcher->setFuture(future);
 }
 
+// The pack is keyed on the AFC stat however the album was populated, so a
+// thumbnail survives sessions with and without the Photos library. Files
+// that cannot be stat'ed are not cached, there is no telling when they
+// change. Video thumbnails also depend on the frame position setting.
+bool PhotoModel::statThumbnailKey(iDescriptorDevice *device,
+                                  const PhotoInfo &info, const QSize &size,
+                                  ThumbnailKey &key)
+{
+    key = {info.filePath, info.fileSize, info.modifiedTime, size};
+    if (info.fileType == PhotoInfo::Video) {
+        key.variant = QString("t%1").arg(
+            SettingsManager::sharedInstance()->videoThumbnailOffset());
+    }
+    if (!key.mtime) {
+        key.fileSize = 0;
+        extractDateTimeFromFile(device, info.filePath, &key.fileSize,
+                                &key.mtime);
+    }
+    return key.fileSize != 0 && key.mtime != 0;
+}
+
 // Static function that runs in worker thread
 QPixmap PhotoModel::loadThumbnailFromDevice(iDescriptorDevice *device,
                                             const QString &filePath,
-                                            const QSize &size)
+                                            const QSize &size,
+                                            quint64 fileSize)
 {
+    // Camera JPEG/HEIC files carry a small preview near the start of the
+    // file, reading just that is a few KB instead of the whole image
+    QImage embedded = load_embedded_thumbnail(
+        device, filePath.toUtf8().constData(), fileSize, size);
+    if (!embedded.isNull()) {
+        return QPixmap::fromImage(
+            embedded.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation));
+    }
+
     // Load from device using ServiceManager
     QByteArray imageData = ServiceManager::safeReadAfcFileToByteArray(
         device, filePath.toUtf8().constData());
@@ -541,10 +748,8 @@ QPixmap PhotoModel::loadThumbnailFromDevice(iDescriptorDevice *device,
 
     if (filePath.endsWith(".HEIC", Qt::CaseInsensitive)) {
         qDebug() << "Loading HEIC image from data for:" << filePath;
-        QPixmap img = load_heic(imageData);
-        return img.isNull() ? QPixmap()
-                            : img.scaled(size, Qt::KeepAspectRatio,
-                                         Qt::SmoothTransformation);
+        QImage img = load_heic(imageData, size);
+        return img.isNull() ? QPixmap() : QPixmap::fromImage(std::move(img));
     }
 
     // Use QImageReader for efficient, low-memory scaled loading
@@ -552,6 +757,8 @@ QPixmap PhotoModel::loadThumbnailFromDevice(iDescriptorDevice *device,
     buffer.open(QIODevice::ReadOnly);
 
     QImageReader reader(&buffer);
+    // match the orientation of the embedded EXIF thumbnails
+    reader.setAutoTransform(true);
     if (reader.canRead()) {
         // This is the key optimization: it decodes a smaller image directly,
         // saving a massive amount of memory.
@@ -588,8 +795,8 @@ QPixmap PhotoModel::loadImage(iDescriptorDevice *device,
 
     if (filePath.endsWith(".HEIC")) {
         qDebug() << "Loading HEIC image from data for:" << filePath;
-        QPixmap img = load_heic(imageData);
-        return img.isNull() ? QPixmap() : img;
+        QImage img = load_heic(imageData);
+        return img.isNull() ? QPixmap() : QPixmap::fromImage(std::move(img));
     }
 
     QPixmap original;
@@ -603,46 +810,128 @@ QPixmap PhotoModel::loadImage(iDescriptorDevice *device,
 
 void PhotoModel::populatePhotoPaths()
 {
-    // TODO:beginResetModel called on PhotoModel(0x600002d12a40) without calling
-    // endResetModel first
-    if (m_albumPath.isEmpty()) {
+    if (m_albumPaths.isEmpty()) {
         qDebug() << "No album path set, skipping population";
         return;
     }
 
+    // Rows of the previous album go away at once, the new ones are streamed
+    // in by the worker below
+    // Photo ids restart with the new listing, so drop loaders and thumbnails
+    // that belong to the old ones
+    clear();
+    beginResetModel();
     m_allPhotos.clear();
+    m_photos.clear();
+    m_idByPath.clear();
+    m_rowIndexDirty = true;
+    endResetModel();
+
+    auto job = std::make_shared<PopulateJob>();
+    job->model = this;
+    job->runningAlbums = m_albumPaths.size();
+    m_populateJob = job;
+    m_populated = false;
 
-    QByteArray albumPathBytes = m_albumPath.toUtf8();
-    const char *albumPathCStr = albumPathBytes.constData();
+    iDescriptorDevice *device = m_device;
+    for (const QString &albumPath : m_albumPaths) {
+        QtConcurrent::run([job, device, albumPath]() {
+            runPopulation(job, device, albumPath);
+        });
+    }
+}
+
+void PhotoModel::flushPopulation(const std::shared_ptr<PopulateJob> &job)
+{
+    if (m_populateJob != job)
+        return;
+
+    QList<QList<PhotoInfo>> batches;
+    QList<QList<PhotoInfo>> updates;
+    bool finished;
+    {
+        QMutexLocker locker(&job->mutex);
+        batches.swap(job->inbox);
+        updates.swap(job->updates);
+        job->flushPosted = false;
+        finished = job->runningAlbums == 0;
+    }
+
+    appendPhotos(std::move(batches));
+    updatePhotos(std::move(updates));
+    if (finished) {
+        m_populateJob.reset();
+        m_populated = true;
+        qDebug() << "Loaded" << m_allPhotos.size()
+                 << "media files from device," << m_photos.size() << "shown";
+    }
+}
+
+void PhotoModel::cancelPopulation()
+{
+    if (!m_populateJob)
+        return;
+
+    {
+        QMutexLocker locker(&m_populateJob->mutex);
+        m_populateJob->model = nullptr;
+        m_populateJob->cancelled = true;
+    }
+    m_populateJob.reset();
+}
 
+// Runs in a worker thread, hands batches to the model through its event loop
+void PhotoModel::runPopulation(std::shared_ptr<PopulateJob> job,
+                               iDescriptorDevice *device,
+                               const QString &albumPath)
+{
+    // The model may be destroyed at any time, so only post while holding the
+    // job lock and let the posted call check it is still the current job.
+    // One flush is posted at a time, it picks up the batches of every album
+    // that arrived meanwhile.
+    auto deliver = [&job](QList<PhotoInfo> batch, bool finished,
+                          bool update = false) {
+        QMutexLocker locker(&job->mutex);
+        PhotoModel *model = job->model;
+        if (!model)
+            return;
+        if (!batch.isEmpty())
+            (update ? job->updates : job->inbox).append(std::move(batch));
+        if (finished)
+            --job->runningAlbums;
+        if (job->flushPosted)
+            return;
+        job->flushPosted = true;
+        QMetaObject::invokeMethod(
+            model, [model, job]() { model->flushPopulation(job); },
+            Qt::QueuedConnection);
+    };
+
+    const QByteArray albumPathBytes = albumPath.toUtf8();
     char **albumInfo = nullptr;
-    afc_error_t infoResult =
-        ServiceManager::safeAfcGetFileInfo(m_device, albumPathCStr, &albumInfo);
+    afc_error_t infoResult = ServiceManager::safeAfcGetFileInfo(
+        device, albumPathBytes.constData(), &albumInfo);
     if (infoResult != AFC_E_SUCCESS) {
         qDebug() << "Album path does not exist or cannot be accessed:"
-                 << m_albumPath << "Error:" << infoResult;
+                 << albumPath << "Error:" << infoResult;
+        deliver({}, true);
         return;
     }
     if (albumInfo) {
         afc_dictionary_free(albumInfo);
     }
 
-    // Fix: Store the QByteArray to keep the C string valid
-    QByteArray photoDirBytes = m_albumPath.toUtf8();
-    const char *photoDir = photoDirBytes.constData();
-    qDebug() << "Photo directory:" << m_albumPath;
-    qDebug() << "Photo directory C string:" << photoDir;
-
-    // Use ServiceManager for thread-safe AFC operations
     char **files = nullptr;
-    afc_error_t readResult =
-        ServiceManager::safeAfcReadDirectory(m_device, photoDir, &files);
+    afc_error_t readResult = ServiceManager::safeAfcReadDirectory(
+        device, albumPathBytes.constData(), &files);
     if (readResult != AFC_E_SUCCESS) {
-        qDebug() << "Failed to read photo directory:" << photoDir
+        qDebug() << "Failed to read photo directory:" << albumPath
                  << "Error:" << readResult;
+        deliver({}, true);
         return;
     }
 
+    QStringList fileNames;
     if (files) {
         for (int i = 0; files[i]; i++) {
             QString fileName = QString::fromUtf8(files[i]);
@@ -652,25 +941,211 @@ void PhotoModel::populatePhotoPaths()
                 fileName.endsWith(".MOV", Qt::CaseInsensitive) ||
                 fileName.endsWith(".MP4", Qt::CaseInsensitive) ||
                 fileName.endsWith(".M4V", Qt::CaseInsensitive)) {
-
-                PhotoInfo info;
-                info.filePath = m_albumPath + "/" + fileName;
-                info.fileName = fileName;
-                info.thumbnailRequested = false;
-                info.fileType = determineFileType(fileName);
-                info.dateTime = extractDateTimeFromFile(info.filePath);
-
-                m_allPhotos.append(info);
+                fileNames.append(fileName);
             }
         }
         afc_dictionary_free(files);
     }
 
-    // Apply initial filtering and sorting, which will also reset the model
-    applyFilterAndSort();
+    // Rows go out right away with what the last local copy of the Photos
+    // library knows about them. Only if it misses some is the copy refreshed,
+    // their dates and sizes follow as updates.
+    auto applyAsset = [](PhotoInfo &info, const PhotoLibraryAsset &asset) {
+        info.dateTime = asset.dateTime;
+        info.dimensions = asset.dimensions;
+        info.fileSize = asset.fileSize;
+    };
+    PhotoLibraryIndex *index = PhotoLibraryIndex::sharedInstance();
+    const QHash<QString, PhotoLibraryAsset> cached = index->cachedAlbumAssets(
+        QString::fromStdString(device->udid), albumPath);
+
+    QList<PhotoInfo> rows;
+    QList<PhotoInfo> pending;
+    rows.reserve(fileNames.size());
+    for (const QString &fileName : fileNames) {
+        PhotoInfo info;
+        info.filePath = albumPath + "/" + fileName;
+        info.fileName = fileName;
+        info.albumPath = albumPath;
+        info.thumbnailRequested = false;
+        info.fileType = determineFileType(fileName);
+
+        auto asset = cached.constFind(fileName);
+        if (asset != cached.constEnd() && asset->dateTime.isValid())
+            applyAsset(info, *asset);
+        else
+            pending.append(info);
+        rows.append(info);
+    }
+    if (job->cancelled)
+        return;
+    deliver(std::move(rows), pending.isEmpty());
+    if (pending.isEmpty())
+        return;
+
+    // Files the library does not know about are stat'ed individually
+    bool indexed = false;
+    const QHash<QString, PhotoLibraryAsset> assets =
+        index->albumAssets(device, albumPath, &indexed);
+    qDebug() << "Photos library index" << (indexed ? "available" : "missing")
+             << "for" << albumPath << "-" << assets.size() << "assets,"
+             << pending.size() << "files to update";
+
+    QList<PhotoInfo> batch;
+    QElapsedTimer sinceLastBatch;
+    sinceLastBatch.start();
+    for (PhotoInfo &info : pending) {
+        if (job->cancelled)
+            return;
+
+        auto asset = assets.constFind(info.fileName);
+        if (asset != assets.constEnd() && asset->dateTime.isValid()) {
+            applyAsset(info, *asset);
+        } else {
+            info.dateTime = extractDateTimeFromFile(
+                device, info.filePath, &info.fileSize, &info.modifiedTime);
+        }
+        batch.append(info);
+
+        // Stat'ed files trickle in slowly, so flush on time as well as size
+        if (batch.size() >= POPULATE_BATCH_SIZE ||
+            sinceLastBatch.elapsed() >= POPULATE_BATCH_INTERVAL_MS) {
+            deliver(std::move(batch), false, true);
+            batch = {};
+            sinceLastBatch.restart();
+        }
+    }
+
+    if (!job->cancelled)
+        deliver(std::move(batch), true, true);
+}
+
+// Batches come from different albums. Each is sorted on its own and then
+// all of them are merged k-way, so the rows get one ordered insert pass.
+void PhotoModel::appendPhotos(QList<QList<PhotoInfo>> batches)
+{
+    QList<QList<PhotoInfo>> runs;
+    qsizetype total = 0;
+    for (const QList<PhotoInfo> &batch : batches) {
+        QList<PhotoInfo> run;
+        for (PhotoInfo info : batch) {
+            info.id = m_allPhotos.size();
+            m_allPhotos.append(info);
+            m_idByPath.insert(info.filePath, info.id);
+            if (matchesFilter(info))
+                run.append(info);
+        }
+        if (run.isEmpty())
+            continue;
+        sortPhotos(run);
+        total += run.size();
+        runs.append(std::move(run));
+    }
 
-    qDebug() << "Loaded" << m_allPhotos.size() << "media files from device";
-    qDebug() << "After filtering:" << m_photos.size() << "items shown";
+    // (run, position) heads, ordered so the top of the heap comes first
+    using Head = std::pair<qsizetype, qsizetype>;
+    auto later = [this, &runs](const Head &a, const Head &b) {
+        return comesBefore(runs.at(b.first).at(b.second),
+                           runs.at(a.first).at(a.second));
+    };
+    std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+    for (qsizetype r = 0; r < runs.size(); ++r)
+        heads.push({r, 0});
+
+    QList<PhotoInfo> merged;
+    merged.reserve(total);
+    while (!heads.empty()) {
+        const Head head = heads.top();
+        heads.pop();
+        merged.append(runs.at(head.first).at(head.second));
+        if (head.second + 1 < runs.at(head.first).size())
+            heads.push({head.first, head.second + 1});
+    }
+    mergeRows(std::move(merged));
+
+    // The duplicate scan picks up the new photos
+    if (duplicateScanActive())
+        scheduleThumbnails();
+}
+
+// Fills in the dates and sizes of rows that went out before the Photos
+// library knew them. Shown rows are taken out and merged back in order.
+void PhotoModel::updatePhotos(QList<QList<PhotoInfo>> batches)
+{
+    QHash<int, PhotoInfo> updated;
+    for (const QList<PhotoInfo> &batch : batches) {
+        for (const PhotoInfo &update : batch) {
+            auto it = m_idByPath.constFind(update.filePath);
+            if (it == m_idByPath.constEnd())
+                continue;
+            PhotoInfo &info = m_allPhotos[*it];
+            info.dateTime = update.dateTime;
+            info.dimensions = update.dimensions;
+            info.fileSize = update.fileSize;
+            info.modifiedTime = update.modifiedTime;
+            updated.insert(info.id, info);
+        }
+    }
+    if (updated.isEmpty())
+        return;
+
+    QList<PhotoInfo> visible;
+    qsizetype row = m_photos.size() - 1;
+    while (row >= 0) {
+        if (!updated.contains(m_photos.at(row).id)) {
+            --row;
+            continue;
+        }
+        qsizetype first = row;
+        while (first > 0 && updated.contains(m_photos.at(first - 1).id))
+            --first;
+
+        beginRemoveRows(QModelIndex(), first, row);
+        for (qsizetype r = first; r <= row; ++r)
+            visible.append(updated.value(m_photos.at(r).id));
+        m_photos.remove(first, row - first + 1);
+        endRemoveRows();
+        row = first - 1;
+    }
+    m_rowIndexDirty = true;
+
+    sortPhotos(visible);
+    mergeRows(std::move(visible));
+}
+
+// visible must already be sorted
+void PhotoModel::mergeRows(QList<PhotoInfo> visible)
+{
+    if (visible.isEmpty())
+        return;
+    m_rowIndexDirty = true;
+
+    // Sorted merge into the shown rows, consecutive items that land in the
+    // same gap are inserted with a single beginInsertRows
+    auto lessThan = [this](const PhotoInfo &a, const PhotoInfo &b) {
+        return comesBefore(a, b);
+    };
+    qsizetype pos = 0;
+    qsizetype i = 0;
+    while (i < visible.size()) {
+        pos = std::upper_bound(m_photos.begin() + pos, m_photos.end(),
+                               visible.at(i), lessThan) -
+              m_photos.begin();
+        qsizetype j = i + 1;
+        while (j < visible.size() &&
+               (pos == m_photos.size() ||
+                comesBefore(visible.at(j), m_photos.at(pos)))) {
+            ++j;
+        }
+
+        beginInsertRows(QModelIndex(), pos, pos + (j - i) - 1);
+        for (qsizetype k = i; k < j; ++k)
+            m_photos.insert(pos + (k - i), visible.at(k));
+        endInsertRows();
+
+        pos += j - i;
+        i = j;
+    }
 }
 
 // Sorting and filtering methods
@@ -687,7 +1162,118 @@ void PhotoModel::setFilterType(FilterType filter)
     if (m_filterType != filter) {
         m_filterType = filter;
         applyFilterAndSort();
+        scheduleThumbnails();
+    }
+}
+
+void PhotoModel::setDuplicateScanEnabled(bool enabled)
+{
+    if (m_duplicateScanRequested == enabled)
+        return;
+    m_duplicateScanRequested = enabled;
+    scheduleThumbnails();
+}
+
+bool PhotoModel::duplicateScanActive() const
+{
+    return m_duplicateScanRequested || m_filterType == DuplicatesOnly;
+}
+
+bool PhotoModel::isDuplicateScanComplete() const
+{
+    return !m_populateJob && m_hashScanNext >= m_allPhotos.size() &&
+           m_activeLoaders.isEmpty();
+}
+
+bool PhotoModel::hasDuplicate(const PhotoInfo &info) const
+{
+    auto hash = m_hashes.constFind(info.id);
+    if (hash == m_hashes.constEnd())
+        return false;
+
+    // Anything but this very file counts, whatever album or device it is on
+    const QString udid = QString::fromStdString(m_device->udid);
+    const QList<DuplicateIndex::PhotoRef> similar =
+        DuplicateIndex::sharedInstance()->findSimilar(*hash);
+    for (const DuplicateIndex::PhotoRef &ref : similar) {
+        if (ref.udid != udid || ref.filePath != info.filePath)
+            return true;
+    }
+    return false;
+}
+
+void PhotoModel::onPhotoHashed(int id, quint64 hash)
+{
+    // A poster frame matches its Live Photo still, so videos stay out of the
+    // index, even with a hash from an older thumbnail cache
+    if (id < 0 || id >= m_allPhotos.size() ||
+        m_allPhotos.at(id).fileType == PhotoInfo::Video)
+        return;
+    m_hashes.insert(id, hash);
+
+    const QString udid = QString::fromStdString(m_device->udid);
+    DuplicateIndex::sharedInstance()->insert(udid, m_allPhotos.at(id).filePath,
+                                             hash);
+    if (m_filterType != DuplicatesOnly)
+        return;
+
+    // This photo and the ones in this album it matches may qualify now
+    QList<PhotoInfo> newlyShown;
+    const QList<DuplicateIndex::PhotoRef> similar =
+        DuplicateIndex::sharedInstance()->findSimilar(hash);
+    for (const DuplicateIndex::PhotoRef &ref : similar) {
+        if (ref.udid != udid)
+            continue;
+        const int other = m_idByPath.value(ref.filePath, -1);
+        if (other < 0 || rowForId(other) >= 0)
+            continue;
+        const PhotoInfo &info = m_allPhotos.at(other);
+        if (matchesFilter(info))
+            newlyShown.append(info);
+    }
+    sortPhotos(newlyShown);
+    mergeRows(std::move(newlyShown));
+}
+
+// IMG_0001.HEIC and IMG_0001.MOV of a Live Photo share everything but the
+// suffix
+static QString liveAssetKey(const QString &filePath)
+{
+    const int dot = filePath.lastIndexOf('.');
+    return (dot > filePath.lastIndexOf('/') ? filePath.left(dot) : filePath)
+        .toUpper();
+}
+
+QStringList PhotoModel::withoutDuplicates(const QStringList &filePaths) const
+{
+    // Only stills are hashed, a Live Photo movie follows its still
+    QSet<QString> dropped;
+    QSet<QString> droppedAssets;
+    HammingTree keptHashes;
+    for (const QString &filePath : filePaths) {
+        const int id = m_idByPath.value(filePath, -1);
+        auto hash = m_hashes.constFind(id);
+        if (hash == m_hashes.constEnd())
+            continue;
+        if (keptHashes.contains(*hash, DuplicateIndex::MAX_DISTANCE)) {
+            dropped.insert(filePath);
+            droppedAssets.insert(liveAssetKey(filePath));
+        } else {
+            keptHashes.insert(*hash, id);
+        }
     }
+
+    QStringList kept;
+    for (const QString &filePath : filePaths) {
+        if (dropped.contains(filePath))
+            continue;
+        const int id = m_idByPath.value(filePath, -1);
+        if (id >= 0 && m_allPhotos.at(id).fileType == PhotoInfo::Video &&
+            droppedAssets.contains(liveAssetKey(filePath)))
+            continue;
+        kept.append(filePath);
+    }
+    return kept;
 }
 
 void PhotoModel::applyFilterAndSort()
@@ -709,6 +1295,7 @@ void PhotoModel::applyFilterAndSort()
 
     // Sort photos
     sortPhotos(m_photos);
+    m_rowIndexDirty = true;
 
     endResetModel();
 
@@ -720,14 +1307,23 @@ void PhotoModel::sortPhotos(QList<PhotoInfo> &photos) const
 {
     std::sort(photos.begin(), photos.end(),
               [this](const PhotoInfo &a, const PhotoInfo &b) {
-                  if (m_sortOrder == NewestFirst) {
-                      return a.dateTime > b.dateTime;
-                  } else {
-                      return a.dateTime < b.dateTime;
-                  }
+                  return comesBefore(a, b);
               });
 }
 
+// Ties are broken by path so batches merge into a deterministic order
+bool PhotoModel::comesBefore(const PhotoInfo &a, const PhotoInfo &b) const
+{
+    if (a.dateTime != b.dateTime) {
+        if (m_sortOrder == NewestFirst) {
+            return a.dateTime > b.dateTime;
+        } else {
+            return a.dateTime < b.dateTime;
+        }
+    }
+    return a.filePath < b.filePath;
+}
+
 bool PhotoModel::matchesFilter(const PhotoInfo &info) const
 {
     switch (m_filterType) {
@@ -737,6 +1333,8 @@ bool PhotoModel::matchesFilter(const PhotoInfo &info) const
         return info.fileType == PhotoInfo::Image;
     case VideosOnly:
         return info.fileType == PhotoInfo::Video;
+    case DuplicatesOnly:
+        return hasDuplicate(info);
     default:
         return true;
     }
@@ -790,49 +1388,52 @@ QStringList PhotoModel::getFilteredFilePaths() const
 }
 
 // Helper methods
-QDateTime PhotoModel::extractDateTimeFromFile(const QString &filePath) const
+QDateTime PhotoModel::extractDateTimeFromFile(iDescriptorDevice *device,
+                                              const QString &filePath,
+                                              quint64 *fileSize,
+                                              qint64 *modifiedTime)
 {
     plist_t info = nullptr;
     afc_error_t afc_err = ServiceManager::safeAfcGetFileInfoPlist(
-        m_device, filePath.toUtf8().constData(), &info);
+        device, filePath.toUtf8().constData(), &info);
 
     if (afc_err == AFC_E_SUCCESS && info) {
+        uint64_t size = 0;
+        uint64_t birthtime_ns = 0;
+        uint64_t mtime_ns = 0;
+
+        plist_t size_node = plist_dict_get_item(info, "st_size");
+        if (size_node && plist_get_node_type(size_node) == PLIST_UINT)
+            plist_get_uint_val(size_node, &size);
+
         plist_t birthtime_node = plist_dict_get_item(info, "st_birthtime");
         if (birthtime_node &&
-            plist_get_node_type(birthtime_node) == PLIST_UINT) {
-            uint64_t birthtime_ns = 0;
+            plist_get_node_type(birthtime_node) == PLIST_UINT)
             plist_get_uint_val(birthtime_node, &birthtime_ns);
 
-            // Convert nanoseconds since epoch to QDateTime
-            // The timestamp appears to be in nanoseconds since Unix epoch
-            uint64_t seconds = birthtime_ns / 1000000000ULL;
-            QDateTime dateTime =
-                QDateTime::fromSecsSinceEpoch(seconds, Qt::UTC);
-
-            plist_free(info);
-            if (dateTime.isValid()) {
-                return dateTime;
-            }
-        }
-
-        // Fallback to st_mtime (modification time) if birthtime not available
         plist_t mtime_node = plist_dict_get_item(info, "st_mtime");
-        if (mtime_node && plist_get_node_type(mtime_node) == PLIST_UINT) {
-            uint64_t mtime_ns = 0;
+        if (mtime_node && plist_get_node_type(mtime_node) == PLIST_UINT)
             plist_get_uint_val(mtime_node, &mtime_ns);
 
-            // Convert nanoseconds since epoch to QDateTime
-            uint64_t seconds = mtime_ns / 1000000000ULL;
+        plist_free(info);
+
+        if (fileSize)
+            *fileSize = size;
+        if (modifiedTime)
+            *modifiedTime = static_cast<qint64>(mtime_ns);
+
+        // The timestamps are in nanoseconds since Unix epoch, prefer the
+        // birthtime and fall back to st_mtime (modification time)
+        for (uint64_t timestamp_ns : {birthtime_ns, mtime_ns}) {
+            if (!timestamp_ns)
+                continue;
+            uint64_t seconds = timestamp_ns / 1000000000ULL;
             QDateTime dateTime =
                 QDateTime::fromSecsSinceEpoch(seconds, Qt::UTC);
-
-            plist_free(info);
             if (dateTime.isValid()) {
                 return dateTime;
             }
         }
-
-        plist_free(info);
     }
 
     // Final fallback: try to extract date from filename pattern like
@@ -863,7 +1464,7 @@ QDateTime PhotoModel::extractDateTimeFromFile(const QString &filePath) const
     return QDateTime::currentDateTime();
 }
 
-PhotoInfo::FileType PhotoModel::determineFileType(const QString &fileName) const
+PhotoInfo::FileType PhotoModel::determineFileType(const QString &fileName)
 {
     if (fileName.endsWith(".MOV", Qt::CaseInsensitive) ||
         fileName.endsWith(".MP4", Qt::CaseInsensitive) ||
@@ -876,11 +1477,17 @@ PhotoInfo::FileType PhotoModel::determineFileType(const QString &fileName) const
 
 void PhotoModel::setAlbumPath(const QString &albumPath)
 {
-    if (m_albumPath != albumPath) {
-        qDebug() << "Setting new album path:" << albumPath;
+    setAlbumPaths({albumPath});
+}
+
+void PhotoModel::setAlbumPaths(const QStringList &albumPaths)
+{
+    // Also start over if leaving the gallery cancelled the last listing
+    if (m_albumPaths != albumPaths || (!m_populateJob && !m_populated)) {
+        qDebug() << "Setting new album paths:" << albumPaths;
         clear();
 
-        m_albumPath = albumPath;
+        m_albumPaths = albumPaths;
         populatePhotoPaths();
     }
 }
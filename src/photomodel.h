@@ -26,15 +26,29 @@
 #include <QCryptographicHash>
 #include <QDateTime>
 #include <QFutureWatcher>
+#include <QMutex>
 #include <QPixmap>
 #include <QSemaphore>
 #include <QSize>
 #include <QStandardPaths>
+#include <atomic>
+#include <memory>
+#include <optional>
+
+struct ThumbnailKey;
 
 struct PhotoInfo {
+    int id = -1; // index into PhotoModel's list of all photos of the album
     QString filePath;
     QString fileName;
+    QString albumPath; // DCIM folder the file is in
     QDateTime dateTime;
+    QSize dimensions; // only known when the Photos library is indexed
+    // st_size / st_mtime (ns) of the file, used to validate cached
+    // thumbnails. Files populated from the Photos library only carry the
+    // library's size and are stat'ed when their thumbnail is loaded.
+    quint64 fileSize = 0;
+    qint64 modifiedTime = 0;
     bool thumbnailRequested = false;
 
     enum FileType { Image, Video };
@@ -48,7 +62,7 @@ class PhotoModel : public QAbstractListModel
 public:
     enum SortOrder { NewestFirst, OldestFirst };
 
-    enum FilterType { All, ImagesOnly, VideosOnly };
+    enum FilterType { All, ImagesOnly, VideosOnly, DuplicatesOnly };
 
     explicit PhotoModel(iDescriptorDevice *device, FilterType filterType,
                         QObject *parent = nullptr);
@@ -61,6 +75,9 @@ public:
 
     // Album management
     void setAlbumPath(const QString &albumPath);
+    // One timeline over several albums, listed concurrently and merged by
+    // date as they come in
+    void setAlbumPaths(const QStringList &albumPaths);
     void refreshPhotos();
 
     // Sorting and filtering
@@ -78,33 +95,87 @@ public:
     // Get all items for export
     QStringList getAllFilePaths() const;
     QStringList getFilteredFilePaths() const;
+    // Thumbnail from the memory or disk cache, null if it would take a trip
+    // to the device
+    QImage cachedThumbnail(const QString &filePath) const;
+
+    // Perceptual hashes are computed for the whole album in the background
+    // while this is on, as part of thumbnail loading. DuplicatesOnly turns
+    // it on as well.
+    void setDuplicateScanEnabled(bool enabled);
+    bool isDuplicateScanComplete() const;
+    int hashedCount() const { return m_hashes.size(); }
+    int photoCount() const { return m_allPhotos.size(); }
+    // filePaths minus every photo that looks like one earlier in the list.
+    // Photos without a hash yet are kept.
+    QStringList withoutDuplicates(const QStringList &filePaths) const;
+
+    // Rows currently shown by the view, thumbnails are loaded for these
+    // first and then one screen ahead in the scroll direction
+    void setVisibleRange(int first, int last);
 
     static QPixmap loadImage(iDescriptorDevice *device,
                              const QString &filePath);
     // Static helper methods
     static QPixmap loadThumbnailFromDevice(iDescriptorDevice *device,
                                            const QString &filePath,
-                                           const QSize &size);
+                                           const QSize &size,
+                                           quint64 fileSize = 0);
     void clear();
 signals:
-    void thumbnailNeedsToBeLoaded(int index);
+    void thumbnailNeedsToBeLoaded(int id);
     void exportRequested(const QStringList &filePaths);
 
 private slots:
-    void requestThumbnail(int index);
+    void requestThumbnail(int id);
 
 private:
     // Data members
     iDescriptorDevice *m_device;
-    QString m_albumPath;
+    QStringList m_albumPaths;
     QList<PhotoInfo> m_allPhotos; // All photos from device
     QList<PhotoInfo> m_photos;    // Currently filtered/sorted photos
+    mutable QList<int> m_rowById; // photo id -> row in m_photos, or -1
+    mutable bool m_rowIndexDirty = true;
+    QHash<QString, int> m_idByPath;
+
+    // Background population, one worker per album. Workers only talk to
+    // the model while holding the job lock, cancelling clears the pointer.
+    // Batches queue up in the inbox until the model drains them in one go,
+    // updates carry dates of rows that went out before they were known.
+    struct PopulateJob {
+        QMutex mutex;
+        PhotoModel *model = nullptr;
+        std::atomic_bool cancelled{false};
+        QList<QList<PhotoInfo>> inbox;
+        QList<QList<PhotoInfo>> updates;
+        bool flushPosted = false;
+        int runningAlbums = 0;
+    };
+    std::shared_ptr<PopulateJob> m_populateJob;
+    bool m_populated = false; // the last population ran to the end
 
     // Thumbnail management
     QSize m_thumbnailSize;
-    mutable QCache<QString, QPixmap> m_thumbnailCache;
-    mutable QHash<QString, QFutureWatcher<QPixmap> *> m_activeLoaders;
-    mutable QSet<QString> m_loadingPaths;
+    // JPEG bytes of every loaded thumbnail, plus pixmaps of recently drawn
+    // ones, both keyed by photo id
+    QCache<int, QByteArray> m_encodedThumbnails;
+    mutable QCache<int, QPixmap> m_decodedThumbnails;
+    struct ThumbnailResult {
+        QByteArray encoded;
+        std::optional<quint64> hash;
+    };
+    QHash<int, QFutureWatcher<ThumbnailResult> *> m_activeLoaders;
+    QList<int> m_pendingThumbnails; // LIFO until a visible range is known
+    QSet<int> m_failedThumbnails;
+    int m_visibleFirst = -1;
+    int m_visibleLast = -1;
+    bool m_scrollingDown = true;
+
+    // Duplicate detection, dHash by photo id
+    QHash<int, quint64> m_hashes;
+    bool m_duplicateScanRequested = false;
+    int m_hashScanNext = 0; // next photo id the scan looks at
 
     // Sorting and filtering
     SortOrder m_sortOrder;
@@ -112,12 +183,35 @@ private:
 
     // Helper methods
     void populatePhotoPaths();
+    void scheduleThumbnails();
+    void startThumbnailJob(int id);
+    bool needsThumbnail(int id) const;
+    const QPixmap *thumbnailPixmap(int id) const;
+    int rowForId(int id) const;
+    void cancelPopulation();
+    void flushPopulation(const std::shared_ptr<PopulateJob> &job);
+    void appendPhotos(QList<QList<PhotoInfo>> batches);
+    void updatePhotos(QList<QList<PhotoInfo>> batches);
+    void mergeRows(QList<PhotoInfo> visible);
+    void onPhotoHashed(int id, quint64 hash);
+    bool duplicateScanActive() const;
+    bool hasDuplicate(const PhotoInfo &info) const;
     void applyFilterAndSort();
     void sortPhotos(QList<PhotoInfo> &photos) const;
+    bool comesBefore(const PhotoInfo &a, const PhotoInfo &b) const;
     bool matchesFilter(const PhotoInfo &info) const;
 
-    QDateTime extractDateTimeFromFile(const QString &filePath) const;
-    PhotoInfo::FileType determineFileType(const QString &fileName) const;
+    static void runPopulation(std::shared_ptr<PopulateJob> job,
+                              iDescriptorDevice *device,
+                              const QString &albumPath);
+    static QDateTime extractDateTimeFromFile(iDescriptorDevice *device,
+                                             const QString &filePath,
+                                             quint64 *fileSize = nullptr,
+                                             qint64 *modifiedTime = nullptr);
+    static PhotoInfo::FileType determineFileType(const QString &fileName);
+    static bool statThumbnailKey(iDescriptorDevice *device,
+                                 const PhotoInfo &info, const QSize &size,
+                                 ThumbnailKey &key);
 
     static QPixmap generateVideoThumbnailFFmpeg(iDescriptorDevice *device,
                                                 const QString &filePath,
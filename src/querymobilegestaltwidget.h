@@ -20,16 +20,17 @@
 #ifndef QUERYMOBILEGESTALTWIDGET_H
 #define QUERYMOBILEGESTALTWIDGET_H
 
+#include "gestaltkeylistmodel.h"
 #include "iDescriptor.h"
-#include <QCheckBox>
+#include "zlineedit.h"
 #include <QComboBox>
 #include <QGroupBox>
 #include <QHBoxLayout>
 #include <QLabel>
-#include <QListWidget>
+#include <QListView>
 #include <QMap>
 #include <QPushButton>
-#include <QScrollArea>
+#include <QSortFilterProxyModel>
 #include <QStringList>
 #include <QTextEdit>
 #include <QVBoxLayout>
@@ -46,6 +47,7 @@ public:
 
 private slots:
     void onQueryButtonClicked();
+    void onRefreshButtonClicked();
     void onSelectAllClicked();
     void onClearAllClicked();
 
@@ -53,28 +55,27 @@ private:
     void setupUI();
     void populateKeys();
     QStringList getSelectedKeys();
+    void runQuery(bool refresh);
     void displayResults(const QMap<QString, QVariant> &results);
 
     // UI Components
     QVBoxLayout *mainLayout;
     QGroupBox *selectionGroup;
-    QScrollArea *scrollArea;
-    QWidget *checkboxWidget;
-    QVBoxLayout *checkboxLayout;
+    ZLineEdit *searchEdit;
+    QListView *keyListView;
     QHBoxLayout *buttonLayout;
     QPushButton *selectAllButton;
     QPushButton *clearAllButton;
     QPushButton *queryButton;
+    QPushButton *refreshButton;
     QTextEdit *outputTextEdit;
     QLabel *statusLabel;
     iDescriptorDevice *m_device;
 
     // Data
     QStringList mobileGestaltKeys;
-    QList<QCheckBox *> keyCheckboxes;
-
-    // Mock query function for demonstration
-    QMap<QString, QVariant> queryMobileGestalt(const QStringList &keys);
+    GestaltKeyListModel *keyModel;
+    QSortFilterProxyModel *keyFilterModel;
 };
 
 #endif // QUERYMOBILEGESTALTWIDGET_H
\ No newline at end of file
@@ -168,6 +168,72 @@ void SettingsManager::setConnectionTimeout(int seconds)
     m_settings->sync();
 }
 
+int SettingsManager::videoThumbnailOffset() const
+{
+    return m_settings->value("videoThumbnailOffset", 1).toInt();
+}
+
+void SettingsManager::setVideoThumbnailOffset(int seconds)
+{
+    m_settings->setValue("videoThumbnailOffset", seconds);
+    m_settings->sync();
+}
+
+bool SettingsManager::convertHeicOnExport() const
+{
+    return m_settings->value("convertHeicOnExport", false).toBool();
+}
+
+void SettingsManager::setConvertHeicOnExport(bool enabled)
+{
+    m_settings->setValue("convertHeicOnExport", enabled);
+    m_settings->sync();
+}
+
+bool SettingsManager::transcodeVideoOnExport() const
+{
+    return m_settings->value("transcodeVideoOnExport", false).toBool();
+}
+
+void SettingsManager::setTranscodeVideoOnExport(bool enabled)
+{
+    m_settings->setValue("transcodeVideoOnExport", enabled);
+    m_settings->sync();
+}
+
+bool SettingsManager::faststartVideoPreview() const
+{
+    return m_settings->value("faststartVideoPreview", true).toBool();
+}
+
+void SettingsManager::setFaststartVideoPreview(bool enabled)
+{
+    m_settings->setValue("faststartVideoPreview", enabled);
+    m_settings->sync();
+}
+
+bool SettingsManager::optimizeWirelessImport() const
+{
+    return m_settings->value("optimizeWirelessImport", false).toBool();
+}
+
+void SettingsManager::setOptimizeWirelessImport(bool enabled)
+{
+    m_settings->setValue("optimizeWirelessImport", enabled);
+    m_settings->sync();
+}
+
+int SettingsManager::exportJpegQuality() const
+{
+    return m_settings->value("exportJpegQuality", 90).toInt();
+}
+
+void SettingsManager::setExportJpegQuality(int quality)
+{
+    m_settings->setValue("exportJpegQuality", quality);
+    m_settings->sync();
+}
+
 bool SettingsManager::showKeychainDialog() const
 {
     return m_settings->value("showKeychainDialog", true).toBool();
@@ -233,6 +299,12 @@ void SettingsManager::resetToDefaults()
     setUseUnsecureBackend(false);
     setTheme("System Default");
     setConnectionTimeout(30);
+    setVideoThumbnailOffset(1);
+    setConvertHeicOnExport(false);
+    setExportJpegQuality(90);
+    setTranscodeVideoOnExport(false);
+    setFaststartVideoPreview(true);
+    setOptimizeWirelessImport(false);
     setShowKeychainDialog(true);
     setDefaultJailbrokenRootPassword("alpine");
 }
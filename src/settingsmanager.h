@@ -86,6 +86,29 @@ public:
     int connectionTimeout() const;
     void setConnectionTimeout(int seconds);
 
+    // Position in seconds that video thumbnails are taken from
+    int videoThumbnailOffset() const;
+    void setVideoThumbnailOffset(int seconds);
+
+    // Gallery exports write HEIC photos as JPEG at exportJpegQuality
+    bool convertHeicOnExport() const;
+    void setConvertHeicOnExport(bool enabled);
+
+    // Gallery exports re-encode videos to H.264
+    bool transcodeVideoOnExport() const;
+    void setTranscodeVideoOnExport(bool enabled);
+
+    // Preview streams of movies with a trailing header serve it up front
+    bool faststartVideoPreview() const;
+    void setFaststartVideoPreview(bool enabled);
+
+    // Wireless gallery imports resize images and convert videos first
+    bool optimizeWirelessImport() const;
+    void setOptimizeWirelessImport(bool enabled);
+
+    int exportJpegQuality() const;
+    void setExportJpegQuality(int quality);
+
     bool showKeychainDialog() const;
     void setShowKeychainDialog(bool show);
 
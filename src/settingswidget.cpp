@@ -97,6 +97,46 @@ void SettingsWidget::setupUI()
     themeLayout->addStretch();
     generalLayout->addLayout(themeLayout);
 
+    // Video thumbnail position
+    auto *videoThumbnailLayout = new QHBoxLayout();
+    videoThumbnailLayout->addWidget(new QLabel("Video Thumbnail Position:"));
+    m_videoThumbnailOffset = new QSpinBox();
+    m_videoThumbnailOffset->setRange(0, 30);
+    m_videoThumbnailOffset->setSuffix(" seconds");
+    m_videoThumbnailOffset->setToolTip(
+        "Gallery thumbnails of videos show the keyframe closest to this "
+        "position.");
+    videoThumbnailLayout->addWidget(m_videoThumbnailOffset);
+    videoThumbnailLayout->addStretch();
+    generalLayout->addLayout(videoThumbnailLayout);
+
+    // HEIC to JPEG conversion on gallery export
+    auto *convertHeicLayout = new QHBoxLayout();
+    m_convertHeicOnExport =
+        new QCheckBox("Convert HEIC photos to JPEG when exporting");
+    convertHeicLayout->addWidget(m_convertHeicOnExport);
+    convertHeicLayout->addWidget(new QLabel("Quality:"));
+    m_exportJpegQuality = new QSpinBox();
+    m_exportJpegQuality->setRange(50, 100);
+    m_exportJpegQuality->setToolTip(
+        "JPEG quality of converted photos. EXIF data and file dates are kept.");
+    convertHeicLayout->addWidget(m_exportJpegQuality);
+    convertHeicLayout->addStretch();
+    generalLayout->addLayout(convertHeicLayout);
+
+    m_transcodeVideoOnExport =
+        new QCheckBox("Convert videos to H.264 when exporting");
+    m_transcodeVideoOnExport->setToolTip(
+        "HEVC videos are re-encoded, audio and metadata are kept.");
+    generalLayout->addWidget(m_transcodeVideoOnExport);
+
+    m_faststartVideoPreview =
+        new QCheckBox("Start video previews without reading the whole file");
+    m_faststartVideoPreview->setToolTip(
+        "Videos whose index is stored at the end are served with the index "
+        "first, so playback starts sooner.");
+    generalLayout->addWidget(m_faststartVideoPreview);
+
     scrollLayout->addWidget(generalGroup);
 
     // === DEVICE CONNECTION SETTINGS ===
@@ -219,6 +259,12 @@ void SettingsWidget::loadSettings()
     }
 
     m_connectionTimeout->setValue(sm->connectionTimeout());
+    m_videoThumbnailOffset->setValue(sm->videoThumbnailOffset());
+    m_convertHeicOnExport->setChecked(sm->convertHeicOnExport());
+    m_exportJpegQuality->setValue(sm->exportJpegQuality());
+    m_exportJpegQuality->setEnabled(sm->convertHeicOnExport());
+    m_transcodeVideoOnExport->setChecked(sm->transcodeVideoOnExport());
+    m_faststartVideoPreview->setChecked(sm->faststartVideoPreview());
     m_useUnsecureBackend->setChecked(sm->useUnsecureBackend());
     m_defaultJailbrokenRootPassword->setText(
         sm->defaultJailbrokenRootPassword());
@@ -244,6 +290,19 @@ void SettingsWidget::connectSignals()
             this, &SettingsWidget::onSettingChanged);
     connect(m_connectionTimeout, QOverload<int>::of(&QSpinBox::valueChanged),
             this, &SettingsWidget::onSettingChanged);
+    connect(m_videoThumbnailOffset,
+            QOverload<int>::of(&QSpinBox::valueChanged), this,
+            &SettingsWidget::onSettingChanged);
+    connect(m_convertHeicOnExport, &QCheckBox::toggled, this,
+            &SettingsWidget::onSettingChanged);
+    connect(m_convertHeicOnExport, &QCheckBox::toggled, m_exportJpegQuality,
+            &QSpinBox::setEnabled);
+    connect(m_exportJpegQuality, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &SettingsWidget::onSettingChanged);
+    connect(m_transcodeVideoOnExport, &QCheckBox::toggled, this,
+            &SettingsWidget::onSettingChanged);
+    connect(m_faststartVideoPreview, &QCheckBox::toggled, this,
+            &SettingsWidget::onSettingChanged);
 
     connect(m_useUnsecureBackend, &QCheckBox::toggled, this, [this]() {
         // since this is unsafe if its being enabled, show a warning
@@ -342,6 +401,11 @@ void SettingsWidget::saveSettings()
 
     sm->setTheme(m_themeCombo->currentText());
     sm->setConnectionTimeout(m_connectionTimeout->value());
+    sm->setVideoThumbnailOffset(m_videoThumbnailOffset->value());
+    sm->setConvertHeicOnExport(m_convertHeicOnExport->isChecked());
+    sm->setExportJpegQuality(m_exportJpegQuality->value());
+    sm->setTranscodeVideoOnExport(m_transcodeVideoOnExport->isChecked());
+    sm->setFaststartVideoPreview(m_faststartVideoPreview->isChecked());
     sm->setDefaultJailbrokenRootPassword(
         m_defaultJailbrokenRootPassword->text());
 
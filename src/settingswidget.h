@@ -54,6 +54,11 @@ private:
     QLineEdit *m_downloadPathEdit;
     QCheckBox *m_autoUpdateCheck;
     QComboBox *m_themeCombo;
+    QSpinBox *m_videoThumbnailOffset;
+    QCheckBox *m_convertHeicOnExport;
+    QSpinBox *m_exportJpegQuality;
+    QCheckBox *m_transcodeVideoOnExport;
+    QCheckBox *m_faststartVideoPreview;
     QCheckBox *m_autoRaiseWindow;
     QCheckBox *m_switchToNewDevice;
 #ifndef __APPLE__
@@ -0,0 +1,408 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "thumbnailcache.h"
+#include "duplicateindex.h"
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QtEndian>
+
+/*
+  Pack layout (little endian):
+    header: "IDTP" u32 version
+    record: u32 magic, u16 nameLength, u16 flags, u64 fileSize, i64 mtime,
+            u32 dataLength, u64 hash, name (UTF-8), data (JPEG)
+  A newer record with the same name supersedes the older one. hash is the
+  dHash of the thumbnail and only valid with RECORD_FLAG_HASH set.
+*/
+static constexpr char PACK_MAGIC[4] = {'I', 'D', 'T', 'P'};
+static constexpr quint32 PACK_VERSION = 2;
+static constexpr qint64 PACK_HEADER_SIZE = 8;
+static constexpr quint32 RECORD_MAGIC = 0x31434552; // "REC1"
+static constexpr qint64 RECORD_HEADER_SIZE = 36;
+static constexpr quint16 RECORD_FLAG_HASH = 0x1;
+static constexpr int THUMBNAIL_JPEG_QUALITY = 85;
+// Packs of every device and album together
+static constexpr qint64 MAX_CACHE_BYTES = 1024LL * 1024 * 1024;
+
+ThumbnailCache *ThumbnailCache::sharedInstance()
+{
+    static ThumbnailCache instance;
+    return &instance;
+}
+
+QString ThumbnailCache::rootDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           "/thumbnails";
+}
+
+QString ThumbnailCache::deviceDir(const QString &udid)
+{
+    return rootDir() + "/" + udid;
+}
+
+// Removes whole packs, least recently used first, until the store fits
+// MAX_CACHE_BYTES. A pack's file time is refreshed whenever it is opened.
+void ThumbnailCache::prune()
+{
+    QFileInfoList packs;
+    qint64 total = 0;
+    const QDir root(rootDir());
+    const QStringList devices =
+        root.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &device : devices) {
+        const QFileInfoList files = QDir(root.filePath(device))
+                                        .entryInfoList({"*.pack"}, QDir::Files);
+        for (const QFileInfo &file : files) {
+            total += file.size();
+            packs.append(file);
+        }
+    }
+    if (total <= MAX_CACHE_BYTES)
+        return;
+
+    std::sort(packs.begin(), packs.end(),
+              [](const QFileInfo &a, const QFileInfo &b) {
+                  return a.lastModified() < b.lastModified();
+              });
+    for (const QFileInfo &file : packs) {
+        if (total <= MAX_CACHE_BYTES)
+            break;
+        if (QFile::remove(file.absoluteFilePath())) {
+            qDebug() << "ThumbnailCache: evicting" << file.absoluteFilePath();
+            total -= file.size();
+        }
+    }
+    // Only succeeds for devices left without packs
+    for (const QString &device : devices)
+        root.rmdir(device);
+}
+
+std::shared_ptr<ThumbnailCache::Pack>
+ThumbnailCache::pack(const QString &udid, const QString &albumPath)
+{
+    QMutexLocker locker(&m_mutex);
+    // Before any pack is open, so none is removed from under a reader
+    if (!m_pruned) {
+        m_pruned = true;
+        prune();
+    }
+
+    const QString key = udid + "|" + albumPath;
+    auto it = m_packs.find(key);
+    if (it != m_packs.end())
+        return *it;
+
+    const QString hash = QString::fromLatin1(
+        QCryptographicHash::hash(albumPath.toUtf8(), QCryptographicHash::Sha1)
+            .toHex());
+    auto pack = std::make_shared<Pack>(deviceDir(udid) + "/" + hash + ".pack");
+    m_packs.insert(key, pack);
+    return pack;
+}
+
+QImage ThumbnailCache::lookup(const QString &udid, const QString &albumPath,
+                              const ThumbnailKey &key)
+{
+    QByteArray data = lookupEncoded(udid, albumPath, key);
+    if (data.isEmpty())
+        return {};
+
+    QImage image;
+    if (!image.loadFromData(data, "JPG")) {
+        qDebug() << "ThumbnailCache: corrupt entry for" << key.filePath;
+        return {};
+    }
+    return image;
+}
+
+QByteArray ThumbnailCache::lookupEncoded(const QString &udid,
+                                         const QString &albumPath,
+                                         const ThumbnailKey &key,
+                                         std::optional<quint64> *hash)
+{
+    return pack(udid, albumPath)->read(key, hash);
+}
+
+void ThumbnailCache::store(const QString &udid, const QString &albumPath,
+                           const ThumbnailKey &key, const QImage &thumbnail)
+{
+    QByteArray data = encode(thumbnail);
+    if (data.isEmpty()) {
+        qDebug() << "ThumbnailCache: failed to encode" << key.filePath;
+        return;
+    }
+    storeEncoded(udid, albumPath, key, data,
+                 DuplicateIndex::perceptualHash(thumbnail));
+}
+
+void ThumbnailCache::storeEncoded(const QString &udid,
+                                  const QString &albumPath,
+                                  const ThumbnailKey &key,
+                                  const QByteArray &data,
+                                  std::optional<quint64> hash)
+{
+    if (data.isEmpty())
+        return;
+    pack(udid, albumPath)->append(key, data, hash);
+}
+
+QByteArray ThumbnailCache::encode(const QImage &thumbnail)
+{
+    if (thumbnail.isNull())
+        return {};
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    if (!thumbnail.save(&buffer, "JPG", THUMBNAIL_JPEG_QUALITY))
+        return {};
+    return data;
+}
+
+ThumbnailCache::Pack::Pack(const QString &path) : m_path(path)
+{
+    if (open()) {
+        scan();
+        compact();
+    }
+}
+
+ThumbnailCache::Pack::~Pack()
+{
+    if (m_map)
+        m_file.unmap(m_map);
+    m_file.close();
+}
+
+QString ThumbnailCache::Pack::entryName(const ThumbnailKey &key)
+{
+    QString name = QString("%1@%2x%3")
+                       .arg(key.filePath)
+                       .arg(key.size.width())
+                       .arg(key.size.height());
+    if (!key.variant.isEmpty())
+        name += "#" + key.variant;
+    return name;
+}
+
+bool ThumbnailCache::Pack::open()
+{
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+    m_file.setFileName(m_path);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        qDebug() << "ThumbnailCache: cannot open" << m_path
+                 << m_file.errorString();
+        return false;
+    }
+    // Marks the pack as recently used for prune()
+    m_file.setFileTime(QDateTime::currentDateTime(),
+                       QFileDevice::FileModificationTime);
+
+    QByteArray header = m_file.read(PACK_HEADER_SIZE);
+    bool valid = header.size() == PACK_HEADER_SIZE &&
+                 memcmp(header.constData(), PACK_MAGIC, 4) == 0 &&
+                 qFromLittleEndian<quint32>(header.constData() + 4) ==
+                     PACK_VERSION;
+    if (!valid) {
+        // unknown or old format, start over
+        m_file.resize(0);
+        m_file.seek(0);
+        char fresh[PACK_HEADER_SIZE];
+        memcpy(fresh, PACK_MAGIC, 4);
+        qToLittleEndian<quint32>(PACK_VERSION, fresh + 4);
+        m_file.write(fresh, PACK_HEADER_SIZE);
+        m_file.flush();
+    }
+    return true;
+}
+
+bool ThumbnailCache::Pack::ensureMapped(qint64 end)
+{
+    if (m_map && end <= m_mappedSize)
+        return true;
+
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+        m_mappedSize = 0;
+    }
+    m_file.flush();
+    const qint64 size = m_file.size();
+    if (size <= 0)
+        return false;
+
+    m_map = m_file.map(0, size);
+    if (!m_map)
+        return false;
+    m_mappedSize = size;
+    return end <= m_mappedSize;
+}
+
+void ThumbnailCache::Pack::scan()
+{
+    const qint64 size = m_file.size();
+    if (size <= PACK_HEADER_SIZE || !ensureMapped(size))
+        return;
+
+    qint64 offset = PACK_HEADER_SIZE;
+    while (offset + RECORD_HEADER_SIZE <= size) {
+        const uchar *p = m_map + offset;
+        if (qFromLittleEndian<quint32>(p) != RECORD_MAGIC)
+            break;
+        const quint16 nameLength = qFromLittleEndian<quint16>(p + 4);
+        const quint16 flags = qFromLittleEndian<quint16>(p + 6);
+        const quint64 fileSize = qFromLittleEndian<quint64>(p + 8);
+        const qint64 mtime = qFromLittleEndian<qint64>(p + 16);
+        const quint32 dataLength = qFromLittleEndian<quint32>(p + 24);
+        std::optional<quint64> hash;
+        if (flags & RECORD_FLAG_HASH)
+            hash = qFromLittleEndian<quint64>(p + 28);
+
+        const qint64 recordSize =
+            RECORD_HEADER_SIZE + nameLength + static_cast<qint64>(dataLength);
+        if (offset + recordSize > size)
+            break;
+
+        const QString name = QString::fromUtf8(
+            reinterpret_cast<const char *>(p + RECORD_HEADER_SIZE),
+            nameLength);
+        auto existing = m_entries.constFind(name);
+        if (existing != m_entries.constEnd()) {
+            m_deadBytes += RECORD_HEADER_SIZE + nameLength + existing->length;
+        }
+        m_entries.insert(name,
+                         Entry{offset + RECORD_HEADER_SIZE + nameLength,
+                               dataLength, fileSize, mtime, hash});
+        offset += recordSize;
+    }
+
+    if (offset < size) {
+        // partial record from an interrupted write
+        qDebug() << "ThumbnailCache: truncating" << m_path << "at" << offset;
+        m_file.unmap(m_map);
+        m_map = nullptr;
+        m_mappedSize = 0;
+        m_file.resize(offset);
+    }
+}
+
+void ThumbnailCache::Pack::compact()
+{
+    const qint64 size = m_file.size();
+    if (m_deadBytes < 1024 * 1024 || m_deadBytes < size / 2)
+        return;
+    if (!ensureMapped(size))
+        return;
+
+    const QString tmpPath = m_path + ".tmp";
+    QFile tmp(tmpPath);
+    if (!tmp.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return;
+
+    char header[PACK_HEADER_SIZE];
+    memcpy(header, PACK_MAGIC, 4);
+    qToLittleEndian<quint32>(PACK_VERSION, header + 4);
+    tmp.write(header, PACK_HEADER_SIZE);
+
+    // name and header sit right before the data of every live record
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        const QByteArray name = it.key().toUtf8();
+        const qint64 recordStart = it->offset - RECORD_HEADER_SIZE - name.size();
+        tmp.write(reinterpret_cast<const char *>(m_map + recordStart),
+                  RECORD_HEADER_SIZE + name.size() + it->length);
+    }
+    tmp.close();
+
+    m_file.unmap(m_map);
+    m_map = nullptr;
+    m_mappedSize = 0;
+    m_file.close();
+    QFile::remove(m_path);
+    QFile::rename(tmpPath, m_path);
+
+    m_entries.clear();
+    m_deadBytes = 0;
+    if (open())
+        scan();
+}
+
+QByteArray ThumbnailCache::Pack::read(const ThumbnailKey &key,
+                                      std::optional<quint64> *hash)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.constFind(entryName(key));
+    if (it == m_entries.constEnd())
+        return {};
+    // the file on the device changed since we cached it
+    if (it->fileSize != key.fileSize || it->mtime != key.mtime)
+        return {};
+    if (!ensureMapped(it->offset + it->length))
+        return {};
+
+    if (hash)
+        *hash = it->hash;
+    return QByteArray(reinterpret_cast<const char *>(m_map + it->offset),
+                      it->length);
+}
+
+void ThumbnailCache::Pack::append(const ThumbnailKey &key,
+                                  const QByteArray &data,
+                                  std::optional<quint64> hash)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_file.isOpen())
+        return;
+
+    const QByteArray name = entryName(key).toUtf8();
+    char header[RECORD_HEADER_SIZE];
+    qToLittleEndian<quint32>(RECORD_MAGIC, header);
+    qToLittleEndian<quint16>(static_cast<quint16>(name.size()), header + 4);
+    qToLittleEndian<quint16>(hash ? RECORD_FLAG_HASH : 0, header + 6);
+    qToLittleEndian<quint64>(key.fileSize, header + 8);
+    qToLittleEndian<qint64>(key.mtime, header + 16);
+    qToLittleEndian<quint32>(static_cast<quint32>(data.size()), header + 24);
+    qToLittleEndian<quint64>(hash.value_or(0), header + 28);
+
+    const qint64 offset = m_file.size();
+    m_file.seek(offset);
+    if (m_file.write(header, RECORD_HEADER_SIZE) != RECORD_HEADER_SIZE ||
+        m_file.write(name) != name.size() ||
+        m_file.write(data) != data.size()) {
+        qDebug() << "ThumbnailCache: write failed for" << m_path;
+        m_file.resize(offset);
+        return;
+    }
+
+    const QString entry = QString::fromUtf8(name);
+    auto existing = m_entries.constFind(entry);
+    if (existing != m_entries.constEnd())
+        m_deadBytes += RECORD_HEADER_SIZE + name.size() + existing->length;
+    m_entries.insert(entry,
+                     Entry{offset + RECORD_HEADER_SIZE + name.size(),
+                           static_cast<quint32>(data.size()), key.fileSize,
+                           key.mtime, hash});
+}
@@ -0,0 +1,127 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QImage>
+#include <QMap>
+#include <QMutex>
+#include <QSize>
+#include <QString>
+#include <memory>
+#include <optional>
+
+/*
+ * Identifies one thumbnail of one file on the device. fileSize and mtime
+ * come from the AFC stat we already do while listing an album, so a changed
+ * file simply misses the cache.
+ */
+struct ThumbnailKey {
+    QString filePath;
+    quint64 fileSize = 0;
+    qint64 mtime = 0;
+    QSize size;
+    // Settings the thumbnail depends on, e.g. the frame offset of a video
+    QString variant;
+};
+
+/**
+ * @brief Persistent on-disk thumbnail store
+ *
+ * Thumbnails are kept as JPEG in one append-only pack file per device album
+ * (<cache>/thumbnails/<udid>/<album hash>.pack). The pack is memory mapped
+ * for reads and its record headers are scanned once when the album is first
+ * used, so lookups never touch the device. All packs share one size budget,
+ * the least recently used ones are removed when the store is first used in
+ * a session. Thread safe.
+ */
+class ThumbnailCache
+{
+public:
+    static ThumbnailCache *sharedInstance();
+
+    QImage lookup(const QString &udid, const QString &albumPath,
+                  const ThumbnailKey &key);
+    void store(const QString &udid, const QString &albumPath,
+               const ThumbnailKey &key, const QImage &thumbnail);
+
+    // Same as above but with the stored JPEG bytes, for callers that keep
+    // thumbnails compressed in memory. The perceptual hash of the thumbnail
+    // (see DuplicateIndex) is kept in the record header next to it.
+    QByteArray lookupEncoded(const QString &udid, const QString &albumPath,
+                             const ThumbnailKey &key,
+                             std::optional<quint64> *hash = nullptr);
+    void storeEncoded(const QString &udid, const QString &albumPath,
+                      const ThumbnailKey &key, const QByteArray &data,
+                      std::optional<quint64> hash = std::nullopt);
+    static QByteArray encode(const QImage &thumbnail);
+
+private:
+    ThumbnailCache() = default;
+
+    class Pack
+    {
+    public:
+        explicit Pack(const QString &path);
+        ~Pack();
+
+        QByteArray read(const ThumbnailKey &key,
+                        std::optional<quint64> *hash);
+        void append(const ThumbnailKey &key, const QByteArray &data,
+                    std::optional<quint64> hash);
+
+    private:
+        struct Entry {
+            qint64 offset = 0;
+            quint32 length = 0;
+            quint64 fileSize = 0;
+            qint64 mtime = 0;
+            std::optional<quint64> hash;
+        };
+
+        bool open();
+        void scan();
+        void compact();
+        bool ensureMapped(qint64 end);
+        static QString entryName(const ThumbnailKey &key);
+
+        QString m_path;
+        QFile m_file;
+        uchar *m_map = nullptr;
+        qint64 m_mappedSize = 0;
+        qint64 m_deadBytes = 0;
+        QHash<QString, Entry> m_entries;
+        QMutex m_mutex;
+    };
+
+    std::shared_ptr<Pack> pack(const QString &udid, const QString &albumPath);
+    static QString rootDir();
+    static QString deviceDir(const QString &udid);
+    static void prune();
+
+    QMap<QString, std::shared_ptr<Pack>> m_packs;
+    bool m_pruned = false;
+    QMutex m_mutex;
+};
+
+#endif // THUMBNAILCACHE_H
@@ -0,0 +1,800 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "videotranscoder.h"
+#include "core/helpers/afc_avio_reader.h"
+#include <QDebug>
+#include <QFile>
+#include <QList>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/audio_fifo.h>
+#include <libswresample/swresample.h>
+#include <libswscale/swscale.h>
+}
+
+// AVChannelLayout replaced the channel mask API in FFmpeg 5.1
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 28, 100)
+#define HAVE_CH_LAYOUT 1
+#else
+#define HAVE_CH_LAYOUT 0
+#endif
+
+// Progress is reported after every this many bytes of input
+static constexpr qint64 PROGRESS_INTERVAL = 1024 * 1024;
+// Per channel, for audio converted to AAC
+static constexpr int AAC_CHANNEL_BIT_RATE = 64000;
+static constexpr int AAC_MAX_CHANNELS = 8;
+
+static QString errorString(int error)
+{
+    char buffer[AV_ERROR_MAX_STRING_SIZE] = {};
+    av_strerror(error, buffer, sizeof(buffer));
+    return QString::fromUtf8(buffer);
+}
+
+// Portrait videos are stored landscape with a display matrix in the stream
+// side data, it has to come along or the result plays sideways
+static void copyDisplayMatrix(const AVStream *in, AVStream *out)
+{
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(60, 31, 102)
+    const AVPacketSideData *matrix = av_packet_side_data_get(
+        in->codecpar->coded_side_data, in->codecpar->nb_coded_side_data,
+        AV_PKT_DATA_DISPLAYMATRIX);
+    if (!matrix || av_packet_side_data_get(out->codecpar->coded_side_data,
+                                           out->codecpar->nb_coded_side_data,
+                                           AV_PKT_DATA_DISPLAYMATRIX))
+        return;
+    AVPacketSideData *copy = av_packet_side_data_new(
+        &out->codecpar->coded_side_data, &out->codecpar->nb_coded_side_data,
+        AV_PKT_DATA_DISPLAYMATRIX, matrix->size, 0);
+    if (copy)
+        memcpy(copy->data, matrix->data, matrix->size);
+#elif LIBAVFORMAT_VERSION_MAJOR >= 59
+    size_t size = 0;
+    const uint8_t *matrix =
+        av_stream_get_side_data(in, AV_PKT_DATA_DISPLAYMATRIX, &size);
+    if (!matrix)
+        return;
+    uint8_t *copy = av_stream_new_side_data(out, AV_PKT_DATA_DISPLAYMATRIX,
+                                            size);
+    if (copy)
+        memcpy(copy, matrix, size);
+#endif
+}
+
+// iOS plays AAC and ALAC, anything else is converted to AAC on import
+static bool isDeviceAudio(AVCodecID codec)
+{
+    return codec == AV_CODEC_ID_AAC || codec == AV_CODEC_ID_ALAC;
+}
+
+static int channelCount(const AVCodecContext *context)
+{
+#if HAVE_CH_LAYOUT
+    return context->ch_layout.nb_channels;
+#else
+    return context->channels;
+#endif
+}
+
+namespace
+{
+// An audio track re-encoded to AAC. Decoded samples are resampled into a
+// FIFO, since the encoder takes fixed-size frames.
+struct AudioTrack {
+    AVCodecContext *decoder = nullptr;
+    AVCodecContext *encoder = nullptr;
+    SwrContext *resampler = nullptr;
+    AVAudioFifo *fifo = nullptr;
+    AVFrame *frame = nullptr;
+    AVFrame *samples = nullptr;
+    AVPacket *encoded = nullptr;
+    int outIndex = -1;
+    int64_t nextPts = AV_NOPTS_VALUE;
+
+    ~AudioTrack()
+    {
+        av_frame_free(&frame);
+        av_frame_free(&samples);
+        av_packet_free(&encoded);
+        if (fifo)
+            av_audio_fifo_free(fifo);
+        swr_free(&resampler);
+        avcodec_free_context(&decoder);
+        avcodec_free_context(&encoder);
+    }
+};
+
+// FFmpeg state of one conversion, freed here whichever step fails
+struct TranscodeSession {
+    std::unique_ptr<AfcAvioReader> reader;
+    AVFormatContext *input = nullptr;
+    AVFormatContext *output = nullptr;
+    AVCodecContext *decoder = nullptr;
+    AVCodecContext *encoder = nullptr;
+    SwsContext *scaler = nullptr;
+    AVFrame *frame = nullptr;
+    AVFrame *converted = nullptr;
+    AVPacket *packet = nullptr;
+    AVPacket *encoded = nullptr;
+    // Output stream of each input stream, -1 if it is dropped
+    QList<int> streamMap;
+    // Audio tracks converted to AAC, by input stream
+    std::map<int, std::unique_ptr<AudioTrack>> audioTracks;
+    // Convert audio iOS cannot play instead of copying it
+    bool deviceAudio = false;
+    int videoStream = -1;
+    int64_t lastPts = AV_NOPTS_VALUE;
+
+    ~TranscodeSession()
+    {
+        av_frame_free(&frame);
+        av_frame_free(&converted);
+        av_packet_free(&packet);
+        av_packet_free(&encoded);
+        sws_freeContext(scaler);
+        avcodec_free_context(&decoder);
+        avcodec_free_context(&encoder);
+        if (output) {
+            if (!(output->oformat->flags & AVFMT_NOFILE))
+                avio_closep(&output->pb);
+            avformat_free_context(output);
+        }
+        // Custom IO, the reader frees its own context afterwards
+        avformat_close_input(&input);
+    }
+
+    QString openInput(iDescriptorDevice *device, const QString &path,
+                      std::optional<afc_client_t> altAfc);
+    QString openLocalInput(const QString &path);
+    QString findStreams();
+    QString openOutput(const QString &path, int threads);
+    QString openCodecs(AVStream *in, AVStream *out, int threads);
+    QString openAudioCodecs(AVStream *in, AVStream *out, AudioTrack &track);
+    QString run(const std::atomic<bool> &cancelRequested,
+                const VideoTranscoder::ProgressCallback &progress);
+    qint64 inputPosition() const
+    {
+        return reader ? static_cast<qint64>(reader->position())
+                      : avio_tell(input->pb);
+    }
+    qint64 inputSize() const
+    {
+        return reader ? static_cast<qint64>(reader->size())
+                      : avio_size(input->pb);
+    }
+    int decodePacket(AVPacket *source);
+    int encodeFrame(AVFrame *source);
+    int decodeAudio(AudioTrack &track, AVPacket *source);
+    int resampleAudio(AudioTrack &track, const AVFrame *source);
+    int encodeAudio(AudioTrack &track, bool flush);
+    int writeAudio(AudioTrack &track, AVFrame *source);
+};
+
+QString TranscodeSession::openInput(iDescriptorDevice *device,
+                                    const QString &path,
+                                    std::optional<afc_client_t> altAfc)
+{
+    reader = AfcAvioReader::open(device, path, altAfc);
+    if (!reader)
+        return "Failed to open file on device";
+
+    input = avformat_alloc_context();
+    if (!input)
+        return "Failed to allocate format context";
+    input->pb = reader->context();
+    input->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    // On failure avformat_open_input frees the context itself
+    if (avformat_open_input(&input, nullptr, nullptr, nullptr) < 0)
+        return "Failed to open video format";
+    return findStreams();
+}
+
+QString TranscodeSession::openLocalInput(const QString &path)
+{
+    const QByteArray inputName = path.toUtf8();
+    if (avformat_open_input(&input, inputName.constData(), nullptr,
+                            nullptr) < 0)
+        return "Failed to open video file";
+    return findStreams();
+}
+
+QString TranscodeSession::findStreams()
+{
+    if (avformat_find_stream_info(input, nullptr) < 0)
+        return "Failed to find stream info";
+
+    videoStream =
+        av_find_best_stream(input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (videoStream < 0)
+        return "No video stream found";
+    return {};
+}
+
+QString TranscodeSession::openOutput(const QString &path, int threads)
+{
+    const QByteArray outputName = path.toUtf8();
+    if (avformat_alloc_output_context2(&output, nullptr, nullptr,
+                                       outputName.constData()) < 0 ||
+        !output)
+        return "Unsupported output format";
+
+    // Creation date, location and the like
+    av_dict_copy(&output->metadata, input->metadata, 0);
+
+    for (unsigned int i = 0; i < input->nb_streams; ++i) {
+        AVStream *in = input->streams[i];
+        const AVCodecID codec = in->codecpar->codec_id;
+        const bool isVideo = static_cast<int>(i) == videoStream;
+        const bool isAudio = in->codecpar->codec_type == AVMEDIA_TYPE_AUDIO;
+        const bool accepted = avformat_query_codec(output->oformat, codec,
+                                                   FF_COMPLIANCE_NORMAL) == 1;
+        const bool encode = isVideo && codec != AV_CODEC_ID_H264;
+        // Audio the container or the device cannot take becomes AAC rather
+        // than going missing
+        const bool encodeAudio =
+            isAudio && (!accepted || (deviceAudio && !isDeviceAudio(codec)));
+        // Other tracks (Live Photo metadata, extra video angles) are dropped
+        const bool copy = !encode && !encodeAudio &&
+                          (isVideo || isAudio) && accepted;
+        if (!encode && !encodeAudio && !copy) {
+            streamMap.append(-1);
+            continue;
+        }
+
+        AVStream *out = avformat_new_stream(output, nullptr);
+        if (!out)
+            return "Failed to allocate output stream";
+        streamMap.append(out->index);
+        av_dict_copy(&out->metadata, in->metadata, 0);
+        out->disposition = in->disposition;
+
+        if (encode) {
+            const QString error = openCodecs(in, out, threads);
+            if (!error.isEmpty())
+                return error;
+        } else if (encodeAudio) {
+            auto track = std::make_unique<AudioTrack>();
+            track->outIndex = out->index;
+            const QString error = openAudioCodecs(in, out, *track);
+            if (!error.isEmpty())
+                return error;
+            audioTracks[static_cast<int>(i)] = std::move(track);
+        } else {
+            if (avcodec_parameters_copy(out->codecpar, in->codecpar) < 0)
+                return "Failed to copy stream parameters";
+            // Let the muxer pick the tag for its own container
+            out->codecpar->codec_tag = 0;
+            out->time_base = in->time_base;
+        }
+        copyDisplayMatrix(in, out);
+    }
+
+    if (!(output->oformat->flags & AVFMT_NOFILE) &&
+        avio_open(&output->pb, outputName.constData(), AVIO_FLAG_WRITE) < 0)
+        return QString("Failed to create local file: %1").arg(path);
+    return {};
+}
+
+QString TranscodeSession::openCodecs(AVStream *in, AVStream *out, int threads)
+{
+    const AVCodec *decoderCodec = avcodec_find_decoder(in->codecpar->codec_id);
+    if (!decoderCodec)
+        return QString("No decoder for %1")
+            .arg(avcodec_get_name(in->codecpar->codec_id));
+
+    decoder = avcodec_alloc_context3(decoderCodec);
+    if (!decoder || avcodec_parameters_to_context(decoder, in->codecpar) < 0)
+        return "Failed to set up the video decoder";
+    decoder->pkt_timebase = in->time_base;
+    decoder->thread_count = threads;
+    if (avcodec_open2(decoder, decoderCodec, nullptr) < 0)
+        return "Failed to open the video decoder";
+
+    const AVCodec *encoderCodec = avcodec_find_encoder_by_name("libx264");
+    if (!encoderCodec)
+        encoderCodec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    if (!encoderCodec)
+        return "No H.264 encoder available";
+
+    encoder = avcodec_alloc_context3(encoderCodec);
+    if (!encoder)
+        return "Failed to allocate the H.264 encoder";
+    encoder->width = decoder->width;
+    encoder->height = decoder->height;
+    encoder->sample_aspect_ratio = decoder->sample_aspect_ratio;
+    encoder->pix_fmt = AV_PIX_FMT_YUV420P;
+    encoder->color_range = decoder->color_range;
+    encoder->color_primaries = decoder->color_primaries;
+    encoder->color_trc = decoder->color_trc;
+    encoder->colorspace = decoder->colorspace;
+    encoder->time_base = in->time_base;
+    encoder->framerate = av_guess_frame_rate(input, in, nullptr);
+    // Frame threading keeps several frames in flight, one per thread
+    encoder->thread_count = threads;
+    encoder->thread_type = FF_THREAD_FRAME;
+    if (output->oformat->flags & AVFMT_GLOBALHEADER)
+        encoder->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    AVDictionary *options = nullptr;
+    if (strcmp(encoderCodec->name, "libx264") == 0) {
+        av_dict_set(&options, "preset", "medium", 0);
+        av_dict_set(&options, "crf", "20", 0);
+    }
+    const int opened = avcodec_open2(encoder, encoderCodec, &options);
+    av_dict_free(&options);
+    if (opened < 0)
+        return QString("Failed to open the H.264 encoder: %1")
+            .arg(errorString(opened));
+
+    if (avcodec_parameters_from_context(out->codecpar, encoder) < 0)
+        return "Failed to set up the output video stream";
+    out->time_base = encoder->time_base;
+    out->avg_frame_rate = encoder->framerate;
+
+    frame = av_frame_alloc();
+    converted = av_frame_alloc();
+    encoded = av_packet_alloc();
+    if (!frame || !converted || !encoded)
+        return "Failed to allocate frames";
+    return {};
+}
+
+QString TranscodeSession::openAudioCodecs(AVStream *in, AVStream *out,
+                                          AudioTrack &track)
+{
+    const AVCodec *decoderCodec = avcodec_find_decoder(in->codecpar->codec_id);
+    if (!decoderCodec)
+        return QString("No decoder for %1 audio")
+            .arg(avcodec_get_name(in->codecpar->codec_id));
+
+    AVCodecContext *decoder = track.decoder =
+        avcodec_alloc_context3(decoderCodec);
+    if (!decoder || avcodec_parameters_to_context(decoder, in->codecpar) < 0)
+        return "Failed to set up the audio decoder";
+    decoder->pkt_timebase = in->time_base;
+    if (avcodec_open2(decoder, decoderCodec, nullptr) < 0)
+        return "Failed to open the audio decoder";
+
+    // FFmpeg's own encoder, external ones take other sample formats
+    const AVCodec *encoderCodec = avcodec_find_encoder_by_name("aac");
+    if (!encoderCodec)
+        return "No AAC encoder available";
+    AVCodecContext *encoder = track.encoder =
+        avcodec_alloc_context3(encoderCodec);
+    if (!encoder)
+        return "Failed to allocate the AAC encoder";
+
+    // AAC has a fixed set of sample rates, others are resampled to 48 kHz
+    static const QList<int> aacRates = {96000, 88200, 64000, 48000, 44100,
+                                        32000, 24000, 22050, 16000, 12000,
+                                        11025, 8000,  7350};
+    const int channels =
+        qBound(1, channelCount(decoder), AAC_MAX_CHANNELS);
+    encoder->sample_fmt = AV_SAMPLE_FMT_FLTP;
+    encoder->sample_rate = aacRates.contains(decoder->sample_rate)
+                               ? decoder->sample_rate
+                               : 48000;
+    encoder->bit_rate = static_cast<int64_t>(channels) * AAC_CHANNEL_BIT_RATE;
+    encoder->time_base = AVRational{1, encoder->sample_rate};
+    if (output->oformat->flags & AVFMT_GLOBALHEADER)
+        encoder->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    // Files without a channel layout get the default one for their count
+    int ret = 0;
+#if HAVE_CH_LAYOUT
+    av_channel_layout_default(&encoder->ch_layout, channels);
+    AVChannelLayout inLayout = {};
+    if (decoder->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC)
+        av_channel_layout_default(&inLayout, channelCount(decoder));
+    else
+        av_channel_layout_copy(&inLayout, &decoder->ch_layout);
+    ret = swr_alloc_set_opts2(&track.resampler, &encoder->ch_layout,
+                              encoder->sample_fmt, encoder->sample_rate,
+                              &inLayout, decoder->sample_fmt,
+                              decoder->sample_rate, 0, nullptr);
+    av_channel_layout_uninit(&inLayout);
+#else
+    encoder->channels = channels;
+    encoder->channel_layout = av_get_default_channel_layout(channels);
+    const int64_t inLayout =
+        decoder->channel_layout
+            ? decoder->channel_layout
+            : av_get_default_channel_layout(decoder->channels);
+    track.resampler = swr_alloc_set_opts(
+        nullptr, encoder->channel_layout, encoder->sample_fmt,
+        encoder->sample_rate, inLayout, decoder->sample_fmt,
+        decoder->sample_rate, 0, nullptr);
+#endif
+    if (ret < 0 || !track.resampler || swr_init(track.resampler) < 0)
+        return "Failed to set up the audio resampler";
+
+    if ((ret = avcodec_open2(encoder, encoderCodec, nullptr)) < 0)
+        return QString("Failed to open the AAC encoder: %1")
+            .arg(errorString(ret));
+    if (avcodec_parameters_from_context(out->codecpar, encoder) < 0)
+        return "Failed to set up the output audio stream";
+    out->time_base = encoder->time_base;
+
+    track.fifo = av_audio_fifo_alloc(encoder->sample_fmt, channels,
+                                     encoder->frame_size);
+    track.frame = av_frame_alloc();
+    track.samples = av_frame_alloc();
+    track.encoded = av_packet_alloc();
+    if (!track.fifo || !track.frame || !track.samples || !track.encoded)
+        return "Failed to allocate audio buffers";
+
+    track.samples->format = encoder->sample_fmt;
+    track.samples->sample_rate = encoder->sample_rate;
+    track.samples->nb_samples = encoder->frame_size;
+#if HAVE_CH_LAYOUT
+    av_channel_layout_copy(&track.samples->ch_layout, &encoder->ch_layout);
+#else
+    track.samples->channel_layout = encoder->channel_layout;
+    track.samples->channels = channels;
+#endif
+    if (av_frame_get_buffer(track.samples, 0) < 0)
+        return "Failed to allocate audio buffers";
+    return {};
+}
+
+QString
+TranscodeSession::run(const std::atomic<bool> &cancelRequested,
+                      const VideoTranscoder::ProgressCallback &progress)
+{
+    AVDictionary *muxOptions = nullptr;
+    // Index first, so the result starts playing before it is fully read
+    if (strcmp(output->oformat->name, "mov") == 0 ||
+        strcmp(output->oformat->name, "mp4") == 0)
+        av_dict_set(&muxOptions, "movflags", "+faststart", 0);
+    const int headerWritten = avformat_write_header(output, &muxOptions);
+    av_dict_free(&muxOptions);
+    if (headerWritten < 0)
+        return QString("Failed to write video header: %1")
+            .arg(errorString(headerWritten));
+
+    packet = av_packet_alloc();
+    if (!packet)
+        return "Failed to allocate packet";
+
+    qint64 reported = 0;
+    int ret = 0;
+    while ((ret = av_read_frame(input, packet)) >= 0) {
+        if (cancelRequested.load()) {
+            av_packet_unref(packet);
+            return "Cancelled";
+        }
+
+        const int outIndex = streamMap.value(packet->stream_index, -1);
+        if (outIndex < 0) {
+            av_packet_unref(packet);
+            continue;
+        }
+
+        auto audio = audioTracks.find(packet->stream_index);
+        if (packet->stream_index == videoStream && encoder) {
+            ret = decodePacket(packet);
+            av_packet_unref(packet);
+        } else if (audio != audioTracks.end()) {
+            ret = decodeAudio(*audio->second, packet);
+            av_packet_unref(packet);
+        } else {
+            const AVStream *in = input->streams[packet->stream_index];
+            av_packet_rescale_ts(packet, in->time_base,
+                                 output->streams[outIndex]->time_base);
+            packet->stream_index = outIndex;
+            packet->pos = -1;
+            // Takes over the packet's data
+            ret = av_interleaved_write_frame(output, packet);
+        }
+        if (ret < 0)
+            return QString("Failed to convert video: %1").arg(errorString(ret));
+
+        const qint64 position = inputPosition();
+        if (progress && position - reported >= PROGRESS_INTERVAL) {
+            reported = position;
+            progress(position, inputSize());
+        }
+    }
+    if (ret != AVERROR_EOF)
+        return QString("Failed to read video: %1").arg(errorString(ret));
+
+    if (encoder) {
+        // Drain what the decoder and encoder still hold
+        ret = decodePacket(nullptr);
+        if (ret >= 0)
+            ret = encodeFrame(nullptr);
+        if (ret < 0)
+            return QString("Failed to convert video: %1").arg(errorString(ret));
+    }
+    for (auto &[index, track] : audioTracks) {
+        // Decoder, resampler, the partial last frame, then the encoder
+        ret = decodeAudio(*track, nullptr);
+        if (ret >= 0)
+            ret = resampleAudio(*track, nullptr);
+        if (ret >= 0)
+            ret = encodeAudio(*track, true);
+        if (ret < 0)
+            return QString("Failed to convert audio: %1").arg(errorString(ret));
+    }
+
+    if ((ret = av_write_trailer(output)) < 0)
+        return QString("Failed to finish video file: %1")
+            .arg(errorString(ret));
+
+    if (progress)
+        progress(inputSize(), inputSize());
+    return {};
+}
+
+// A null source flushes the decoder
+int TranscodeSession::decodePacket(AVPacket *source)
+{
+    int ret = avcodec_send_packet(decoder, source);
+    // A damaged packet costs a frame, not the whole video
+    if (ret == AVERROR_INVALIDDATA)
+        return 0;
+    if (ret < 0)
+        return ret;
+
+    while ((ret = avcodec_receive_frame(decoder, frame)) >= 0) {
+        frame->pts = frame->best_effort_timestamp;
+        ret = encodeFrame(frame);
+        av_frame_unref(frame);
+        if (ret < 0)
+            return ret;
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+// A null source flushes the encoder
+int TranscodeSession::encodeFrame(AVFrame *source)
+{
+    int ret = 0;
+    AVFrame *toEncode = source;
+
+    // 10-bit HDR and other layouts go through swscale to 8-bit 4:2:0
+    if (source && (source->format != encoder->pix_fmt ||
+                   source->width != encoder->width ||
+                   source->height != encoder->height)) {
+        scaler = sws_getCachedContext(
+            scaler, source->width, source->height,
+            static_cast<AVPixelFormat>(source->format), encoder->width,
+            encoder->height, encoder->pix_fmt, SWS_BILINEAR, nullptr, nullptr,
+            nullptr);
+        if (!scaler)
+            return AVERROR(EINVAL);
+
+        if (!converted->data[0]) {
+            converted->format = encoder->pix_fmt;
+            converted->width = encoder->width;
+            converted->height = encoder->height;
+            if ((ret = av_frame_get_buffer(converted, 0)) < 0)
+                return ret;
+        }
+        // The encoder may still reference the previous frame's buffer
+        if ((ret = av_frame_make_writable(converted)) < 0)
+            return ret;
+
+        sws_scale(scaler, source->data, source->linesize, 0, source->height,
+                  converted->data, converted->linesize);
+        converted->pts = source->pts;
+        toEncode = converted;
+    }
+
+    if (toEncode) {
+        // x264 rejects timestamps that do not increase
+        if (lastPts != AV_NOPTS_VALUE && toEncode->pts <= lastPts)
+            toEncode->pts = lastPts + 1;
+        lastPts = toEncode->pts;
+        toEncode->pict_type = AV_PICTURE_TYPE_NONE;
+    }
+
+    if ((ret = avcodec_send_frame(encoder, toEncode)) < 0)
+        return ret;
+
+    AVStream *out = output->streams[streamMap.at(videoStream)];
+    while ((ret = avcodec_receive_packet(encoder, encoded)) >= 0) {
+        av_packet_rescale_ts(encoded, encoder->time_base, out->time_base);
+        encoded->stream_index = out->index;
+        if ((ret = av_interleaved_write_frame(output, encoded)) < 0)
+            return ret;
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+// A null source flushes the decoder
+int TranscodeSession::decodeAudio(AudioTrack &track, AVPacket *source)
+{
+    int ret = avcodec_send_packet(track.decoder, source);
+    // A damaged packet costs a few milliseconds of sound
+    if (ret == AVERROR_INVALIDDATA)
+        return 0;
+    if (ret < 0)
+        return ret;
+
+    while ((ret = avcodec_receive_frame(track.decoder, track.frame)) >= 0) {
+        // Starts where the input track starts, so it stays in sync
+        if (track.nextPts == AV_NOPTS_VALUE) {
+            const int64_t pts = track.frame->best_effort_timestamp;
+            track.nextPts =
+                pts == AV_NOPTS_VALUE
+                    ? 0
+                    : av_rescale_q(pts, track.decoder->pkt_timebase,
+                                   track.encoder->time_base);
+        }
+        ret = resampleAudio(track, track.frame);
+        av_frame_unref(track.frame);
+        if (ret < 0)
+            return ret;
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+// A null source flushes the resampler
+int TranscodeSession::resampleAudio(AudioTrack &track, const AVFrame *source)
+{
+    const int inSamples = source ? source->nb_samples : 0;
+    const int maxSamples = swr_get_out_samples(track.resampler, inSamples);
+    if (maxSamples <= 0)
+        return maxSamples;
+
+    uint8_t **buffer = nullptr;
+    int ret = av_samples_alloc_array_and_samples(
+        &buffer, nullptr, channelCount(track.encoder), maxSamples,
+        track.encoder->sample_fmt, 0);
+    if (ret < 0)
+        return ret;
+    ret = swr_convert(track.resampler, buffer, maxSamples,
+                      source ? const_cast<const uint8_t **>(
+                                   source->extended_data)
+                             : nullptr,
+                      inSamples);
+    if (ret > 0 &&
+        av_audio_fifo_write(track.fifo, reinterpret_cast<void **>(buffer),
+                            ret) < ret)
+        ret = AVERROR(ENOMEM);
+    av_freep(&buffer[0]);
+    av_freep(&buffer);
+    return ret < 0 ? ret : encodeAudio(track, false);
+}
+
+// Encodes whole frames from the FIFO, on flush also the rest and whatever
+// the encoder holds
+int TranscodeSession::encodeAudio(AudioTrack &track, bool flush)
+{
+    const int frameSize = track.encoder->frame_size;
+    int ret = 0;
+    while (av_audio_fifo_size(track.fifo) >= frameSize ||
+           (flush && av_audio_fifo_size(track.fifo) > 0)) {
+        if ((ret = av_frame_make_writable(track.samples)) < 0)
+            return ret;
+        track.samples->nb_samples =
+            qMin(av_audio_fifo_size(track.fifo), frameSize);
+        av_audio_fifo_read(track.fifo,
+                           reinterpret_cast<void **>(track.samples->data),
+                           track.samples->nb_samples);
+        track.samples->pts = track.nextPts;
+        track.nextPts += track.samples->nb_samples;
+        if ((ret = writeAudio(track, track.samples)) < 0)
+            return ret;
+    }
+    return flush ? writeAudio(track, nullptr) : 0;
+}
+
+// A null source flushes the encoder
+int TranscodeSession::writeAudio(AudioTrack &track, AVFrame *source)
+{
+    int ret = avcodec_send_frame(track.encoder, source);
+    if (ret < 0)
+        return ret;
+
+    AVStream *out = output->streams[track.outIndex];
+    while ((ret = avcodec_receive_packet(track.encoder, track.encoded)) >= 0) {
+        av_packet_rescale_ts(track.encoded, track.encoder->time_base,
+                             out->time_base);
+        track.encoded->stream_index = out->index;
+        if ((ret = av_interleaved_write_frame(output, track.encoded)) < 0)
+            return ret;
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+} // namespace
+
+// Runs a session once openInput has opened its input
+static QString
+convert(const std::function<QString(TranscodeSession &)> &openInput,
+        const QString &inputPath, const QString &outputPath, int threads,
+        const std::atomic<bool> &cancelRequested,
+        const VideoTranscoder::ProgressCallback &progress)
+{
+    QString error;
+    {
+        TranscodeSession session;
+        error = openInput(session);
+        if (error.isEmpty())
+            error = session.openOutput(outputPath, threads);
+        if (error.isEmpty())
+            error = session.run(cancelRequested, progress);
+    }
+
+    // The session has closed the output by now
+    if (!error.isEmpty()) {
+        qWarning() << "Video conversion failed for" << inputPath << ":"
+                   << error;
+        QFile::remove(outputPath);
+    }
+    return error;
+}
+
+QString VideoTranscoder::transcodeToH264(
+    iDescriptorDevice *device, const QString &devicePath,
+    const QString &outputPath, int threads,
+    const std::atomic<bool> &cancelRequested,
+    std::optional<afc_client_t> altAfc, const ProgressCallback &progress)
+{
+    return convert(
+        [&](TranscodeSession &session) {
+            return session.openInput(device, devicePath, altAfc);
+        },
+        devicePath, outputPath, threads, cancelRequested, progress);
+}
+
+QString VideoTranscoder::transcodeFileToH264(
+    const QString &inputPath, const QString &outputPath, int threads,
+    const std::atomic<bool> &cancelRequested,
+    const ProgressCallback &progress)
+{
+    return convert(
+        [&](TranscodeSession &session) {
+            session.deviceAudio = true;
+            return session.openLocalInput(inputPath);
+        },
+        inputPath, outputPath, threads, cancelRequested, progress);
+}
+
+bool VideoTranscoder::needsConversion(const QString &inputPath)
+{
+    TranscodeSession session;
+    if (!session.openLocalInput(inputPath).isEmpty())
+        return true;
+
+    // The demuxer for MOV, MP4 and their relatives is named "mov,mp4,..."
+    const bool movContainer =
+        QByteArray(session.input->iformat->name).startsWith("mov");
+    const AVCodecID codec =
+        session.input->streams[session.videoStream]->codecpar->codec_id;
+    if (!movContainer ||
+        (codec != AV_CODEC_ID_H264 && codec != AV_CODEC_ID_HEVC))
+        return true;
+
+    for (unsigned int i = 0; i < session.input->nb_streams; ++i) {
+        const AVCodecParameters *params = session.input->streams[i]->codecpar;
+        if (params->codec_type == AVMEDIA_TYPE_AUDIO &&
+            !isDeviceAudio(params->codec_id))
+            return true;
+    }
+    return false;
+}
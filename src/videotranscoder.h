@@ -0,0 +1,68 @@
+/*
+ * iDescriptor: A free and open-source idevice management tool.
+ *
+ * Copyright (C) 2025 Uncore <https://github.com/uncor3>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VIDEOTRANSCODER_H
+#define VIDEOTRANSCODER_H
+
+#include "iDescriptor.h"
+#include <QString>
+#include <atomic>
+#include <functional>
+#include <optional>
+
+/**
+ * @brief Converts videos to H.264, device videos without a local copy of the
+ * input
+ *
+ * Device inputs are demuxed straight from the device through AfcAvioReader,
+ * local files are read directly. The video track is decoded and re-encoded
+ * with a frame-threaded H.264 encoder (libx264 when available), audio tracks
+ * and container metadata are copied as they are. Audio the output container
+ * does not take, and for local files audio other than AAC or ALAC, is
+ * converted to AAC. Videos that already are H.264 are only remuxed.
+ */
+class VideoTranscoder
+{
+public:
+    // Called with (bytes of the input read, input size)
+    using ProgressCallback = std::function<void(qint64, qint64)>;
+
+    // Writes outputPath, the container follows its suffix. Returns an empty
+    // string on success, otherwise what went wrong; a partial output is
+    // removed.
+    static QString transcodeToH264(iDescriptorDevice *device,
+                                   const QString &devicePath,
+                                   const QString &outputPath, int threads,
+                                   const std::atomic<bool> &cancelRequested,
+                                   std::optional<afc_client_t> altAfc,
+                                   const ProgressCallback &progress = {});
+
+    // Same for a local file
+    static QString transcodeFileToH264(const QString &inputPath,
+                                       const QString &outputPath, int threads,
+                                       const std::atomic<bool> &cancelRequested,
+                                       const ProgressCallback &progress = {});
+
+    // Whether a local video has to be converted to play on an iOS device,
+    // i.e. it is not H.264 or HEVC in an MP4/MOV container or has audio
+    // other than AAC or ALAC
+    static bool needsConversion(const QString &inputPath);
+};
+
+#endif // VIDEOTRANSCODER_H
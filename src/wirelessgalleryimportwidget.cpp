@@ -18,12 +18,15 @@
  */
 
 #include "wirelessgalleryimportwidget.h"
+#include "importpreprocessor.h"
 #include "photoimportdialog.h"
+#include "settingsmanager.h"
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QHeaderView>
 #include <QMessageBox>
 #include <QMimeDatabase>
+#include <QProgressDialog>
 #include <QPushButton>
 #include <QStandardPaths>
 #include <QTimer>
@@ -31,7 +34,8 @@
 WirelessGalleryImportWidget::WirelessGalleryImportWidget(QWidget *parent)
     : QWidget(parent), m_leftPanel(nullptr), m_scrollArea(nullptr),
       m_scrollContent(nullptr), m_fileListLayout(nullptr),
-      m_browseButton(nullptr), m_importButton(nullptr), m_statusLabel(nullptr),
+      m_browseButton(nullptr), m_importButton(nullptr),
+      m_optimizeCheckBox(nullptr), m_statusLabel(nullptr),
       m_rightPanel(nullptr), m_tutorialPlayer(nullptr),
       m_tutorialVideoWidget(nullptr), m_loadingIndicator(nullptr),
       m_loadingLabel(nullptr), m_tutorialLayout(nullptr)
@@ -88,6 +92,17 @@ void WirelessGalleryImportWidget::setupUI()
     m_scrollArea->setWidget(m_scrollContent);
     leftLayout->addWidget(m_scrollArea, 1);
 
+    m_optimizeCheckBox = new QCheckBox("Optimize files for the device first");
+    m_optimizeCheckBox->setToolTip(
+        "Large images are scaled down and videos the device cannot play are "
+        "converted to H.264. Results are cached for later imports.");
+    m_optimizeCheckBox->setChecked(
+        SettingsManager::sharedInstance()->optimizeWirelessImport());
+    connect(m_optimizeCheckBox, &QCheckBox::toggled, this, [](bool checked) {
+        SettingsManager::sharedInstance()->setOptimizeWirelessImport(checked);
+    });
+    leftLayout->addWidget(m_optimizeCheckBox);
+
     // Import button
     m_importButton = new QPushButton("Import to Gallery");
     m_importButton->setEnabled(false);
@@ -275,7 +290,41 @@ void WirelessGalleryImportWidget::onImportPhotos()
         return;
     }
 
-    PhotoImportDialog dialog(m_selectedFiles, false, this);
+    if (!m_optimizeCheckBox->isChecked()) {
+        showImportDialog(m_selectedFiles);
+        return;
+    }
+
+    auto *preprocessor = new ImportPreprocessor(this);
+    auto *progressDialog =
+        new QProgressDialog("Preparing files for import...", "Cancel", 0,
+                            m_selectedFiles.size(), this);
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(0);
+
+    connect(preprocessor, &ImportPreprocessor::progress, progressDialog,
+            &QProgressDialog::setValue);
+    connect(progressDialog, &QProgressDialog::canceled, preprocessor,
+            [preprocessor, progressDialog]() {
+                preprocessor->cancel();
+                preprocessor->deleteLater();
+                progressDialog->deleteLater();
+            });
+    connect(preprocessor, &ImportPreprocessor::finished, this,
+            [this, preprocessor, progressDialog](const QStringList &files) {
+                // hide() rather than close(), which would emit canceled()
+                progressDialog->hide();
+                progressDialog->deleteLater();
+                preprocessor->deleteLater();
+                showImportDialog(files);
+            });
+
+    preprocessor->start(m_selectedFiles);
+}
+
+void WirelessGalleryImportWidget::showImportDialog(const QStringList &files)
+{
+    PhotoImportDialog dialog(files, false, this);
     dialog.exec();
 }
 
@@ -21,6 +21,7 @@
 #define WIRELESSGALLERYIMPORTWIDGET_H
 
 #include "qprocessindicator.h"
+#include <QCheckBox>
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QListWidget>
@@ -56,6 +57,7 @@ private:
     QVBoxLayout *m_fileListLayout;
     QPushButton *m_browseButton;
     QPushButton *m_importButton;
+    QCheckBox *m_optimizeCheckBox;
     QLabel *m_statusLabel;
 
     // Right panel - tutorial video
@@ -71,6 +73,7 @@ private:
     void setupUI();
     void updateFileList();
     void updateStatusLabel();
+    void showImportDialog(const QStringList &files);
     bool isGalleryCompatible(const QString &filePath) const;
     QStringList getGalleryCompatibleExtensions() const;
 };